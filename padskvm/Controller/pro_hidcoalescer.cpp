@@ -0,0 +1,105 @@
+#include "pro_hidcoalescer.h"
+
+HidCoalescer::HidCoalescer()
+    : m_pending(), m_hasPending(false), m_buttons(0), m_merged(0)
+{
+}
+
+bool HidCoalescer::isMotion(const HidCommand &cmd) const
+{
+    if (cmd.type != HidCommand::CMD_MOUSE_ABS && cmd.type != HidCommand::CMD_MOUSE_REL) return false;
+    return cmd.param4 == 0 && cmd.param3 == m_buttons;
+}
+
+void HidCoalescer::push(const HidCommand &cmd)
+{
+    if (isMotion(cmd)) {
+        // 与挂起的同类运动合并 (stampUs 保留最早一条，延迟统计按最早入队计算)
+        if (m_hasPending && m_pending.type == cmd.type) {
+            if (cmd.type == HidCommand::CMD_MOUSE_ABS) {
+                m_pending.param1 = cmd.param1;
+                m_pending.param2 = cmd.param2;
+            } else {
+                m_pending.param1 += cmd.param1;
+                m_pending.param2 += cmd.param2;
+            }
+            m_merged++;
+            return;
+        }
+        // 类型切换 (绝对 <-> 相对)：先送出旧的
+        flushMotion();
+        m_pending = cmd;
+        m_hasPending = true;
+        return;
+    }
+
+    // 键盘：插到挂起的运动之前
+    if (cmd.type == HidCommand::CMD_KEYBOARD) {
+        m_ready.push_back(cmd);
+        return;
+    }
+
+    // 鼠标边界 (按键/滚轮)：先送出挂起的运动，再按原顺序排队
+    flushMotion();
+    m_buttons = cmd.param3;
+    m_ready.push_back(cmd);
+}
+
+bool HidCoalescer::takeReady(HidCommand &cmd)
+{
+    if (m_ready.empty()) return false;
+    cmd = m_ready.front();
+    m_ready.pop_front();
+    return true;
+}
+
+void HidCoalescer::flushMotion()
+{
+    if (!m_hasPending) return;
+    m_hasPending = false;
+
+    if (m_pending.type == HidCommand::CMD_MOUSE_ABS) {
+        m_ready.push_back(m_pending);
+        return;
+    }
+
+    // 相对位移：CH9329 单包范围 -128..127，这里按 ±127 对称拆分
+    int dx = m_pending.param1;
+    int dy = m_pending.param2;
+    if (dx == 0 && dy == 0) return;
+    while (dx != 0 || dy != 0) {
+        HidCommand part = m_pending;
+        part.param1 = qBound(-127, dx, 127);
+        part.param2 = qBound(-127, dy, 127);
+        dx -= part.param1;
+        dy -= part.param2;
+        m_ready.push_back(part);
+    }
+}
+
+bool HidCoalescer::takeMotion(HidCommand &cmd)
+{
+    if (!m_hasPending) return false;
+
+    cmd = m_pending;
+    if (m_pending.type == HidCommand::CMD_MOUSE_ABS) {
+        m_hasPending = false;
+        return true;
+    }
+
+    cmd.param1 = qBound(-127, m_pending.param1, 127);
+    cmd.param2 = qBound(-127, m_pending.param2, 127);
+    m_pending.param1 -= cmd.param1;
+    m_pending.param2 -= cmd.param2;
+    if (m_pending.param1 == 0 && m_pending.param2 == 0) {
+        m_hasPending = false;
+    }
+    return cmd.param1 != 0 || cmd.param2 != 0;
+}
+
+void HidCoalescer::clear()
+{
+    m_ready.clear();
+    m_hasPending = false;
+    m_buttons = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef PRO_HIDCOALESCER_H
+#define PRO_HIDCOALESCER_H
+
+#include "../Tool/safe_queue.h"
+#include <deque>
+
+// HID 运动合并器 (位于队列与串口发送之间)
+// - 运动：按键状态不变、无滚轮的鼠标包。绝对坐标只保留最新位置，相对位移累加
+// - 边界：鼠标按键变化、滚轮。遇到边界先送出挂起的运动，保证点击位置准确，绝不跨边界合并
+// - 键盘包直接进入就绪队列、插到挂起的运动之前 (键盘与鼠标是独立的报告，
+//   二者的先后只通过鼠标按键体现，而按键与键盘包在就绪队列中保持原顺序)
+// - 运动先挂起，由发送方在链路空闲时 flushMotion() 取出；链路越慢合并越多，带宽有上限，
+//   但最终位置/位移总量不丢
+// 非线程安全：只在 HID I/O 线程中使用
+class HidCoalescer
+{
+public:
+    HidCoalescer();
+
+    // 放入一条指令
+    void push(const HidCommand &cmd);
+
+    // 取出可立即发送的指令 (键盘/边界指令及其之前被迫送出的运动)
+    bool takeReady(HidCommand &cmd);
+    bool hasReady() const { return !m_ready.empty(); }
+
+    // 是否有挂起的运动
+    bool hasPendingMotion() const { return m_hasPending; }
+
+    // 把挂起的运动转为可发送指令 (相对位移按 ±127 拆分成多包)
+    void flushMotion();
+
+    // 直接取出一包挂起的运动 (链路空闲时调用)
+    // 相对位移超过 ±127 时只取一包，余量继续挂起、与后续位移合并
+    bool takeMotion(HidCommand &cmd);
+
+    // 丢弃所有挂起/待发指令，按键状态归零 (切换模式或断开时调用)
+    void clear();
+
+    // 被合并掉的运动包数量
+    quint64 mergedCount() const { return m_merged; }
+
+private:
+    bool isMotion(const HidCommand &cmd) const;
+
+    std::deque<HidCommand> m_ready;
+    HidCommand m_pending;
+    bool m_hasPending;
+    int m_buttons;        // 最近一次送出的鼠标按键状态
+    quint64 m_merged;
+};
+
+#endif // PRO_HIDCOALESCER_H
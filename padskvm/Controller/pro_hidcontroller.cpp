@@ -28,7 +28,8 @@ static uint8_t getHidButtonState(Qt::MouseButtons buttons)// 这里使用 button
 }
 
 HidController::HidController(QObject *parent): QObject(parent),
-    m_driver(new CH9329Driver()),m_sourceSize(1920, 1080)
+    m_ioThread(new QThread(this)), m_io(new HidIoWorker()), m_driverReady(false),
+    m_nextMacroId(1), m_sourceSize(1920, 1080)
 {
     //初始化键值映射表
     initKeyMap();
@@ -40,20 +41,21 @@ HidController::HidController(QObject *parent): QObject(parent),
     m_is_click = false;           // 标记是否为点击操作
     m_is_left_down = false;       // 标记左键是否按下
 
-    //鼠标限流相关
-    m_lastMouseMoveTime = 0;
-    m_elapsedTimer.start();
-
-    // 统一的主循环定时器
-    m_mainLoopTimer = new QTimer(this);
-    m_mainLoopTimer->setInterval(10); // 10ms 间隔 (100Hz)，保证鼠标流畅
-    connect(m_mainLoopTimer, &QTimer::timeout, this, &HidController::onMainLoop);
-    m_mainLoopTimer->start();
-
+    // HID I/O 线程：串口读写与 GUI 绘制、视频处理互不阻塞
+    // 指令通过无锁队列 + eventfd 传递 (原 10ms 定时轮询平均给每条指令增加 5ms 延迟)
+    m_ioThread->setObjectName("HidIo");
+    m_io->moveToThread(m_ioThread);
+    connect(m_ioThread, &QThread::started, m_io, &HidIoWorker::setup);
+    connect(m_io, &HidIoWorker::typingFinished, this, &HidController::typingFinished);
+    m_ioThread->start(QThread::HighestPriority);
 }
 
 HidController::~HidController() {
-    if (m_driver) delete m_driver; //在m_driver里会关闭串口
+    // 先在 I/O 线程内关闭串口、注销监听，再结束线程
+    QMetaObject::invokeMethod(m_io, "shutdown", Qt::BlockingQueuedConnection);
+    m_ioThread->quit();
+    m_ioThread->wait();
+    delete m_io;
 }
 
 // ==========================================
@@ -62,14 +64,77 @@ HidController::~HidController() {
 // 初始化串口
 bool HidController::initDriver(const QString &portName, int baud)
 {
-    if(m_driver->init(portName, baud)){
-        return m_driver->checkConnection();
-    }
-    return false ;
+    // 串口对象属于 I/O 线程，必须在该线程内打开；这里阻塞等待握手结果
+    // (速率已记录时约 100ms，需要探测/升速时最长约 2s)
+    bool ok = false;
+    QMetaObject::invokeMethod(m_io, "openDevice", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, ok),
+                              Q_ARG(QString, portName), Q_ARG(int, baud));
+    m_driverReady = ok;
+    return ok;
+}
+
+void HidController::typeText(const QString &text, const QString &layout, int intervalMs, bool verify)
+{
+    if (!m_driverReady || text.isEmpty()) return;
+    QMetaObject::invokeMethod(m_io, "typeText", Qt::QueuedConnection,
+                              Q_ARG(QString, text), Q_ARG(QString, layout),
+                              Q_ARG(int, intervalMs), Q_ARG(bool, verify));
+}
+
+void HidController::cancelTyping()
+{
+    QMetaObject::invokeMethod(m_io, "cancelTyping", Qt::QueuedConnection);
+}
+
+quint32 HidController::click(uint8_t buttons, int holdMs)
+{
+    HidMacro macro;
+    HidMacroStep press = {{HidCommand::CMD_MOUSE_REL, 0, 0, buttons, 0, 0, 0, HidCommand::SRC_INTERNAL}, 0};
+    HidMacroStep release = {{HidCommand::CMD_MOUSE_REL, 0, 0, 0, 0, 0, 0, HidCommand::SRC_INTERNAL}, holdMs};
+    macro.push_back(press);
+    macro.push_back(release);
+    return runMacro(macro);
+}
+
+quint32 HidController::tapKey(uint8_t mods, uint8_t key, int holdMs)
+{
+    HidMacro macro;
+    HidMacroStep press = {{HidCommand::CMD_KEY, mods, key, 0, HidCommand::KEY_PRESS, 0, 0, HidCommand::SRC_INTERNAL}, 0};
+    HidMacroStep release = {{HidCommand::CMD_KEY, 0, key, 0, HidCommand::KEY_RELEASE, 0, 0, HidCommand::SRC_INTERNAL}, holdMs};
+    macro.push_back(press);
+    macro.push_back(release);
+    return runMacro(macro);
+}
+
+quint32 HidController::runMacro(const HidMacro &macro)
+{
+    quint32 id = m_nextMacroId++;
+    if (m_nextMacroId == 0) m_nextMacroId = 1;
+    if (!m_driverReady || macro.empty()) return id;
+
+    HidIoWorker *io = m_io;
+    QMetaObject::invokeMethod(m_io, [io, id, macro]() { io->runMacro(id, macro); }, Qt::QueuedConnection);
+    return id;
+}
+
+void HidController::cancelMacro(quint32 id)
+{
+    HidIoWorker *io = m_io;
+    QMetaObject::invokeMethod(m_io, [io, id]() { io->cancelMacro(id); }, Qt::QueuedConnection);
+}
+
+void HidController::setRealtimePriority(bool enable, int priority)
+{
+    QMetaObject::invokeMethod(m_io, "applyRealtime", Qt::QueuedConnection,
+                              Q_ARG(bool, enable), Q_ARG(int, priority));
 }
 
 // 切换鼠标模式
 void HidController::setControlMode(HidControlMode mode) {
+    if (mode != m_currentMode) {
+        releaseLocalKeys();
+    }
     m_currentMode = mode;
 }
 
@@ -106,40 +171,11 @@ void HidController::updateScaleParams()
              << "DisplayRect" << m_displayRect;
 }
 
-// ==========================================
-// 统一主循环 (负责：取队列发送 + 长按检测)
-// ==========================================
-void HidController::onMainLoop()
-{
-    // 1. 处理队列中的所有指令 (尽可能清空，防止延迟堆积)
-    HidCommand cmd;
-    while (HidPacketQueue::instance()->pop(cmd)) {
-        if (!m_driver) continue;
-
-        if (cmd.type == HidCommand::CMD_MOUSE_ABS) {
-            m_driver->sendMouseAbs(cmd.param1, cmd.param2, cmd.param3, cmd.param4);
-            //qDebug()<<"ABSmode";
-            //qDebug()<<"x:"<<cmd.param1<<",y:"<<cmd.param2<<",button:"<<cmd.param3<<",wheel:"<<cmd.param4;
-        }
-        else if (cmd.type == HidCommand::CMD_MOUSE_REL) {
-            m_driver->sendMouseRel(cmd.param1, cmd.param2, cmd.param3, cmd.param4);
-            //qDebug()<<"RELmode";
-            //qDebug()<<"x:"<<cmd.param1<<",y:"<<cmd.param2<<",button:"<<cmd.param3<<",wheel:"<<cmd.param4;
-        }
-        else if (cmd.type == HidCommand::CMD_KEYBOARD) {
-            //qDebug()<<"KEYBOD";
-            //qDebug()<<"modifiers:"<<cmd.param1<<",key:"<<cmd.param2;
-            m_driver->sendKbPacket(cmd.param1, cmd.param2);
-        }
-    }
-
-}
-
 // ==========================================
 // 事件过滤器 (负责：解析本地事件 -> Push 队列)
 // ==========================================
 bool HidController::eventFilter(QObject *watched, QEvent *event) {
-    if (m_currentMode == MODE_NONE || !m_driver) {
+    if (m_currentMode == MODE_NONE || !m_driverReady) {
         return QObject::eventFilter(watched, event);
     }
 
@@ -154,6 +190,11 @@ bool HidController::eventFilter(QObject *watched, QEvent *event) {
 
     // 解析并 Push
     switch (event->type()) {
+        case QEvent::FocusOut:
+        case QEvent::WindowDeactivate:
+            // 焦点离开后收不到 KeyRelease，先松开所有键，防止被控端按键卡住
+            releaseLocalKeys();
+            break;
         case QEvent::KeyPress:
         case QEvent::KeyRelease:
             parseLocalKey(static_cast<QKeyEvent*>(event), event->type() == QEvent::KeyPress);
@@ -176,6 +217,9 @@ bool HidController::eventFilter(QObject *watched, QEvent *event) {
 // 本地鼠标解析
 void HidController::parseLocalMouse(QEvent *evt)
 {
+    // 事件时刻：延迟统计从这里算起 (事件 -> 入队 -> 调度 -> 写出)
+    const int64_t eventUs = LatencyHistogram::nowUs();
+
     // === 1. 优先处理滚轮事件 (强制走相对模式) ===
     if (evt->type() == QEvent::Wheel) {
         QWheelEvent *we = static_cast<QWheelEvent*>(evt);
@@ -193,18 +237,14 @@ void HidController::parseLocalMouse(QEvent *evt)
             cmd.param2 = 0; // yRel
             cmd.param3 = 0; // buttons
             cmd.param4 = wheelByte;
+            cmd.markEvent(HidCommand::SRC_LOCAL, eventUs);
             HidPacketQueue::instance()->push(cmd);
         }
         // 滚轮处理完毕，直接返回，不走下面的坐标计算逻辑
         return;
-    }else if (evt->type() == QEvent::MouseMove) {
-        // === 鼠标移动限流逻辑 === 50Hz采样降频 === 仅针对 MouseMove
-        qint64 now = m_elapsedTimer.elapsed();
-        if (now - m_lastMouseMoveTime < 20) {
-            return; // 距离上次发送不足 20ms，直接丢弃该包
-        }
-        m_lastMouseMoveTime = now; // 更新发送时间
     }
+    // MouseMove 不在这里限流：全部入队，由 HID I/O 线程按链路速率合并
+    // (原先丢弃 20ms 内的移动，点击前的最终位置可能丢失)
 
     // === 2. 处理普通鼠标事件 (按键/移动) ===
     // 此时肯定是 MouseButtonPress / Release / Move
@@ -234,6 +274,7 @@ void HidController::parseLocalMouse(QEvent *evt)
         cmd.param2 = hidY;
         cmd.param3 = getHidButtonState(buttons);
         cmd.param4 = 0; // 移动事件不带滚轮 (滚轮已在上方独立处理)
+        cmd.markEvent(HidCommand::SRC_LOCAL, eventUs);
         HidPacketQueue::instance()->push(cmd);
     }
 
@@ -254,9 +295,8 @@ void HidController::parseLocalMouse(QEvent *evt)
                 return;
             }
             else if ((buttons & Qt::RightButton)){
-                // 2. 右键点击：逻辑独立，优先处理 (直接发送按下+松开)
-                HidPacketQueue::instance()->push({HidCommand::CMD_MOUSE_REL, 0, 0, 2, 0});
-                HidPacketQueue::instance()->push({HidCommand::CMD_MOUSE_REL, 0, 0, 0, 0});
+                // 2. 右键点击：逻辑独立，优先处理 (按下，保持 CLICK_HOLD_MS 后松开)
+                click(MOUSE_RIGHT);
                 return;
             }
         }
@@ -267,7 +307,8 @@ void HidController::parseLocalMouse(QEvent *evt)
                 int dx = currentPos.x() - m_lastPos.x();
                 int dy = currentPos.y() - m_lastPos.y();
                 // 发送相对位移指令
-                HidCommand cmd = {HidCommand::CMD_MOUSE_REL, qBound(-127, dx, 127), qBound(-127, dy, 127), 0, 0};
+                HidCommand cmd = {HidCommand::CMD_MOUSE_REL, qBound(-127, dx, 127), qBound(-127, dy, 127), 0, 0, 0, 0, HidCommand::SRC_INTERNAL};
+                cmd.markEvent(HidCommand::SRC_LOCAL, eventUs);
                 HidPacketQueue::instance()->push(cmd);
                 m_lastPos = currentPos; // 更新基准点 (跟随移动)
                 m_is_click = false; // 产生了有效位移，不再视为点击
@@ -277,8 +318,7 @@ void HidController::parseLocalMouse(QEvent *evt)
         else if (type == QEvent::MouseButtonRelease && m_is_left_down) {
             // 如果判定为点击 (且松开时位置未偏离太远)
             if (m_is_click && (currentPos - m_lastPos).manhattanLength() < 3) {
-                HidPacketQueue::instance()->push({HidCommand::CMD_MOUSE_REL, 0, 0, 1, 0});
-                HidPacketQueue::instance()->push({HidCommand::CMD_MOUSE_REL, 0, 0, 0, 0});
+                click(MOUSE_LEFT);
             }
             m_is_left_down = false; // 重置状态
             m_lastPos = currentPos;
@@ -290,6 +330,7 @@ void HidController::parseLocalMouse(QEvent *evt)
 void HidController::parseLocalKey(QKeyEvent *e, bool isPress)
 {
     if (e->isAutoRepeat()) return;
+    const int64_t eventUs = LatencyHistogram::nowUs();
 
     // 查表逻辑 (这里复用之前的 m_keyMap)
     int key = e->key();
@@ -300,15 +341,23 @@ void HidController::parseLocalKey(QKeyEvent *e, bool isPress)
         hidCode = m_keyMap[key];
     }
 
-    // 构造命令 Push (isPress 决定是否发送 0)
-    HidCommand cmd;
-    cmd.type = HidCommand::CMD_KEYBOARD;
-    cmd.param1 = mods;
-    cmd.param2 = isPress ? hidCode : 0x00;
-
+    // 只送增量 (修饰键单独按下时 hidCode 为 0，只更新修饰键)；
+    // HID I/O 线程与其他来源合并，报告内容变化时才发送
+    HidCommand cmd = {HidCommand::CMD_KEY, mods, hidCode, 0,
+                      isPress ? HidCommand::KEY_PRESS : HidCommand::KEY_RELEASE, 0, 0, HidCommand::SRC_LOCAL};
+    cmd.markEvent(HidCommand::SRC_LOCAL, eventUs);
     HidPacketQueue::instance()->push(cmd);
 }
 
+void HidController::releaseLocalKeys()
+{
+    // 空集合：只松开本地按住的键，网页端等其他来源按住的保持
+    if (m_driverReady) {
+        HidCommand cmd = {HidCommand::CMD_KEYBOARD, 0, 0, 0, 0, 0, 0, HidCommand::SRC_LOCAL};
+        HidPacketQueue::instance()->push(cmd);
+    }
+}
+
 
 // === 修饰符转换 ===
 uint8_t HidController::qtModifiersToHid(Qt::KeyboardModifiers modifiers) {
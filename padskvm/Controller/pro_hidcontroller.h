@@ -1,12 +1,12 @@
 #ifndef PRO_HIDCONTROLLER_H
 #define PRO_HIDCONTROLLER_H
 
-#include "../Driver/drv_ch9329.h"
 #include "../Tool/safe_queue.h"
+#include "../Tool/latency_histogram.h"
+#include "pro_hidio.h"
 
 #include <QWidget>
-#include <QTimer>
-#include <QElapsedTimer> // 使用 QElapsedTimer 更精准
+#include <QThread>
 #include <QKeyEvent>
 
 // 定义操作模式
@@ -24,7 +24,35 @@ public:
     ~HidController();
 
     // === 辅助函数（对外接口） ===
+    // 在 HID I/O 线程中打开 HID 后端并检查连接 (调用方等待结果)
+    // portName 为串口时使用 CH9329：自动探测芯片当前波特率并尝试升到 115200，baud 只作为首次连接的候选
+    // portName 为 "gadget:..." 描述串时直接写 /dev/hidgN (见 HidGadgetDriver)
     bool initDriver(const QString &portName, int baud);
+    // 协商后实际使用的波特率 (未连接或 USB gadget 后端为 0)
+    int linkBaudRate() const { return m_io->linkBaudRate(); }
+    // HID I/O 线程使用实时调度 (SCHED_FIFO)，降低系统繁忙时的发送抖动
+    void setRealtimePriority(bool enable, int priority = 50);
+    // 批量输入文本 (密码、脚本、配置文件)：按键盘布局 ("us"/"uk") 转成连续的键盘报告，
+    // 在 HID I/O 线程中按串口速率发送。intervalMs 为相邻报告最小间隔 (0 只受串口限制)，
+    // verify 为 true 时逐键按下/松开且等芯片应答后再发下一份 (适合 BIOS 等较慢的主机)
+    void typeText(const QString &text, const QString &layout = "us", int intervalMs = 2, bool verify = false);
+    // 放弃尚未输入的文本
+    void cancelTyping();
+
+    // === 定时动作 (在 HID I/O 线程的时间轮上执行，不阻塞调用线程) ===
+    // 鼠标点击：按下 buttons，holdMs 后松开
+    quint32 click(uint8_t buttons, int holdMs = CLICK_HOLD_MS);
+    // 长按 (触控模式下的右键菜单等)
+    quint32 longPress(uint8_t buttons) { return click(buttons, LONG_PRESS_MS); }
+    // 单击一个键盘键：按下 (修饰键 + 键码)，holdMs 后松开
+    quint32 tapKey(uint8_t mods, uint8_t key, int holdMs = CLICK_HOLD_MS);
+    // 宏序列：每一步在上一步之后 delayMs 送出，返回 id
+    quint32 runMacro(const HidMacro &macro);
+    // 取消未执行完的宏 (会补发全松开)
+    void cancelMacro(quint32 id);
+
+    static const int CLICK_HOLD_MS = 50;
+    static const int LONG_PRESS_MS = 800;
     // 设置鼠标控制模式
     void setControlMode(HidControlMode mode);
     // 设置视频源分辨率 (在初始时调用一次即可)
@@ -32,18 +60,30 @@ public:
     // 重新计算HID边界参数
     void updateScaleParams();
 
+    // 指令延迟统计：入队 -> 写入串口 (QSerialPort::write 返回)
+    const LatencyHistogram &dispatchLatency() const { return m_io->dispatchLatency(); }
+    // 输入路径延迟 (事件 -> 写完成)：按来源 (本地/网页) 与指令类型的滚动 p50/p99
+    const HidInputLatency &inputLatency() const { return m_io->inputLatency(); }
+    // 串口发送调度统计：各车道 (输入/运动) 排队延迟、发送数、被替换的运动包数
+    const HidScheduler &scheduler() const { return m_io->scheduler(); }
+    // CH9329 应答统计：各类指令往返时间 (发送 -> 应答)、NAK 状态码、重发/丢失计数
+    const CH9329LinkStats &linkStats() const { return m_io->linkStats(); }
+
+signals:
+    // 一段文本输入完成：字符数、跳过的字符数 (当前布局无法输入)、耗时
+    void typingFinished(int chars, int skipped, qint64 elapsedUs);
+
 protected:
     // === 核心：事件过滤器 ===
     bool eventFilter(QObject *watched, QEvent *event) override;
-private slots:
-    // 统一的主循环 (10ms)
-    void onMainLoop();
 
 private:
     //本地鼠标事件
     void parseLocalMouse(QEvent *evt);
     //本地键盘事件
     void parseLocalKey(QKeyEvent *e, bool isPress);
+    //松开所有本地按键 (失去焦点/切换模式)
+    void releaseLocalKeys();
 
 
     uint8_t qtModifiersToHid(Qt::KeyboardModifiers modifiers);
@@ -51,13 +91,15 @@ private:
     void initKeyMap();
 
 private:
-    // 一个轮询定时器
-    QTimer *m_mainLoopTimer;
+    // === HID I/O 线程 (持有 HID 后端，负责取队列发送) ===
+    QThread *m_ioThread;
+    HidIoWorker *m_io;
+    bool m_driverReady; // 后端已打开且设备应答
 
     // === 成员变量 ===
-    CH9329Driver *m_driver;
     HidControlMode m_currentMode;
     QMap<int, uint8_t> m_keyMap;
+    quint32 m_nextMacroId;
 
     // === 缓存的几何参数 ===
     QSize m_sourceSize;  // 视频原始尺寸 (如 1920x1080)
@@ -71,11 +113,6 @@ private:
     bool m_is_click;           // 标记是否为点击操作
     bool m_is_left_down;       // 标记左键是否按下
 
-
-    // === 用于鼠标移动限流 ===
-    qint64 m_lastMouseMoveTime; // 上一次处理MouseMove的时间戳
-    // 全局计时器
-    QElapsedTimer m_elapsedTimer;
 };
 
 #endif // PRO_HIDCONTROLLER_H
@@ -0,0 +1,509 @@
+#include "pro_hidio.h"
+#include <QDebug>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <cerrno>
+#include <cstring>
+
+// 文本输入：逐份确认模式下等待应答的上限
+static const qint64 TYPE_ACK_TIMEOUT_US = 100000;
+// 短于此的等待就地睡眠：QTimer 以毫秒计时，115200 下一帧只占 0.6~0.9ms，
+// 向上取整到毫秒 (再加定时器自身的误差) 会让每帧多等一倍，链路只能跑到一半速率
+static const qint64 INLINE_WAIT_MAX_US = 1000;
+// pump 单次调用就地睡眠的总时长上限，超过后让出事件循环 (处理应答与新指令) 再继续
+static const qint64 PUMP_INLINE_BUDGET_US = 3000;
+
+// 精确睡眠 (本线程只做 HID I/O，短暂阻塞不影响其他线程)
+static void sleepUs(qint64 us)
+{
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+// 等待 waitUs 后再调用：不足 INLINE_WAIT_MAX_US 时就地睡眠并返回 true (调用方直接继续)；
+// 否则按整毫秒向下取整定时并返回 false，提前醒来的零头在下一次调用时就地补齐
+static bool waitOrArm(QTimer *timer, qint64 waitUs)
+{
+    if (waitUs < INLINE_WAIT_MAX_US) {
+        sleepUs(waitUs);
+        return true;
+    }
+    if (!timer->isActive()) timer->start((int)(waitUs / 1000));
+    return false;
+}
+
+HidIoWorker::HidIoWorker(QObject *parent)
+    : QObject(parent),
+      m_backend(nullptr), m_queueNotifier(nullptr), m_linkTimer(nullptr),
+      m_flushedBytes(0), m_lastLatencyReport(0), m_linkBaud(0),
+      m_wheel(LatencyHistogram::nowUs()), m_wheelTimer(nullptr), m_inputButtons(0),
+      m_typeTimer(nullptr), m_typeIntervalUs(0), m_typeVerify(false), m_typeAwaitAck(false),
+      m_typeNextUs(0), m_typeStartUs(0), m_typeCharsAtStart(0), m_typeSkipped(0)
+{
+}
+
+HidIoWorker::~HidIoWorker()
+{
+    // 正常流程中 shutdown() 已在 I/O 线程内释放资源
+    shutdown();
+}
+
+void HidIoWorker::setup()
+{
+    if (m_queueNotifier) return;
+
+    // 队列事件驱动：任意线程入队后 eventfd 可读，立即回调发送
+    m_queueNotifier = new QSocketNotifier(HidPacketQueue::instance()->notifyFd(), QSocketNotifier::Read, this);
+    connect(m_queueNotifier, &QSocketNotifier::activated, this, &HidIoWorker::onQueueReady);
+
+    m_linkTimer = new QTimer(this);
+    m_linkTimer->setSingleShot(true);
+    m_linkTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_linkTimer, &QTimer::timeout, this, &HidIoWorker::pump);
+
+    m_wheelTimer = new QTimer(this);
+    m_wheelTimer->setSingleShot(true);
+    m_wheelTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_wheelTimer, &QTimer::timeout, this, &HidIoWorker::onWheelTimer);
+
+    m_typeTimer = new QTimer(this);
+    m_typeTimer->setSingleShot(true);
+    m_typeTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_typeTimer, &QTimer::timeout, this, &HidIoWorker::typeStep);
+}
+
+bool HidIoWorker::openDevice(const QString &portName, int baud)
+{
+    setup();
+    releaseBackend();
+    m_scheduler.clear();
+    m_keys.clear();
+    m_macroMouse.clear();
+    m_inputButtons = 0;
+    m_linkBaud = 0;
+
+    if (HidGadgetDriver::isGadgetSpec(portName)) return openGadget(portName);
+    return openCh9329(portName, baud);
+}
+
+bool HidIoWorker::openCh9329(const QString &portName, int baud)
+{
+    // 驱动 (及其 QSerialPort 子对象) 在本线程创建，串口事件由本线程的事件循环处理
+    // 协商期间使用同步收发，尚未开启应答跟踪
+    CH9329Driver *driver = new CH9329Driver(this);
+
+    // 1. 先用上次协商成功的速率 (没有记录则用界面选择的速率)
+    int startBaud = CH9329Driver::savedBaudRate(portName, baud);
+    if (!driver->init(portName, startBaud)) {
+        delete driver;
+        return false;
+    }
+
+    // 2. 不通则逐个探测常用速率 (芯片可能已被改过、或记录已失效)
+    int linkBaud = driver->checkConnection() ? startBaud : 0;
+    if (linkBaud == 0) {
+        QList<int> candidates;
+        candidates << baud;
+        for (int b : CH9329Driver::standardBaudRates()) {
+            if (b != baud && b != startBaud) candidates << b;
+        }
+        linkBaud = driver->probeBaudRate(candidates);
+    }
+
+    // 3. 升到最高速率：9600 下一包绝对坐标约 13ms，115200 下约 1.1ms
+    if (linkBaud != 0) linkBaud = driver->upgradeBaudRate(LINK_TARGET_BAUD);
+    if (linkBaud == 0) {
+        delete driver; // 关闭串口
+        return false;
+    }
+
+    // 4. 记录结果，下次直接以该速率连接
+    CH9329Driver::saveBaudRate(portName, linkBaud);
+    m_linkBaud = linkBaud;
+    m_linkStats.reset();
+    driver->setAckTracking(&m_linkStats);
+    attachBackend(driver);
+    qDebug() << "[HIDIO] Link up at" << linkBaud << "baud";
+    return true;
+}
+
+bool HidIoWorker::openGadget(const QString &spec)
+{
+    HidGadgetDriver *driver = new HidGadgetDriver(this);
+    if (!driver->init(spec)) {
+        delete driver;
+        return false;
+    }
+    attachBackend(driver);
+    qDebug() << "[HIDIO] Link up on USB gadget, report interval" << driver->minReportIntervalUs() << "us";
+    return true;
+}
+
+void HidIoWorker::attachBackend(HidBackend *backend)
+{
+    m_backend = backend;
+    connect(m_backend, &HidBackend::retransmitted, this, &HidIoWorker::onRetransmitted);
+    connect(m_backend, &HidBackend::acknowledged, this, &HidIoWorker::onAcknowledged);
+    connect(m_backend, &HidBackend::bytesFlushed, this, &HidIoWorker::onBytesFlushed);
+    m_scheduler.setBaudRate(m_backend->baudRate());
+    m_scheduler.setMinPacketIntervalUs(m_backend->minReportIntervalUs());
+}
+
+void HidIoWorker::releaseBackend()
+{
+    if (!m_backend) return;
+    delete m_backend; // 析构时关闭设备
+    m_backend = nullptr;
+    m_pendingWrites.clear();
+    m_flushedBytes = 0;
+}
+
+void HidIoWorker::applyRealtime(bool enable, int priority)
+{
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    int policy = SCHED_OTHER;
+    if (enable) {
+        policy = SCHED_FIFO;
+        int lo = sched_get_priority_min(SCHED_FIFO);
+        int hi = sched_get_priority_max(SCHED_FIFO);
+        sp.sched_priority = qBound(lo, priority, hi);
+    }
+
+    int ret = pthread_setschedparam(pthread_self(), policy, &sp);
+    if (ret != 0) {
+        qDebug() << "[HIDIO] Set scheduling policy failed:" << strerror(ret)
+                 << (enable ? "(SCHED_FIFO 需要 root 或 CAP_SYS_NICE)" : "");
+        return;
+    }
+    qDebug() << "[HIDIO] Scheduling:" << (enable ? "SCHED_FIFO" : "SCHED_OTHER") << sp.sched_priority;
+}
+
+void HidIoWorker::shutdown()
+{
+    if (m_wheelTimer) {
+        m_wheelTimer->stop();
+        delete m_wheelTimer;
+        m_wheelTimer = nullptr;
+    }
+    if (m_typeTimer) {
+        m_typeTimer->stop();
+        delete m_typeTimer;
+        m_typeTimer = nullptr;
+    }
+    if (m_linkTimer) {
+        m_linkTimer->stop();
+        delete m_linkTimer;
+        m_linkTimer = nullptr;
+    }
+    if (m_queueNotifier) {
+        m_queueNotifier->setEnabled(false);
+        delete m_queueNotifier;
+        m_queueNotifier = nullptr;
+    }
+    releaseBackend();
+}
+
+void HidIoWorker::onQueueReady()
+{
+    // 先确认通知再取指令，之后的入队会重新唤醒
+    HidPacketQueue::instance()->acknowledge();
+
+    // 取出队列中的所有指令交给调度器分道 (尽可能清空，防止延迟堆积)
+    HidCommand cmd;
+    while (HidPacketQueue::instance()->pop(cmd)) {
+        if (cmd.type == HidCommand::CMD_MOUSE_ABS || cmd.type == HidCommand::CMD_MOUSE_REL) {
+            m_inputButtons = (uint8_t)cmd.param3;
+        }
+        submit(cmd, HidKeyboardState::holderOf(cmd));
+    }
+    pump();
+}
+
+bool HidIoWorker::submit(const HidCommand &cmd, HidKeyboardState::Holder holder)
+{
+    if (!HidKeyboardState::isKeyboard(cmd)) {
+        m_scheduler.push(cmd);
+        return true;
+    }
+    // 合并后的报告没有变化 (重复按下、其他来源仍按住该键等) 时不发送
+    if (!m_keys.apply(holder, cmd)) return false;
+    HidCommand report = m_keys.command();
+    // 延迟统计沿用触发这次变化的事件
+    report.stampUs = cmd.stampUs;
+    report.eventUs = cmd.eventUs;
+    report.source = cmd.source;
+    m_scheduler.push(report);
+    return true;
+}
+
+void HidIoWorker::pump()
+{
+    if (!m_backend) return;
+
+    HidCommand cmd;
+    HidScheduler::Lane lane;
+    qint64 sleptUs = 0;
+    for (;;) {
+        if (!m_scheduler.hasPending() || !m_linkTimer) return;
+        qint64 now = LatencyHistogram::nowUs();
+        qint64 waitUs = m_scheduler.idleInUs(now);
+        if (waitUs > 0) {
+            // 链路忙：剩余指令留在车道里继续合并/排序，到空闲时刻再来
+            // 就地睡眠超过预算后让出事件循环，期间到达的指令还能参与合并
+            if (sleptUs >= PUMP_INLINE_BUDGET_US) {
+                if (!m_linkTimer->isActive()) m_linkTimer->start(0);
+                return;
+            }
+            if (!waitOrArm(m_linkTimer, waitUs)) return;
+            sleptUs += waitUs;
+            continue;
+        }
+        if (!m_scheduler.next(cmd, lane)) return;
+
+        int bytes = send(cmd);
+        if (bytes == 0) continue;
+        m_scheduler.onSent(lane, cmd, bytes, now);
+        m_dispatchLatency.record(now - cmd.stampUs);
+        trackWrite(cmd, bytes, true, now);
+        reportStats();
+    }
+}
+
+void HidIoWorker::typeText(const QString &text, const QString &layout, int intervalMs, bool verify)
+{
+    HidTextTyper::Layout kbLayout;
+    if (!HidTextTyper::layoutFromName(layout, kbLayout)) {
+        qDebug() << "[HIDIO] Unknown keyboard layout:" << layout;
+        return;
+    }
+
+    m_typeIntervalUs = (qint64)qMax(0, intervalMs) * 1000;
+    m_typeVerify = verify;
+    m_typer.setPerKeyRelease(verify);
+    if (m_typeStartUs == 0) {
+        m_typeStartUs = LatencyHistogram::nowUs();
+        m_typeCharsAtStart = m_typer.typedChars();
+        m_typeSkipped = 0;
+    }
+    m_typeSkipped += m_typer.append(text, kbLayout);
+    typeStep();
+}
+
+void HidIoWorker::cancelTyping()
+{
+    m_typer.clear();
+    typeStep(); // 送出松开报告
+}
+
+void HidIoWorker::typeStep()
+{
+    if (!m_backend || !m_typeTimer || m_typeStartUs == 0) return;
+
+    qint64 now = LatencyHistogram::nowUs();
+    qint64 waitUs = qMax(m_scheduler.idleInUs(now), m_typeNextUs - now);
+    if (m_typeAwaitAck) {
+        // 等待应答，超时 (应答丢失或未开启跟踪) 后继续
+        waitUs = qMax(waitUs, m_typeNextUs + TYPE_ACK_TIMEOUT_US - now);
+    }
+    if (waitUs > 0) {
+        if (!waitOrArm(m_typeTimer, waitUs)) return;
+        now = LatencyHistogram::nowUs();
+    }
+
+    HidCommand cmd;
+    if (m_typer.nextReport(cmd)) {
+        cmd.stampUs = now;
+        // 合并后报告不变 (如本地正按住同一个键) 时没有写出，也就没有应答可等
+        bool queued = submit(cmd, HidKeyboardState::HOLDER_TYPER);
+        pump();
+        m_typeNextUs = now + m_typeIntervalUs;
+        m_typeAwaitAck = m_typeVerify && queued;
+    }
+
+    if (m_typer.hasPending()) {
+        m_typeTimer->start(0);
+        return;
+    }
+
+    // 本段输入完成：输出吞吐量
+    qint64 elapsed = now - m_typeStartUs;
+    int chars = (int)(m_typer.typedChars() - m_typeCharsAtStart);
+    qDebug() << "[HIDIO] Typed" << chars << "chars in" << elapsed / 1000 << "ms ("
+             << (elapsed > 0 ? chars * 1000000LL / elapsed : 0) << "chars/s ), skipped" << m_typeSkipped
+             << "| link:" << m_backend->statsSummary().c_str();
+    emit typingFinished(chars, m_typeSkipped, elapsed);
+    m_typeStartUs = 0;
+    m_typeAwaitAck = false;
+}
+
+void HidIoWorker::onAcknowledged(int type, bool ok)
+{
+    Q_UNUSED(ok);
+    // 键盘报告的应答：解除等待 (报错时芯片不再重发，同样继续下一份，避免卡住)
+    if (!m_typeAwaitAck || type != HidCommand::CMD_KEYBOARD) return;
+    m_typeAwaitAck = false;
+    if (m_typeTimer) m_typeTimer->stop();
+    typeStep();
+}
+
+void HidIoWorker::runMacro(quint32 id, const HidMacro &macro)
+{
+    if (!m_backend || !m_wheelTimer) return;
+
+    // 各步相对上一步计时；按下/松开都经过同一条 INPUT 车道，链路延迟相同，按住时长保持准确
+    qint64 due = LatencyHistogram::nowUs();
+    for (const HidMacroStep &step : macro) {
+        due += (qint64)qMax(0, step.delayMs) * 1000;
+        m_wheel.schedule(due, step.cmd, id);
+    }
+    onWheelTimer();
+}
+
+void HidIoWorker::cancelMacro(quint32 id)
+{
+    int cancelled = m_wheel.cancelGroup(id);
+    auto held = m_macroMouse.find(id);
+    if (cancelled == 0 && held == m_macroMouse.end()) return;
+
+    qint64 now = LatencyHistogram::nowUs();
+    // 未送出的步骤里可能有松开动作：松开定时动作按住的键，防止卡住
+    if (cancelled > 0) {
+        HidCommand releaseKeys = {HidCommand::CMD_KEYBOARD, 0, 0, 0, 0, now, 0, HidCommand::SRC_INTERNAL};
+        submit(releaseKeys, HidKeyboardState::HOLDER_MACRO);
+    }
+    // 只松开该组按下的鼠标按键：沿用它最后一份报告的类型与位置，不带位移/滚轮，
+    // 按键为本地/网页端与其他宏仍按住的部分 (不打断用户正在进行的拖动)
+    if (held != m_macroMouse.end()) {
+        HidCommand release = held->second;
+        m_macroMouse.erase(held);
+        uint8_t buttons = m_inputButtons;
+        for (const auto &other : m_macroMouse) buttons |= (uint8_t)other.second.param3;
+        if (release.type == HidCommand::CMD_MOUSE_REL) {
+            release.param1 = 0;
+            release.param2 = 0;
+        }
+        release.param3 = buttons;
+        release.param4 = 0;
+        release.stampUs = now;
+        m_scheduler.push(release);
+    }
+    pump();
+    onWheelTimer();
+}
+
+void HidIoWorker::onWheelTimer()
+{
+    if (!m_wheelTimer) return;
+
+    qint64 now = LatencyHistogram::nowUs();
+    // 定时器按毫秒向下取整，提前醒来的零头就地补齐
+    qint64 next = m_wheel.nextDueUs();
+    if (next > now && next - now < INLINE_WAIT_MAX_US) {
+        sleepUs(next - now);
+        now = LatencyHistogram::nowUs();
+    }
+    std::vector<HidCommand> due;
+    std::vector<quint32> groups;
+    m_wheel.advance(now, due, &groups);
+    for (size_t i = 0; i < due.size(); ++i) {
+        HidCommand &cmd = due[i];
+        cmd.stampUs = now;
+        // 记录各组留下的鼠标按键，取消时只松开这些
+        if (cmd.type == HidCommand::CMD_MOUSE_ABS || cmd.type == HidCommand::CMD_MOUSE_REL) {
+            if (cmd.param3 != 0) m_macroMouse[groups[i]] = cmd;
+            else m_macroMouse.erase(groups[i]);
+        }
+        submit(cmd, HidKeyboardState::HOLDER_MACRO);
+    }
+    if (!due.empty()) pump();
+
+    // 只在有任务时定时，空闲时不唤醒
+    next = m_wheel.nextDueUs();
+    if (next < 0) {
+        m_wheelTimer->stop();
+        return;
+    }
+    m_wheelTimer->start((int)qMax<qint64>(0, (next - now) / 1000));
+}
+
+void HidIoWorker::onRetransmitted(int bytes)
+{
+    qint64 now = LatencyHistogram::nowUs();
+    m_scheduler.chargeLink(bytes, now);
+    // 重发的字节同样会出现在写完成通知中，占位但不计入延迟
+    trackWrite(HidCommand(), bytes, false, now);
+}
+
+void HidIoWorker::onBytesFlushed(qint64 bytes)
+{
+    m_flushedBytes += bytes;
+    settleWrites(LatencyHistogram::nowUs());
+}
+
+void HidIoWorker::trackWrite(const HidCommand &cmd, int bytes, bool sample, qint64 nowUs)
+{
+    // 设备长时间不完成 (串口被占满) 时丢弃最旧的登记，防止堆积；
+    // 它的字节之后仍会完成，先记为负数抵消
+    if (m_pendingWrites.size() >= MAX_PENDING_WRITES) {
+        m_flushedBytes -= m_pendingWrites.front().bytes;
+        m_pendingWrites.pop_front();
+    }
+    PendingWrite write = {cmd, nowUs, bytes, sample};
+    m_pendingWrites.push_back(write);
+    // gadget 的写完成在 write() 内同步通知，先于这里登记
+    settleWrites(nowUs);
+}
+
+void HidIoWorker::settleWrites(qint64 nowUs)
+{
+    while (!m_pendingWrites.empty() && m_flushedBytes >= m_pendingWrites.front().bytes) {
+        const PendingWrite &write = m_pendingWrites.front();
+        m_flushedBytes -= write.bytes;
+        if (write.sample) m_inputLatency.record(write.cmd, write.writeUs, nowUs);
+        m_pendingWrites.pop_front();
+    }
+}
+
+void HidIoWorker::reportStats()
+{
+    // 每累计 1000 条输出一次延迟分布
+    uint64_t total = m_dispatchLatency.count();
+    if (total / 1000 == m_lastLatencyReport) return;
+    m_lastLatencyReport = total / 1000;
+    qDebug() << "[HIDIO] Dispatch latency:" << m_dispatchLatency.summary().c_str()
+             << "| input:" << m_scheduler.queueDelay(HidScheduler::LANE_INPUT).summary().c_str()
+             << "| motion:" << m_scheduler.queueDelay(HidScheduler::LANE_MOTION).summary().c_str()
+             << "replaced:" << m_scheduler.replacedMotionCount();
+    if (m_backend) qDebug() << "[HIDIO] Link (" << m_backend->name() << "):" << m_backend->statsSummary().c_str();
+    m_inputLatency.advance(LatencyHistogram::nowUs());
+    qDebug() << "[HIDIO] Input latency (" << HidInputLatency::kWindowUs / 1000000 << "s window):"
+             << m_inputLatency.summary().c_str();
+}
+
+int HidIoWorker::send(const HidCommand &cmd)
+{
+    int bytes = 0;
+    if (cmd.type == HidCommand::CMD_MOUSE_ABS) {
+        bytes = m_backend->sendMouseAbs(cmd.param1, cmd.param2, cmd.param3, cmd.param4);
+        //qDebug()<<"ABSmode";
+        //qDebug()<<"x:"<<cmd.param1<<",y:"<<cmd.param2<<",button:"<<cmd.param3<<",wheel:"<<cmd.param4;
+    }
+    else if (cmd.type == HidCommand::CMD_MOUSE_REL) {
+        bytes = m_backend->sendMouseRel(cmd.param1, cmd.param2, cmd.param3, cmd.param4);
+        //qDebug()<<"RELmode";
+        //qDebug()<<"x:"<<cmd.param1<<",y:"<<cmd.param2<<",button:"<<cmd.param3<<",wheel:"<<cmd.param4;
+    }
+    else if (cmd.type == HidCommand::CMD_KEYBOARD) {
+        //qDebug()<<"KEYBOD";
+        //qDebug()<<"modifiers:"<<cmd.param1<<",key:"<<cmd.param2;
+        uint8_t keys[HidCommand::kKeySlots];
+        cmd.getKeys(keys);
+        bytes = m_backend->sendKbReport(cmd.param1, keys);
+    }
+
+    return bytes;
+}
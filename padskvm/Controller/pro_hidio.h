@@ -0,0 +1,153 @@
+#ifndef PRO_HIDIO_H
+#define PRO_HIDIO_H
+
+#include "../Driver/drv_ch9329.h"
+#include "../Driver/drv_hidgadget.h"
+#include "../Tool/safe_queue.h"
+#include "../Tool/latency_histogram.h"
+#include "pro_hidscheduler.h"
+#include "pro_hidtyper.h"
+#include "pro_hidtimerwheel.h"
+#include "pro_hidlatency.h"
+#include "pro_hidkeyboard.h"
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <atomic>
+#include <deque>
+#include <map>
+
+// HID I/O 工作对象 (运行在独立线程中)
+// 持有当前 HID 后端 (CH9329 串口或 USB gadget)，监听 HID 队列并发送。
+// 串口写入不再排在 GUI 线程的绘制/缩放之后，也不会反过来阻塞 UI 或视频线程。
+// 键盘状态只在这里维护一份：各来源送来的按下/松开增量合并后，由本线程生成发往设备的唯一报告
+// 除 dispatchLatency() 外，所有接口都必须通过 QMetaObject::invokeMethod 在本线程调用
+class HidIoWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HidIoWorker(QObject *parent = nullptr);
+    ~HidIoWorker();
+
+    // 指令延迟统计：入队 -> 写入串口 (线程安全，可在任意线程读取)
+    const LatencyHistogram &dispatchLatency() const { return m_dispatchLatency; }
+    // 输入路径延迟：事件 -> 写完成，按来源与指令类型分组的滚动 p50/p99 (线程安全)
+    const HidInputLatency &inputLatency() const { return m_inputLatency; }
+    // 发送调度统计 (各车道排队延迟、发送数、被替换的运动包数)
+    const HidScheduler &scheduler() const { return m_scheduler; }
+    // CH9329 应答统计：各类指令往返时间、NAK 状态码、重发/丢失计数 (线程安全)
+    const CH9329LinkStats &linkStats() const { return m_linkStats; }
+    // 协商后的串口波特率 (未连接或 USB gadget 后端为 0，线程安全)
+    int linkBaudRate() const { return m_linkBaud; }
+
+    // 初始化时尝试升到的目标波特率
+    static const int LINK_TARGET_BAUD = 115200;
+
+public slots:
+    // 线程启动后调用：在本线程内创建队列监听与定时器
+    void setup();
+    // 按设备名选择后端并打开 (阻塞本线程，调用方用 BlockingQueuedConnection 取结果)
+    // - "gadget:..." 描述串：USB gadget 后端 (见 HidGadgetDriver)，baud 不使用
+    // - 其他视为串口：先用上次记录的速率，不通则探测常用速率，连上后升到 LINK_TARGET_BAUD 并记录
+    bool openDevice(const QString &portName, int baud);
+    // 切换本线程调度策略：true 为 SCHED_FIFO (需要 CAP_SYS_NICE 或 root)，false 恢复 SCHED_OTHER
+    void applyRealtime(bool enable, int priority);
+    // 线程退出前调用：在本线程内销毁驱动与监听
+    void shutdown();
+    // 批量输入文本 (追加到正在输入的文本之后)
+    // intervalMs：相邻两份报告的最小间隔，0 表示只受串口速率限制
+    // verify：每份报告等芯片应答后再发下一份 (需要应答跟踪，否则按超时继续)
+    void typeText(const QString &text, const QString &layout, int intervalMs, bool verify);
+    // 放弃未输入的文本 (已按下的键会被松开)
+    void cancelTyping();
+
+    // 定时动作 (点击/长按/宏)：各步按时间轮到期后进入发送调度，不阻塞任何线程
+    // id 用于取消；取消时若有未送出的步骤，松开定时动作按住的键；该组留有按下的鼠标按键时
+    // 补发一份只松开这些按键的报告 (本地/网页端按住的按键与其他宏按住的保持)
+    void runMacro(quint32 id, const HidMacro &macro);
+    void cancelMacro(quint32 id);
+
+signals:
+    // 一段文本输入完成：字符数、跳过的字符数、耗时
+    void typingFinished(int chars, int skipped, qint64 elapsedUs);
+
+private slots:
+    // 队列有新指令 (eventfd 可读) 时立即触发
+    void onQueueReady();
+    // 链路空闲时按优先级逐包发送，忙则定时到空闲时刻再来
+    void pump();
+    // 后端自动重发：计入链路占用
+    void onRetransmitted(int bytes);
+    // 后端写完成：按写出顺序结算在途指令，记录输入路径延迟
+    void onBytesFlushed(qint64 bytes);
+    // 文本输入：在链路空闲且间隔已到时送出下一份报告
+    void typeStep();
+    // 报告的最终应答 (逐份确认模式下推进文本输入)，type 为 HidCommand::Type
+    void onAcknowledged(int type, bool ok);
+    // 时间轮到期：送出到期的定时动作，并按下一个到期时刻重新定时
+    void onWheelTimer();
+
+private:
+    // 打开 CH9329 串口并协商波特率
+    bool openCh9329(const QString &portName, int baud);
+    // 打开 USB gadget 设备节点
+    bool openGadget(const QString &spec);
+    // 接管后端：连接信号并按其链路模型设置发送调度
+    void attachBackend(HidBackend *backend);
+    // 关闭并释放当前后端
+    void releaseBackend();
+    // 指令进入发送调度：键盘指令先合并进共用的按键状态，合并后的报告变化时才排入
+    // 返回是否排入了指令
+    bool submit(const HidCommand &cmd, HidKeyboardState::Holder holder);
+    // 写出一条指令，返回字节数
+    int send(const HidCommand &cmd);
+    // 每累计 1000 条输出一次延迟统计
+    void reportStats();
+    // 登记一次写出 (sample 为 false 表示不计入延迟统计，如重发)
+    void trackWrite(const HidCommand &cmd, int bytes, bool sample, qint64 nowUs);
+    // 用已完成的字节结算在途写出
+    void settleWrites(qint64 nowUs);
+
+    // 在途写出：按写出顺序排列，写完成的字节依次抵扣
+    struct PendingWrite {
+        HidCommand cmd;
+        qint64 writeUs;
+        qint64 bytes;
+        bool sample;
+    };
+    static const size_t MAX_PENDING_WRITES = 256;
+
+    HidBackend *m_backend;
+    QSocketNotifier *m_queueNotifier;
+    HidScheduler m_scheduler;
+    HidKeyboardState m_keys;      // 所有来源共用的按键状态
+    QTimer *m_linkTimer;          // 链路忙时，到预计空闲时刻唤醒 pump
+    LatencyHistogram m_dispatchLatency;
+    CH9329LinkStats m_linkStats;
+    HidInputLatency m_inputLatency;
+    std::deque<PendingWrite> m_pendingWrites;
+    qint64 m_flushedBytes;        // 已完成但尚未抵扣的字节 (完成通知先于登记时出现)
+    uint64_t m_lastLatencyReport; // 上次输出统计时的计数 (千条)
+    std::atomic<int> m_linkBaud;  // 协商后的波特率
+
+    // 定时动作
+    HidTimerWheel m_wheel;
+    QTimer *m_wheelTimer;
+    // 留有按下鼠标按键的宏：组 -> 该组最近送出的鼠标指令 (按键全部松开后移除)
+    std::map<quint32, HidCommand> m_macroMouse;
+    uint8_t m_inputButtons;       // 本地/网页端最近一次鼠标指令的按键状态
+
+    // 文本输入
+    HidTextTyper m_typer;
+    QTimer *m_typeTimer;
+    qint64 m_typeIntervalUs;
+    bool m_typeVerify;
+    bool m_typeAwaitAck;          // 逐份确认模式：等待上一份报告的应答
+    qint64 m_typeNextUs;          // 下一份报告最早可发送时刻
+    qint64 m_typeStartUs;         // 本段输入开始时刻 (0 表示空闲)
+    quint64 m_typeCharsAtStart;
+    int m_typeSkipped;
+};
+
+#endif // PRO_HIDIO_H
@@ -0,0 +1,148 @@
+#include "pro_hidkeyboard.h"
+#include <cstring>
+
+HidKeyboardState::HidKeyboardState()
+    : m_mods(), m_held(), m_owners(), m_count(0)
+{
+}
+
+HidKeyboardState::Holder HidKeyboardState::holderOf(const HidCommand &cmd)
+{
+    switch (cmd.source) {
+    case HidCommand::SRC_LOCAL: return HOLDER_LOCAL;
+    case HidCommand::SRC_WEB:   return HOLDER_WEB;
+    default:                    return HOLDER_MACRO;
+    }
+}
+
+bool HidKeyboardState::isKeyboard(const HidCommand &cmd)
+{
+    return cmd.type == HidCommand::CMD_KEY || cmd.type == HidCommand::CMD_KEYBOARD;
+}
+
+bool HidKeyboardState::apply(Holder holder, const HidCommand &cmd)
+{
+    uint8_t mods = (uint8_t)cmd.param1;
+    if (cmd.type == HidCommand::CMD_KEY) {
+        uint8_t code = (uint8_t)cmd.param2;
+        return cmd.param4 == HidCommand::KEY_PRESS ? press(holder, mods, code) : release(holder, mods, code);
+    }
+    if (cmd.type == HidCommand::CMD_KEYBOARD) {
+        uint8_t keys[HidCommand::kKeySlots];
+        cmd.getKeys(keys);
+        return setHeld(holder, mods, keys, HidCommand::kKeySlots);
+    }
+    return false;
+}
+
+bool HidKeyboardState::press(Holder holder, uint8_t mods, uint8_t code)
+{
+    Report before = report();
+    m_mods[holder] = mods;
+    if (code != 0) {
+        int i = 0;
+        while (i < m_count && m_held[i] != code) ++i;
+        if (i < m_count) {
+            m_owners[i] |= (uint8_t)(1u << holder);
+        } else if (m_count < kMaxHeld) {
+            // 超出 6 个的键暂不进入报告，报告内容不变
+            m_held[m_count] = code;
+            m_owners[m_count] = (uint8_t)(1u << holder);
+            m_count++;
+        }
+    }
+    return changedSince(before);
+}
+
+bool HidKeyboardState::release(Holder holder, uint8_t mods, uint8_t code)
+{
+    Report before = report();
+    m_mods[holder] = mods;
+    for (int i = 0; code != 0 && i < m_count; ++i) {
+        if (m_held[i] != code) continue;
+        drop(i, holder);
+        break;
+    }
+    return changedSince(before);
+}
+
+bool HidKeyboardState::setHeld(Holder holder, uint8_t mods, const uint8_t *keys, int count)
+{
+    Report before = report();
+    m_mods[holder] = mods;
+
+    // 先去掉本来源不再按住的键，再按报告中的顺序补上新按下的键
+    uint8_t bit = (uint8_t)(1u << holder);
+    for (int i = m_count - 1; i >= 0; --i) {
+        if (!(m_owners[i] & bit)) continue;
+        bool still = false;
+        for (int k = 0; k < count && !still; ++k) still = keys[k] == m_held[i];
+        if (!still) drop(i, holder);
+    }
+    for (int k = 0; k < count; ++k) {
+        if (keys[k] == 0) continue;
+        int i = 0;
+        while (i < m_count && m_held[i] != keys[k]) ++i;
+        if (i < m_count) {
+            m_owners[i] |= bit;
+        } else if (m_count < kMaxHeld) {
+            m_held[m_count] = keys[k];
+            m_owners[m_count] = bit;
+            m_count++;
+        }
+    }
+    return changedSince(before);
+}
+
+bool HidKeyboardState::releaseAll(Holder holder)
+{
+    return setHeld(holder, 0, nullptr, 0);
+}
+
+void HidKeyboardState::clear()
+{
+    memset(m_mods, 0, sizeof(m_mods));
+    m_count = 0;
+}
+
+bool HidKeyboardState::isIdle() const
+{
+    for (int h = 0; h < HOLDER_COUNT; ++h) {
+        if (m_mods[h] != 0) return false;
+    }
+    return m_count == 0;
+}
+
+void HidKeyboardState::drop(int i, Holder holder)
+{
+    m_owners[i] &= (uint8_t)~(1u << holder);
+    if (m_owners[i] != 0) return;
+    for (int j = i + 1; j < m_count; ++j) {
+        m_held[j - 1] = m_held[j];
+        m_owners[j - 1] = m_owners[j];
+    }
+    m_count--;
+}
+
+HidKeyboardState::Report HidKeyboardState::report() const
+{
+    Report r;
+    memset(&r, 0, sizeof(r));
+    for (int h = 0; h < HOLDER_COUNT; ++h) r.bytes[0] |= m_mods[h];
+    for (int i = 0; i < m_count && i < HidCommand::kKeySlots; ++i) r.bytes[1 + i] = m_held[i];
+    return r;
+}
+
+bool HidKeyboardState::changedSince(const Report &before) const
+{
+    Report now = report();
+    return memcmp(before.bytes, now.bytes, sizeof(now.bytes)) != 0;
+}
+
+HidCommand HidKeyboardState::command() const
+{
+    Report r = report();
+    HidCommand cmd = {HidCommand::CMD_KEYBOARD, r.bytes[0], 0, 0, 0, 0, 0, HidCommand::SRC_INTERNAL};
+    cmd.setKeys(r.bytes + 1);
+    return cmd;
+}
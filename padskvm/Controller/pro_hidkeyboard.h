@@ -0,0 +1,71 @@
+#ifndef PRO_HIDKEYBOARD_H
+#define PRO_HIDKEYBOARD_H
+
+#include "../Tool/safe_queue.h"
+
+// 键盘按键状态机 (6KRO)，所有输入源共用一份，由 HID I/O 线程持有
+// - 各输入源 (本地 GUI / 网页 / 文本输入 / 定时动作) 只送来增量：CMD_KEY 按下/松开一个键，
+//   或 CMD_KEYBOARD 表示"本来源当前按住的集合" (网页端与文本输入发送的是整份报告)；
+//   这里合并成发给设备的唯一一份 8 字节报告
+// - 每个键记录被哪些来源按住，所有来源都松开后才从报告中移除；修饰键按来源分别记录后取并集。
+//   某个来源松开全部 (网页断开、本地失去焦点、文本输入结束) 不会松开其他来源按住的键
+// - 报告中的键按首次按下的顺序排列，同时按下超过 6 个键时是最早的 6 个，其中任一松开后后面的键补上
+// - 只有合并后的报告真正变化时才返回 true，调用方据此决定是否发送报告
+// 非线程安全：只在 HID I/O 线程中使用
+class HidKeyboardState
+{
+public:
+    // 按键的持有者
+    enum Holder {
+        HOLDER_LOCAL,   // 本地 GUI
+        HOLDER_WEB,     // 网页端 (所有客户端共用)
+        HOLDER_TYPER,   // 批量文本输入
+        HOLDER_MACRO,   // 定时动作 (tapKey / 宏)
+        HOLDER_COUNT
+    };
+
+    static const int kMaxHeld = 16;
+
+    HidKeyboardState();
+
+    // 队列中指令的持有者 (按来源；SRC_INTERNAL 的键盘指令来自定时动作)
+    static Holder holderOf(const HidCommand &cmd);
+    // 是否为键盘指令 (CMD_KEY / CMD_KEYBOARD)
+    static bool isKeyboard(const HidCommand &cmd);
+
+    // 应用一条键盘指令：CMD_KEY 按 param4 按下/松开 param2，param1 为该来源当前的修饰键；
+    // CMD_KEYBOARD 为该来源按住的完整集合
+    bool apply(Holder holder, const HidCommand &cmd);
+
+    // 按下 / 松开一个 HID 键码 (0 表示只更新修饰键)，mods 为该来源当前的修饰键位图
+    bool press(Holder holder, uint8_t mods, uint8_t code);
+    bool release(Holder holder, uint8_t mods, uint8_t code);
+    // 用一份完整集合覆盖该来源按住的键
+    bool setHeld(Holder holder, uint8_t mods, const uint8_t *keys, int count);
+    // 松开该来源按住的全部键 (其他来源按住的保持)
+    bool releaseAll(Holder holder);
+    // 全部清空 (更换设备时，新设备上没有按住的键)
+    void clear();
+
+    bool isIdle() const;
+
+    // 生成合并后的键盘报告
+    HidCommand command() const;
+
+private:
+    // 报告快照 (修饰键 + 6 个键码)，用于判断是否变化
+    struct Report {
+        uint8_t bytes[1 + HidCommand::kKeySlots];
+    };
+    Report report() const;
+    bool changedSince(const Report &before) const;
+    // 去掉 holder 对第 i 个键的持有，无人持有时移除
+    void drop(int i, Holder holder);
+
+    uint8_t m_mods[HOLDER_COUNT];
+    uint8_t m_held[kMaxHeld];
+    uint8_t m_owners[kMaxHeld];     // 按位记录持有该键的来源 (1 << Holder)
+    int m_count;
+};
+
+#endif // PRO_HIDKEYBOARD_H
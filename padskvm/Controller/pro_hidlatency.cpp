@@ -0,0 +1,141 @@
+#include "pro_hidlatency.h"
+#include <algorithm>
+#include <cstdio>
+
+HidInputLatency::HidInputLatency()
+    : m_active(0), m_hasPrevious(false), m_previousEndUs(0), m_windowStartUs(0)
+{
+}
+
+void HidInputLatency::record(const HidCommand &cmd, int64_t writeUs, int64_t doneUs)
+{
+    if (cmd.type < 0 || cmd.type >= kTypes) return;
+    int source = (cmd.source >= 0 && cmd.source < HidCommand::SRC_COUNT) ? cmd.source : HidCommand::SRC_INTERNAL;
+    // 未标记事件时刻的指令 (程序生成) 从入队算起
+    int64_t eventUs = cmd.eventUs > 0 ? cmd.eventUs : cmd.stampUs;
+
+    advance(doneUs);
+    int64_t us = doneUs - eventUs;
+    m_total[source][cmd.type].record(us);
+    m_window[m_active.load(std::memory_order_relaxed)][source][cmd.type].record(us);
+
+    m_segment[SEG_ENQUEUE].record(cmd.stampUs - eventUs);
+    m_segment[SEG_DISPATCH].record(writeUs - cmd.stampUs);
+    m_segment[SEG_WIRE].record(doneUs - writeUs);
+}
+
+void HidInputLatency::advance(int64_t nowUs)
+{
+    if (m_windowStartUs == 0) {
+        m_windowStartUs = nowUs;
+        return;
+    }
+    int64_t passed = (nowUs - m_windowStartUs) / kWindowUs;
+    if (passed <= 0) return;
+
+    // 刚结束的窗口供读取；空闲超过一个周期时最近一个完整窗口是空的，再轮换一次
+    flip();
+    if (passed >= 2) flip();
+    m_windowStartUs += passed * kWindowUs;
+    m_previousEndUs.store(m_windowStartUs, std::memory_order_relaxed);
+    m_hasPrevious.store(true, std::memory_order_release);
+}
+
+void HidInputLatency::flip()
+{
+    int next = (m_active.load(std::memory_order_relaxed) + 1) % kWindowSlots;
+    for (int s = 0; s < HidCommand::SRC_COUNT; ++s) {
+        for (int t = 0; t < kTypes; ++t) m_window[next][s][t].reset();
+    }
+    m_active.store(next, std::memory_order_release);
+}
+
+const LatencyHistogram &HidInputLatency::window(int source, int type) const
+{
+    int active = m_active.load(std::memory_order_acquire);
+    int idx = m_hasPrevious.load(std::memory_order_acquire) ? (active + kWindowSlots - 1) % kWindowSlots : active;
+    return m_window[idx][source][type];
+}
+
+int64_t HidInputLatency::windowAgeUs(int64_t nowUs) const
+{
+    if (!m_hasPrevious.load(std::memory_order_acquire)) return 0;
+    return std::max<int64_t>(0, nowUs - m_previousEndUs.load(std::memory_order_relaxed));
+}
+
+std::string HidInputLatency::summary() const
+{
+    std::string out;
+    char buf[128];
+    for (int s = 0; s < HidCommand::SRC_COUNT; ++s) {
+        for (int t = 0; t < kTypes; ++t) {
+            const LatencyHistogram &h = window(s, t);
+            if (h.count() == 0) continue;
+            snprintf(buf, sizeof(buf), "%s%s/%s p50=%lldus p99=%lldus (n=%llu)",
+                     out.empty() ? "" : "; ", sourceName(s), typeName(t),
+                     (long long)h.percentileUs(50), (long long)h.percentileUs(99),
+                     (unsigned long long)h.count());
+            out += buf;
+        }
+    }
+    int64_t ageUs = windowAgeUs(LatencyHistogram::nowUs());
+    if (ageUs >= kWindowUs) {
+        snprintf(buf, sizeof(buf), "%s(window ended %llds ago)", out.empty() ? "" : " ",
+                 (long long)(ageUs / 1000000));
+        out += buf;
+    }
+    for (int i = 0; i < SEG_COUNT; ++i) {
+        const LatencyHistogram &h = m_segment[i];
+        if (h.count() == 0) continue;
+        snprintf(buf, sizeof(buf), "%s%s p50=%lldus p99=%lldus",
+                 out.empty() ? "" : " | ", segmentName((Segment)i),
+                 (long long)h.percentileUs(50), (long long)h.percentileUs(99));
+        out += buf;
+    }
+    return out;
+}
+
+void HidInputLatency::reset()
+{
+    for (int s = 0; s < HidCommand::SRC_COUNT; ++s) {
+        for (int t = 0; t < kTypes; ++t) {
+            m_total[s][t].reset();
+            for (int w = 0; w < kWindowSlots; ++w) m_window[w][s][t].reset();
+        }
+    }
+    for (int i = 0; i < SEG_COUNT; ++i) m_segment[i].reset();
+    m_active = 0;
+    m_hasPrevious = false;
+    m_previousEndUs = 0;
+    m_windowStartUs = 0;
+}
+
+const char *HidInputLatency::sourceName(int source)
+{
+    switch (source) {
+    case HidCommand::SRC_INTERNAL: return "internal";
+    case HidCommand::SRC_LOCAL:    return "local";
+    case HidCommand::SRC_WEB:      return "web";
+    default:                       return "?";
+    }
+}
+
+const char *HidInputLatency::typeName(int type)
+{
+    switch (type) {
+    case HidCommand::CMD_MOUSE_ABS: return "abs";
+    case HidCommand::CMD_MOUSE_REL: return "rel";
+    case HidCommand::CMD_KEYBOARD:  return "kb";
+    default:                        return "?";
+    }
+}
+
+const char *HidInputLatency::segmentName(Segment seg)
+{
+    switch (seg) {
+    case SEG_ENQUEUE:  return "event->queue";
+    case SEG_DISPATCH: return "queue->write";
+    case SEG_WIRE:     return "write->done";
+    default:           return "?";
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef PRO_HIDLATENCY_H
+#define PRO_HIDLATENCY_H
+
+#include "../Tool/safe_queue.h"
+#include "../Tool/latency_histogram.h"
+#include <string>
+
+// 输入路径延迟：事件解析 -> 字节交给设备 (串口 bytesWritten / gadget write 返回)
+// - 按来源 (本地/网页/程序生成) × 指令类型 (绝对/相对/键盘) 分组
+// - 每组保留累计分布与滚动窗口分布：窗口按时间每 kWindowUs 轮换一次 (记录与输出统计时推进，
+//   空闲期间经过的窗口为空)，window() 读取最近一个完整窗口 (首个窗口未满时读当前窗口)，
+//   windowAgeUs() 给出它结束了多久，只读线程据此判断是否过时
+// - 三份窗口轮流使用：写入中、供读取、待清空，轮换时清空的是读取方看不到的那份
+// - 分段：事件 -> 入队、入队 -> 写出调用、写出调用 -> 写完成，便于定位延迟来自哪一段
+// 只在 HID I/O 线程写入；读取为近似快照，可在任意线程进行
+class HidInputLatency
+{
+public:
+    static const int kTypes = 3;                  // 报告类型个数 (CMD_KEY 合并成 CMD_KEYBOARD 后才写出)
+    static const int64_t kWindowUs = 10000000;    // 滚动窗口 10s
+
+    enum Segment {
+        SEG_ENQUEUE,    // 事件 -> 入队 (解析/映射耗时)
+        SEG_DISPATCH,   // 入队 -> 写出调用 (队列 + 调度等待链路)
+        SEG_WIRE,       // 写出调用 -> 写完成 (串口驱动/设备缓冲)
+        SEG_COUNT
+    };
+
+    HidInputLatency();
+
+    // 一条指令写完成：writeUs 为写出调用时刻，doneUs 为写完成时刻
+    void record(const HidCommand &cmd, int64_t writeUs, int64_t doneUs);
+    // 按时间轮换窗口 (写入线程调用；record 内自动调用，输出统计前也应调用)
+    void advance(int64_t nowUs);
+
+    const LatencyHistogram &total(int source, int type) const { return m_total[source][type]; }
+    const LatencyHistogram &window(int source, int type) const;
+    // window() 读取的窗口结束至今的时长 (仍在首个窗口时为 0)
+    int64_t windowAgeUs(int64_t nowUs) const;
+    const LatencyHistogram &segment(Segment seg) const { return m_segment[seg]; }
+
+    // 非空分组的窗口分布，一组一行："local/abs p50=...us p99=...us (n=...)"
+    // 窗口结束已超过一个周期 (之后未再推进) 时注明其时长
+    std::string summary() const;
+    void reset();
+
+    static const char *sourceName(int source);
+    static const char *typeName(int type);
+    static const char *segmentName(Segment seg);
+
+private:
+    static const int kWindowSlots = 3;
+
+    // 切换到下一份窗口 (先清空它；它既不是写入中的，也不是供读取的)
+    void flip();
+
+    LatencyHistogram m_total[HidCommand::SRC_COUNT][kTypes];
+    LatencyHistogram m_window[kWindowSlots][HidCommand::SRC_COUNT][kTypes];
+    LatencyHistogram m_segment[SEG_COUNT];
+    std::atomic<int> m_active;        // 正在写入的窗口，供读取的是它的上一份
+    std::atomic<bool> m_hasPrevious;  // 已有完整窗口
+    std::atomic<int64_t> m_previousEndUs; // 供读取的窗口的结束时刻
+    int64_t m_windowStartUs;
+};
+
+#endif // PRO_HIDLATENCY_H
@@ -0,0 +1,58 @@
+#include "pro_hidscheduler.h"
+
+HidScheduler::HidScheduler()
+    : m_baud(9600), m_minIntervalUs(0), m_busyUntilUs(0), m_replaced(0)
+{
+    for (int i = 0; i < LANE_COUNT; ++i) {
+        m_sent[i] = 0;
+    }
+}
+
+void HidScheduler::push(const HidCommand &cmd)
+{
+    m_coalescer.push(cmd);
+    m_replaced = m_coalescer.mergedCount();
+}
+
+void HidScheduler::clear()
+{
+    m_coalescer.clear();
+    m_busyUntilUs = 0;
+}
+
+bool HidScheduler::next(HidCommand &cmd, Lane &lane)
+{
+    if (m_coalescer.takeReady(cmd)) {
+        lane = LANE_INPUT;
+        return true;
+    }
+    if (m_coalescer.takeMotion(cmd)) {
+        lane = LANE_MOTION;
+        return true;
+    }
+    return false;
+}
+
+void HidScheduler::onSent(Lane lane, const HidCommand &cmd, int bytes, qint64 nowUs)
+{
+    chargeLink(bytes, nowUs);
+
+    m_sent[lane]++;
+    m_delay[lane].record(nowUs - cmd.stampUs);
+}
+
+void HidScheduler::chargeLink(int bytes, qint64 nowUs)
+{
+    qint64 airtimeUs = m_baud > 0 ? (qint64)bytes * 10 * 1000000 / m_baud : 0;
+    airtimeUs = qMax<qint64>(airtimeUs, m_minIntervalUs);
+    m_busyUntilUs = qMax(nowUs, m_busyUntilUs) + airtimeUs;
+}
+
+const char *HidScheduler::laneName(Lane lane)
+{
+    switch (lane) {
+    case LANE_INPUT:  return "input";
+    case LANE_MOTION: return "motion";
+    default:          return "?";
+    }
+}
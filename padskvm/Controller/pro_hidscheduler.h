@@ -0,0 +1,69 @@
+#ifndef PRO_HIDSCHEDULER_H
+#define PRO_HIDSCHEDULER_H
+
+#include "pro_hidcoalescer.h"
+#include "../Tool/latency_histogram.h"
+#include <atomic>
+
+// HID 发送调度器 (只在 HID I/O 线程中使用，统计可在任意线程读取)
+// - 按当前波特率 (8N1，每字节 10bit) 估算每包在线路上的传输时间 (USB gadget 则按端点轮询间隔)，
+//   只有链路空闲时才取下一包写出，OS 发送缓冲中最多只有一包，新到的高优先级包
+//   最多等待一包的传输时间，不会排在一串运动包后面
+// - 优先级车道：
+//     INPUT  键盘、鼠标按键/滚轮 (以及被按键强制送出的运动)，严格保持到达顺序
+//     MOTION 合并后的运动，只保留一份：旧位置被新位置替换，相对位移累加
+// - 每条车道统计：发送包数、入队 -> 写出的排队延迟分布
+class HidScheduler
+{
+public:
+    enum Lane {
+        LANE_INPUT,
+        LANE_MOTION,
+        LANE_COUNT
+    };
+
+    HidScheduler();
+
+    void setBaudRate(int baud) { m_baud = baud; }
+    int baudRate() const { return m_baud; }
+    // 相邻两包的最小间隔 (us)，与波特率估算取较大者；串口为 0
+    void setMinPacketIntervalUs(int us) { m_minIntervalUs = us; }
+
+    // 放入一条指令 (由合并器分道)
+    void push(const HidCommand &cmd);
+
+    // 丢弃所有待发指令并复位链路状态
+    void clear();
+
+    // 距链路空闲还有多久 (us，<=0 表示空闲)
+    qint64 idleInUs(qint64 nowUs) const { return m_busyUntilUs - nowUs; }
+
+    // 是否还有待发指令
+    bool hasPending() const { return m_coalescer.hasReady() || m_coalescer.hasPendingMotion(); }
+
+    // 取下一包 (链路空闲时调用)：先 INPUT 后 MOTION
+    bool next(HidCommand &cmd, Lane &lane);
+
+    // 写出后登记：累计链路占用并记录排队延迟
+    void onSent(Lane lane, const HidCommand &cmd, int bytes, qint64 nowUs);
+    // 计入调度之外写出的字节 (驱动自动重发)
+    void chargeLink(int bytes, qint64 nowUs);
+
+    // === 统计 ===
+    const LatencyHistogram &queueDelay(Lane lane) const { return m_delay[lane]; }
+    quint64 sentCount(Lane lane) const { return m_sent[lane]; }
+    quint64 replacedMotionCount() const { return m_replaced; }
+    static const char *laneName(Lane lane);
+
+private:
+    HidCoalescer m_coalescer;
+    int m_baud;
+    int m_minIntervalUs;
+    qint64 m_busyUntilUs;   // 已写出数据预计发送完毕的时刻 (单调时钟)
+
+    LatencyHistogram m_delay[LANE_COUNT];
+    std::atomic<quint64> m_sent[LANE_COUNT];
+    std::atomic<quint64> m_replaced;
+};
+
+#endif // PRO_HIDSCHEDULER_H
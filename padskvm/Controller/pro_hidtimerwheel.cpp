@@ -0,0 +1,90 @@
+#include "pro_hidtimerwheel.h"
+#include <algorithm>
+
+HidTimerWheel::HidTimerWheel(int64_t nowUs)
+    : m_tick(nowUs / kTickUs), m_seq(0), m_count(0)
+{
+}
+
+void HidTimerWheel::schedule(int64_t dueUs, const HidCommand &cmd, quint32 group)
+{
+    // 向上取整到刻度，不会早于要求的时刻触发；已过去的时刻放到下一格
+    int64_t tick = (dueUs + kTickUs - 1) / kTickUs;
+    if (tick <= m_tick) tick = m_tick + 1;
+
+    Entry e = {tick, m_seq++, group, cmd};
+    m_slots[tick % kSlots].push_back(e);
+    m_count++;
+}
+
+int HidTimerWheel::cancelGroup(quint32 group)
+{
+    int removed = 0;
+    for (int i = 0; i < kSlots; ++i) {
+        std::vector<Entry> &slot = m_slots[i];
+        for (size_t j = 0; j < slot.size(); ) {
+            if (slot[j].group == group) {
+                slot[j] = slot.back();
+                slot.pop_back();
+                removed++;
+            } else {
+                ++j;
+            }
+        }
+    }
+    m_count -= removed;
+    return removed;
+}
+
+void HidTimerWheel::advance(int64_t nowUs, std::vector<HidCommand> &out, std::vector<quint32> *groups)
+{
+    int64_t nowTick = nowUs / kTickUs;
+    if (nowTick <= m_tick) return;
+    if (m_count == 0) {
+        m_tick = nowTick;
+        return;
+    }
+
+    // 落后超过一圈时每个格子只需扫一遍
+    int64_t steps = std::min<int64_t>(nowTick - m_tick, kSlots);
+    std::vector<Entry> due;
+    for (int64_t t = m_tick + 1; t <= m_tick + steps; ++t) {
+        std::vector<Entry> &slot = m_slots[t % kSlots];
+        for (size_t j = 0; j < slot.size(); ) {
+            if (slot[j].tick <= nowTick) {
+                due.push_back(slot[j]);
+                slot[j] = slot.back();
+                slot.pop_back();
+            } else {
+                ++j;
+            }
+        }
+    }
+    m_tick = nowTick;
+    if (due.empty()) return;
+
+    std::sort(due.begin(), due.end(), [](const Entry &a, const Entry &b) {
+        return a.tick != b.tick ? a.tick < b.tick : a.seq < b.seq;
+    });
+    m_count -= due.size();
+    for (const Entry &e : due) {
+        out.push_back(e.cmd);
+        if (groups) groups->push_back(e.group);
+    }
+}
+
+int64_t HidTimerWheel::nextDueUs() const
+{
+    if (m_count == 0) return -1;
+
+    // 从下一格开始找，第一圈内遇到本圈到期的任务即为最早；否则取所有任务的最小刻度
+    int64_t best = -1;
+    for (int64_t t = m_tick + 1; t <= m_tick + kSlots; ++t) {
+        const std::vector<Entry> &slot = m_slots[t % kSlots];
+        for (const Entry &e : slot) {
+            if (e.tick == t) return t * kTickUs;
+            if (best < 0 || e.tick < best) best = e.tick;
+        }
+    }
+    return best * kTickUs;
+}
@@ -0,0 +1,58 @@
+#ifndef PRO_HIDTIMERWHEEL_H
+#define PRO_HIDTIMERWHEEL_H
+
+#include "../Tool/safe_queue.h"
+#include <vector>
+
+// 宏序列中的一步：上一步之后 delayMs 毫秒送出 cmd (第一步相对安排时刻)
+struct HidMacroStep {
+    HidCommand cmd;
+    int delayMs;
+};
+typedef std::vector<HidMacroStep> HidMacro;
+
+// HID 定时动作时间轮 (点击、长按、宏序列中的每一步)
+// - 哈希时间轮：1ms 一格，256 格一圈，更远的任务记录到期刻度、跨圈后再触发
+// - 插入/取消 O(1) 均摊，到期检查只扫描经过的格子；没有任务时不需要定时唤醒，
+//   由调用方按 nextDueUs() 设置一次性定时器
+// - 同一时刻到期的指令按安排顺序输出，保证按下/松开不会颠倒
+// 非线程安全：只在 HID I/O 线程中使用
+class HidTimerWheel
+{
+public:
+    static const int kSlots = 256;
+    static const int64_t kTickUs = 1000;
+
+    explicit HidTimerWheel(int64_t nowUs = 0);
+
+    // 安排一条指令在 dueUs 时刻 (单调时钟) 送出；group 用于成组取消 (例如同一个宏)
+    void schedule(int64_t dueUs, const HidCommand &cmd, quint32 group);
+
+    // 取消某组所有未到期的指令，返回取消的数量
+    int cancelGroup(quint32 group);
+
+    // 推进到 nowUs，把到期的指令按到期时间、安排顺序追加到 out
+    // groups 非空时同步追加每条指令所属的组
+    void advance(int64_t nowUs, std::vector<HidCommand> &out, std::vector<quint32> *groups = nullptr);
+
+    // 最早的到期时刻；没有任务返回 -1
+    int64_t nextDueUs() const;
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+private:
+    struct Entry {
+        int64_t tick;   // 到期刻度
+        quint64 seq;    // 安排顺序
+        quint32 group;
+        HidCommand cmd;
+    };
+
+    std::vector<Entry> m_slots[kSlots];
+    int64_t m_tick;     // 已处理到的刻度 (小于等于它的都已到期输出)
+    quint64 m_seq;
+    size_t m_count;
+};
+
+#endif // PRO_HIDTIMERWHEEL_H
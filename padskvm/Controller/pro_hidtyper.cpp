@@ -0,0 +1,120 @@
+#include "pro_hidtyper.h"
+
+#define MOD_L_SHIFT 0x02
+
+// 美式布局：ASCII 0x20 ~ 0x7E 的 HID 键码，最高位表示需要 Shift
+#define S(code) (0x80 | (code))
+static const uint8_t kUsAscii[95] = {
+    0x2C,     S(0x1E), S(0x34), S(0x20), S(0x21), S(0x22), S(0x24), 0x34,      //  ! " # $ % & '
+    S(0x26),  S(0x27), S(0x25), S(0x2E), 0x36,    0x2D,    0x37,    0x38,      // ( ) * + , - . /
+    0x27,     0x1E,    0x1F,    0x20,    0x21,    0x22,    0x23,    0x24,      // 0 ~ 7
+    0x25,     0x26,    S(0x33), 0x33,    S(0x36), 0x2E,    S(0x37), S(0x38),   // 8 9 : ; < = > ?
+    S(0x1F),  S(0x04), S(0x05), S(0x06), S(0x07), S(0x08), S(0x09), S(0x0A),   // @ A ~ G
+    S(0x0B),  S(0x0C), S(0x0D), S(0x0E), S(0x0F), S(0x10), S(0x11), S(0x12),   // H ~ O
+    S(0x13),  S(0x14), S(0x15), S(0x16), S(0x17), S(0x18), S(0x19), S(0x1A),   // P ~ W
+    S(0x1B),  S(0x1C), S(0x1D), 0x2F,    0x31,    0x30,    S(0x23), S(0x2D),   // X Y Z [ \ ] ^ _
+    0x35,     0x04,    0x05,    0x06,    0x07,    0x08,    0x09,    0x0A,      // ` a ~ g
+    0x0B,     0x0C,    0x0D,    0x0E,    0x0F,    0x10,    0x11,    0x12,      // h ~ o
+    0x13,     0x14,    0x15,    0x16,    0x17,    0x18,    0x19,    0x1A,      // p ~ w
+    0x1B,     0x1C,    0x1D,    S(0x2F), S(0x31), S(0x30), S(0x35)             // x y z { | } ~
+};
+#undef S
+
+HidTextTyper::HidTextTyper()
+    : m_perKeyRelease(false), m_curMods(0), m_curKey(0), m_typed(0), m_reports(0)
+{
+}
+
+bool HidTextTyper::layoutFromName(const QString &name, Layout &layout)
+{
+    QString n = name.trimmed().toLower();
+    if (n.isEmpty() || n == "us") {
+        layout = LAYOUT_US;
+        return true;
+    }
+    if (n == "uk" || n == "gb") {
+        layout = LAYOUT_UK;
+        return true;
+    }
+    return false;
+}
+
+bool HidTextTyper::mapChar(uint ch, Layout layout, Stroke &stroke)
+{
+    stroke.mods = 0;
+
+    // 控制字符
+    if (ch == '\n' || ch == '\r') { stroke.key = 0x28; return true; } // Enter
+    if (ch == '\t') { stroke.key = 0x2B; return true; }               // Tab
+
+    // 英式布局与美式的差异
+    if (layout == LAYOUT_UK) {
+        switch (ch) {
+        case '"':  stroke.mods = MOD_L_SHIFT; stroke.key = 0x1F; return true; // Shift+2
+        case '@':  stroke.mods = MOD_L_SHIFT; stroke.key = 0x34; return true; // Shift+'
+        case '#':  stroke.key = 0x32; return true;                            // 非美式 #
+        case '~':  stroke.mods = MOD_L_SHIFT; stroke.key = 0x32; return true;
+        case '\\': stroke.key = 0x64; return true;                            // 非美式 \ 键
+        case '|':  stroke.mods = MOD_L_SHIFT; stroke.key = 0x64; return true;
+        case 0xA3: stroke.mods = MOD_L_SHIFT; stroke.key = 0x20; return true; // £ = Shift+3
+        case 0xAC: stroke.mods = MOD_L_SHIFT; stroke.key = 0x35; return true; // ¬ = Shift+`
+        default: break;
+        }
+    }
+
+    if (ch < 0x20 || ch > 0x7E) return false;
+    uint8_t entry = kUsAscii[ch - 0x20];
+    stroke.key = entry & 0x7F;
+    if (entry & 0x80) stroke.mods = MOD_L_SHIFT;
+    return true;
+}
+
+int HidTextTyper::append(const QString &text, Layout layout)
+{
+    int skipped = 0;
+    const QVector<uint> chars = text.toUcs4();
+    for (int i = 0; i < chars.size(); ++i) {
+        uint ch = chars[i];
+        // "\r\n" 只按一次回车
+        if (ch == '\r' && i + 1 < chars.size() && chars[i + 1] == '\n') continue;
+
+        Stroke stroke;
+        if (!mapChar(ch, layout, stroke)) {
+            skipped++;
+            continue;
+        }
+        m_keys.push_back(stroke);
+    }
+    return skipped;
+}
+
+bool HidTextTyper::nextReport(HidCommand &cmd)
+{
+    uint8_t mods = 0;
+    uint8_t key = 0;
+
+    if (!m_keys.empty()) {
+        const Stroke &next = m_keys.front();
+        // 需要先松开：逐键模式每次按下后都松开；流水线模式只在同一个键连按时松开
+        // (修饰键不同不需要松开，修饰键位与键码在同一份报告中切换)
+        bool mustRelease = m_curKey != 0 && (m_perKeyRelease || m_curKey == next.key);
+        if (!mustRelease) {
+            mods = next.mods;
+            key = next.key;
+            m_keys.pop_front();
+            m_typed++;
+        }
+    } else if (m_curKey == 0 && m_curMods == 0) {
+        return false;
+    }
+
+    // 松开报告连同修饰键一起松开
+    m_curMods = mods;
+    m_curKey = key;
+
+    const uint8_t keys[HidCommand::kKeySlots] = {key, 0, 0, 0, 0, 0};
+    cmd = HidCommand{HidCommand::CMD_KEYBOARD, mods, 0, 0, 0, 0, 0, HidCommand::SRC_INTERNAL};
+    cmd.setKeys(keys);
+    m_reports++;
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef PRO_HIDTYPER_H
+#define PRO_HIDTYPER_H
+
+#include "../Tool/safe_queue.h"
+#include <QString>
+#include <deque>
+
+// 文本输入引擎：把一段文本按键盘布局转换成连续的键盘报告 (批量输入密码/脚本/配置文件)
+// - 流水线模式：相邻字符直接从一个按键切换到下一个按键，每个字符只需一份报告；
+//   同一个键连按时才插入一次松开。结束时发送全松开报告
+// - 逐键模式：每个字符按下、松开各一份报告 (对 BIOS 等简单主机更稳妥)
+// - 只负责生成报告 (文本输入自身按住的集合，发送前与其他来源按住的键合并)，发送节奏由调用方控制
+// 非线程安全：只在 HID I/O 线程中使用
+class HidTextTyper
+{
+public:
+    enum Layout {
+        LAYOUT_US,  // 美式键盘
+        LAYOUT_UK   // 英式键盘
+    };
+
+    HidTextTyper();
+
+    // 布局名 "us" / "uk"，无法识别返回 false
+    static bool layoutFromName(const QString &name, Layout &layout);
+
+    // 追加待输入文本，返回当前布局下无法输入而被跳过的字符数
+    int append(const QString &text, Layout layout);
+
+    // 逐键模式开关 (对之后生成的报告生效)
+    void setPerKeyRelease(bool enable) { m_perKeyRelease = enable; }
+
+    // 是否还有报告要发 (包括末尾的全松开报告)
+    bool hasPending() const { return !m_keys.empty() || m_curKey != 0 || m_curMods != 0; }
+
+    // 生成下一份报告；没有报告时返回 false
+    bool nextReport(HidCommand &cmd);
+
+    // 丢弃未输入的文本 (当前按住的键下一份报告松开)
+    void clear() { m_keys.clear(); }
+
+    // 统计
+    quint64 typedChars() const { return m_typed; }
+    quint64 reportCount() const { return m_reports; }
+
+private:
+    struct Stroke {
+        uint8_t mods;
+        uint8_t key;
+    };
+
+    // 字符 -> 按键，无法映射返回 false
+    static bool mapChar(uint ch, Layout layout, Stroke &stroke);
+
+    std::deque<Stroke> m_keys;
+    bool m_perKeyRelease;
+    uint8_t m_curMods;   // 上一份报告的状态
+    uint8_t m_curKey;
+    quint64 m_typed;
+    quint64 m_reports;
+};
+
+#endif // PRO_HIDTYPER_H
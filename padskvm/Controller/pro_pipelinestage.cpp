@@ -0,0 +1,65 @@
+#include "pro_pipelinestage.h"
+#include <QDebug>
+
+// ================= StageCounter =================
+
+void StageCounter::record(qint64 us)
+{
+    m_processed.fetch_add(1, std::memory_order_relaxed);
+    m_lastUs.store(us, std::memory_order_relaxed);
+    qint64 avg = m_avgUs.load(std::memory_order_relaxed);
+    m_avgUs.store(avg + (us - avg) / 16, std::memory_order_relaxed);
+    qint64 maxv = m_maxUs.load(std::memory_order_relaxed);
+    while (us > maxv && !m_maxUs.compare_exchange_weak(maxv, us, std::memory_order_relaxed)) {}
+}
+
+void StageCounter::reset()
+{
+    m_processed = 0;
+    m_lastUs = 0;
+    m_avgUs = 0;
+    m_maxUs = 0;
+}
+
+StageStats StageCounter::stats() const
+{
+    StageStats s;
+    s.processed = m_processed.load(std::memory_order_relaxed);
+    s.lastUs = m_lastUs.load(std::memory_order_relaxed);
+    s.avgUs = m_avgUs.load(std::memory_order_relaxed);
+    s.maxUs = m_maxUs.load(std::memory_order_relaxed);
+    return s;
+}
+
+// ================= PipelineStage =================
+
+PipelineStage::PipelineStage(const QString &name, std::function<void()> step, QObject *parent)
+    : QThread(parent), m_name(name), m_step(std::move(step))
+{
+}
+
+PipelineStage::~PipelineStage()
+{
+    stop();
+}
+
+void PipelineStage::launch(Priority priority)
+{
+    m_stop = false;
+    start(priority);
+}
+
+void PipelineStage::stop()
+{
+    m_stop = true;
+    wait();
+}
+
+void PipelineStage::run()
+{
+    qDebug() << "[pipeline]" << m_name << "stage started.";
+    while (!m_stop) {
+        m_step();
+    }
+    qDebug() << "[pipeline]" << m_name << "stage finished.";
+}
@@ -0,0 +1,61 @@
+#ifndef PRO_PIPELINESTAGE_H
+#define PRO_PIPELINESTAGE_H
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include <functional>
+
+// 阶段统计快照 (单位：us)
+struct StageStats {
+    quint64 processed = 0; // 已处理的元素数
+    qint64  lastUs = 0;    // 最近一次处理耗时
+    qint64  avgUs = 0;     // 处理耗时 EWMA (1/16)
+    qint64  maxUs = 0;     // 最大处理耗时
+};
+
+// 阶段计数器：由处理线程写入，任意线程读取
+class StageCounter {
+public:
+    void record(qint64 us);
+    void reset();
+    StageStats stats() const;
+
+private:
+    std::atomic<quint64> m_processed{0};
+    std::atomic<qint64> m_lastUs{0};
+    std::atomic<qint64> m_avgUs{0};
+    std::atomic<qint64> m_maxUs{0};
+};
+
+// 流水线阶段线程
+// 反复调用 step()，直到 stop()。step 内部应自行在输入队列上带超时等待，
+// 以保证 stop() 能在一个等待周期内返回
+class PipelineStage : public QThread
+{
+public:
+    explicit PipelineStage(const QString &name, std::function<void()> step, QObject *parent = nullptr);
+    ~PipelineStage();
+
+    // 启动阶段线程 (可在 stop() 之后再次启动)
+    void launch(Priority priority = InheritPriority);
+
+    // 请求退出并等待线程结束
+    void stop();
+
+    const QString &name() const { return m_name; }
+
+    StageCounter &counter() { return m_counter; }
+    StageStats stats() const { return m_counter.stats(); }
+
+protected:
+    void run() override;
+
+private:
+    QString m_name;
+    std::function<void()> m_step;
+    std::atomic<bool> m_stop{false};
+    StageCounter m_counter;
+};
+
+#endif // PRO_PIPELINESTAGE_H
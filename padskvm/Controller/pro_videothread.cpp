@@ -1,6 +1,28 @@
 #include "pro_videothread.h"
 #include "../Tool/safe_queue.h"
 #include <QDebug>
+#include <cstring>
+#include <time.h>
+#include <sys/epoll.h>
+
+// 连续这么久没有出帧视为信号丢失，重启采集 (驱动不支持源变化事件时的兜底)
+static const qint64 SIGNAL_LOST_MS = 2000;
+// 信号丢失后停流，等硬件复位再重启
+static const qint64 RESTART_SETTLE_MS = 200;
+// 缓冲区全部被下游占用时 V4L2 fd 会持续报错，暂停监听的时长
+static const qint64 CAMERA_RETRY_MS = 5;
+// 流水线统计输出周期
+static const qint64 REPORT_INTERVAL_MS = 10000;
+// 有未完成握手的连接时，检查其超时的周期
+static const qint64 PENDING_CHECK_MS = 1000;
+
+// 与 V4L2 缓冲区时间戳同一时钟 (CLOCK_MONOTONIC)
+static qint64 monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
 VideoController::VideoController(QObject *parent)
     : QThread(parent),
@@ -8,9 +30,25 @@ VideoController::VideoController(QObject *parent)
       m_dirtyCamera(false), m_dirtyNetwork(false), // 初始化参数更改标记
       m_cfgWidth(640), m_cfgHeight(480), m_cfgFmt(0), m_cfgFps(30),
       m_cfgNetOn(false), m_cfgPort(8080),
-      m_encoder(nullptr), m_server(nullptr)
+      m_cfgBufCount(CameraDevice::DEFAULT_BUFFER_COUNT), m_cfgLatestOnly(false),
+      m_encoder(nullptr), m_server(nullptr), m_netClients(0),
+      // 显示/编码只关心最新帧：队列浅、满了挤掉旧帧，限制同时被占用的 V4L2 缓冲区数量
+      m_displayQueue(2, DropPolicy::DropOldest),
+      m_encodeQueue(2, DropPolicy::DropOldest),
+      m_netQueue(16, DropPolicy::DropOldest),
+      m_displayStage(nullptr), m_encodeStage(nullptr),
+      m_lossStartMs(-1), m_lossDetectedMs(-1),
+      m_lastRecoveryMs(-1), m_lastDetectMs(-1), m_lastRestartMs(-1),
+      m_watchedCameraFd(-1), m_lastFrameMs(0), m_restartAtMs(-1), m_cameraRetryAtMs(-1), m_reportAtMs(0),
+      m_netQueueDropped(0), m_keyframeRequest(false)
 {
     m_camera = new CameraDevice(this);
+
+    m_displayStage = new PipelineStage("display", [this]{ displayStep(); }, this);
+    m_encodeStage  = new PipelineStage("encode",  [this]{ encodeStep(); },  this);
+
+    // 编码数据入队、配置变化都通过唤醒通知本线程
+    m_reactor.setWakeHandler([this]{ onWake(); });
 }
 
 VideoController::~VideoController()
@@ -27,13 +65,14 @@ void VideoController::startCapturing()
 {
     QMutexLocker locker(&m_mutex);
     m_pause = false;
-    m_cond.wakeOne();
+    m_reactor.wake();
 }
 
 void VideoController::stopCapturing()
 {
     QMutexLocker locker(&m_mutex);
     m_pause = true;
+    m_reactor.wake();
 }
 
 void VideoController::updateSettings(int width, int height, unsigned int fmt, int fps)
@@ -50,7 +89,7 @@ void VideoController::updateSettings(int width, int height, unsigned int fmt, in
 
     // 3. 唤醒线程处理
     m_pause = false;
-    m_cond.wakeOne();
+    m_reactor.wake();
 }
 
 bool VideoController::startServer(int port)
@@ -63,7 +102,7 @@ bool VideoController::startServer(int port)
     // 2. 仅标记网络脏了 (这样就不会重启摄像头)
     m_dirtyNetwork = true;
 
-    m_cond.wakeOne();
+    m_reactor.wake();
     return true; // 实际成功与否在子线程处理，这里假设配置接受成功
 }
 
@@ -72,6 +111,75 @@ void VideoController::stopServer()
     QMutexLocker locker(&m_mutex);
     m_cfgNetOn = false;
     m_dirtyNetwork = true;
+    m_reactor.wake();
+}
+
+void VideoController::setBufferPolicy(int bufferCount, bool latestFrameOnly)
+{
+    QMutexLocker locker(&m_mutex);
+    // 缓冲区数量只能在重新申请缓存时生效，需要重启摄像头
+    if (bufferCount != m_cfgBufCount) {
+        m_dirtyCamera = true;
+    }
+    m_cfgBufCount = bufferCount;
+    m_cfgLatestOnly = latestFrameOnly;
+    m_reactor.wake();
+}
+
+void VideoController::setDisplaySize(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cfgDisplaySize = size;
+}
+
+void VideoController::setQueueDropPolicy(PipelineQueue queue, DropPolicy policy)
+{
+    switch (queue) {
+    case QUEUE_DISPLAY: m_displayQueue.setDropPolicy(policy); break;
+    case QUEUE_ENCODE:  m_encodeQueue.setDropPolicy(policy); break;
+    case QUEUE_NETWORK: m_netQueue.setDropPolicy(policy); break;
+    }
+}
+
+QueueStats VideoController::queueStats(PipelineQueue queue) const
+{
+    switch (queue) {
+    case QUEUE_DISPLAY: return m_displayQueue.stats();
+    case QUEUE_ENCODE:  return m_encodeQueue.stats();
+    case QUEUE_NETWORK: return m_netQueue.stats();
+    }
+    return QueueStats();
+}
+
+StageStats VideoController::stageStats(PipelineStageId stage) const
+{
+    switch (stage) {
+    case STAGE_CAPTURE: return m_captureCounter.stats();
+    case STAGE_DISPLAY: return m_displayStage->stats();
+    case STAGE_ENCODE:  return m_encodeStage->stats();
+    case STAGE_NETWORK: return m_netCounter.stats();
+    }
+    return StageStats();
+}
+
+QString VideoController::pipelineReport() const
+{
+    static const char *stageNames[] = { "capture", "display", "encode", "network" };
+    static const char *queueNames[] = { "display", "encode", "network" };
+
+    QString out;
+    for (int i = STAGE_CAPTURE; i <= STAGE_NETWORK; ++i) {
+        StageStats s = stageStats((PipelineStageId)i);
+        out += QString("%1[n=%2 avg=%3us max=%4us] ")
+                   .arg(stageNames[i]).arg(s.processed).arg(s.avgUs).arg(s.maxUs);
+    }
+    for (int i = QUEUE_DISPLAY; i <= QUEUE_NETWORK; ++i) {
+        QueueStats q = queueStats((PipelineQueue)i);
+        out += QString("q_%1[%2/hw%3 drop=%4 wait=%5us max=%6us] ")
+                   .arg(queueNames[i]).arg(q.size).arg(q.highWater).arg(q.dropped)
+                   .arg(q.avgWaitUs).arg(q.maxWaitUs);
+    }
+    return out.trimmed();
 }
 
 void VideoController::quitThread()
@@ -81,7 +189,7 @@ void VideoController::quitThread()
         m_abort = true;
         m_pause = false;
     }
-    m_cond.wakeOne();
+    m_reactor.wake();
     wait();
 }
 
@@ -95,9 +203,9 @@ void VideoController::syncHardwareState()
     bool needCamReset = false;
     bool needNetReset = false;
 
-    int targetW, targetH, targetFps, targetPort;
+    int targetW, targetH, targetFps, targetPort, targetBufCount;
     unsigned int targetFmt;
-    bool targetNetOn;
+    bool targetNetOn, targetLatestOnly;
 
     {
         QMutexLocker locker(&m_mutex);
@@ -113,12 +221,21 @@ void VideoController::syncHardwareState()
         targetW = m_cfgWidth; targetH = m_cfgHeight;
         targetFmt = m_cfgFmt; targetFps = m_cfgFps;
         targetNetOn = m_cfgNetOn; targetPort = m_cfgPort;
+        targetBufCount = m_cfgBufCount; targetLatestOnly = m_cfgLatestOnly;
+    }
+
+    // 仅取最新帧只影响出队逻辑，每轮直接同步即可
+    if (m_camera) {
+        m_camera->setLatestFrameOnly(targetLatestOnly);
     }
 
     // 2. 处理摄像头变更 (优先级最高)
     if (needCamReset && m_camera) {
         //qDebug() << "[videocontroller]Sync: Restarting Camera...";
+        flushFrameQueues();
         m_camera->stopCapturing();
+        m_restartAtMs = -1;  // 按新配置重启，取代信号源恢复中的定时重试
+        m_camera->setBufferCount(targetBufCount);
         if (!m_camera->startCapturing(targetW, targetH, targetFmt, targetFps)) {
             //qDebug() << "[videocontroller]Sync: Camera start failed!";
             QMutexLocker locker(&m_mutex);
@@ -133,12 +250,16 @@ void VideoController::syncHardwareState()
     // 3. 处理网络/编码器变更
     // 触发条件：网络开关切换 OR 摄像头刚刚重启过
     if (needNetReset) {
+        // 编码阶段可能正在使用编码器，持锁重建
+        QMutexLocker encLocker(&m_encoderMutex);
+
         // A. 清理旧资源
         if (m_encoder) { delete m_encoder; m_encoder = nullptr; }
 
         if (targetNetOn) {
             if (!m_server) {
                 m_server = new WebServer(targetPort);
+                attachServer();
             }
 
             // 【核心修改】根据摄像头格式创建编码器
@@ -166,123 +287,410 @@ void VideoController::syncHardwareState()
                 qDebug() << "[videocontroller]Sync: Unsupported format for encoding:" << camFmt;
             }
 
+        } else if (m_server) {
+            detachServer();
+            delete m_server;
+            m_server = nullptr;
+            updateClientCount();
+        }
+    }
+}
+
+void VideoController::flushFrameQueues()
+{
+    m_displayQueue.clear();
+    m_encodeQueue.clear();
+}
+
+// 信号源变化后的重配：查询 DV 时序 -> 停流 -> 设置时序 -> 按新分辨率重启
+// 编码器通过标记 m_dirtyNetwork 在下一轮 syncHardwareState 中按新分辨率重建
+void VideoController::reconfigureForSource()
+{
+    int w = 0, h = 0, fps = 0;
+    bool haveTimings = m_camera->queryDvTimings(w, h, fps);
+
+    int targetW, targetH, targetFps;
+    unsigned int targetFmt;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (haveTimings) {
+            m_cfgWidth = w;
+            m_cfgHeight = h;
+            if (fps > 0) m_cfgFps = fps;
+        }
+        targetW = m_cfgWidth; targetH = m_cfgHeight;
+        targetFmt = m_cfgFmt; targetFps = m_cfgFps;
+        m_dirtyNetwork = true;
+    }
+
+    flushFrameQueues();
+    m_camera->stopCapturing();
+    if (haveTimings) {
+        qDebug() << "[videocontroller] New source timings:" << w << "x" << h << "@" << fps;
+        m_camera->applyDvTimings();
+    }
+    if (!m_camera->startCapturing(targetW, targetH, targetFmt, targetFps)) {
+        // HDMI 切换分辨率后桥接芯片稳定前 STREAMON 常会失败：歇一会再试 (未采集时 fd 不在监听中，
+        // 不会再有超时)；恢复计时起点保留，统计覆盖整个中断
+        qDebug() << "[videocontroller] Restart after source change failed, retrying in" << RESTART_SETTLE_MS << "ms";
+        m_restartAtMs = m_loopClock.elapsed() + RESTART_SETTLE_MS;
+        return;
+    }
+    emit sourceChanged(m_camera->frameSize());
+}
+
+void VideoController::markSourceLost(qint64 now)
+{
+    // 已在恢复中 (重启失败后定时重试、重试期间又收到源变化事件) 时保留第一次的计时起点
+    if (m_lossStartMs >= 0) return;
+    m_lossStartMs = m_lastFrameMs;
+    m_lossDetectedMs = now;
+}
+
+// ================= 流水线阶段 =================
+
+// 显示转换阶段：原始帧 -> 显示尺寸 RGB32 QImage
+void VideoController::displayStep()
+{
+    FrameLease frame;
+    if (!m_displayQueue.waitPop(frame, 50)) return;
+
+    QSize displaySize;
+    {
+        QMutexLocker locker(&m_mutex);
+        displaySize = m_cfgDisplaySize;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage img;
+    m_camera->toQImage(frame.data(), frame.size(), img, displaySize);
+    frame.reset(); // 转换完立即归还缓冲区，不等信号投递
+    m_displayStage->counter().record(timer.nsecsElapsed() / 1000);
+
+    emit frameReady(img);
+}
+
+// 编码阶段：原始帧 -> H.264 数据包 -> 网络队列
+void VideoController::encodeStep()
+{
+    FrameLease frame;
+    if (!m_encodeQueue.waitPop(frame, 50)) return;
+
+    QElapsedTimer timer;
+    timer.start();
+    {
+        QMutexLocker locker(&m_encoderMutex);
+        if (m_encoder) {
+            if (m_keyframeRequest.exchange(false)) m_encoder->requestKeyframe();
+            m_encoder->encode(frame.data(), frame.timestampUs(), [this](const EncodedPacketPtr& packet){
+                // 数据包只读、引用计数，交给网络阶段无需拷贝
+                m_netQueue.push(EncodedPacketPtr(packet));
+                m_reactor.wake();
+            });
+        }
+    }
+    frame.reset();
+    m_encodeStage->counter().record(timer.nsecsElapsed() / 1000);
+}
+
+// ================= 网络 (本线程事件循环) =================
+
+void VideoController::attachServer()
+{
+    // 客户端接入/断开时同步监听
+    m_server->set_fd_watcher([this](int fd, bool added) {
+        if (added) {
+            m_reactor.add(fd, EPOLLIN | EPOLLRDHUP, [this, fd](uint32_t events) { onClientEvent(fd, events); });
         } else {
-            if (m_server) { delete m_server; m_server = nullptr; }
+            m_reactor.remove(fd);
         }
+    });
+    // 新观看者握手完成：请求 IDR (编码阶段在下一帧处理)
+    m_server->set_keyframe_requester([this]() { m_keyframeRequest.store(true); });
+    m_serverHeaders.reset(); // 新服务器需要重新设置参数集
+    // 发送队列有积压时才监听可写
+    m_server->set_write_watcher([this](int fd, bool want) {
+        m_reactor.modify(fd, EPOLLIN | EPOLLRDHUP | (want ? (uint32_t)EPOLLOUT : 0u));
+    });
+    m_reactor.add(m_server->listen_fd(), EPOLLIN, [this](uint32_t) { onListenReady(); });
+}
+
+void VideoController::detachServer()
+{
+    m_reactor.remove(m_server->listen_fd());
+    // 析构时仍会通过 fd_watcher 注销每个客户端
+}
+
+void VideoController::onListenReady()
+{
+    if (!m_server) return;
+    m_server->handle_new_connections();
+    updateClientCount();
+}
+
+void VideoController::onClientEvent(int fd, uint32_t events)
+{
+    if (!m_server) return;
+    // 可写，或错误队列里有零拷贝完成通知 (EPOLLERR)
+    if (events & (EPOLLOUT | EPOLLERR)) {
+        m_server->flush_client(fd);
+    }
+    if (events & ~(uint32_t)EPOLLOUT) {
+        onClientReady(fd);
+    } else {
+        updateClientCount();
     }
 }
 
+void VideoController::onClientReady(int fd)
+{
+    if (!m_server) return;
+    // 网页输入的事件时刻：socket 就绪时 (延迟统计从这里算起)，同一批读到的消息共用
+    const int64_t eventUs = LatencyHistogram::nowUs();
+    m_server->read_client(fd, [this, eventUs](const uint8_t *data, size_t size) {
+        dispatchRemoteInput(data, size, eventUs);
+    });
+    updateClientCount();
+}
+
+void VideoController::onWake()
+{
+    // 配置变化由主循环在下一轮处理，这里只需广播编码数据
+    flushNetworkQueue();
+}
+
+void VideoController::flushNetworkQueue()
+{
+    // 网络队列满时丢过包：后续 P 帧的参考已断，各客户端从下一个关键帧重新开始
+    uint64_t dropped = m_netQueue.stats().dropped;
+    if (dropped != m_netQueueDropped) {
+        m_netQueueDropped = dropped;
+        if (m_server) m_server->resync_all();
+    }
+
+    EncodedPacketPtr pkt;
+    while (m_netQueue.pop(pkt)) {
+        if (!m_server) continue; // 服务器已关闭：丢弃
+        QElapsedTimer timer;
+        timer.start();
+        // 参数集变化 (首个关键帧、分辨率切换) 时交给服务器，新观看者在首个关键帧前先收到它
+        if (pkt->parameterSets() && pkt->parameterSets() != m_serverHeaders) {
+            m_serverHeaders = pkt->parameterSets();
+            m_server->set_stream_headers(m_serverHeaders, m_serverHeaders->data(), m_serverHeaders->size());
+        }
+        // 各客户端的发送队列共享这个数据包，发完 (或零拷贝完成) 后释放引用，缓冲回到编码器的池中
+        m_server->broadcast(pkt, pkt->data(), pkt->size(), pkt->keyframe());
+        pkt.reset();
+        m_netCounter.record(timer.nsecsElapsed() / 1000);
+    }
+    updateClientCount();
+}
+
+void VideoController::updateClientCount()
+{
+    int prev = m_netClients.exchange(m_server ? m_server->GetClientNumber() : 0);
+
+    // 网页端全部断开：松开网页端按住的键，防止被控端按键卡住 (本地按住的保持)
+    if (prev > 0 && m_netClients == 0) {
+        HidCommand cmd = {HidCommand::CMD_KEYBOARD, 0, 0, 0, 0, 0, 0, HidCommand::SRC_WEB};
+        HidPacketQueue::instance()->push(cmd);
+    }
+}
+
+void VideoController::dispatchRemoteInput(const uint8_t *msg, size_t size, int64_t eventUs)
+{
+    if (size == 0) return;
+    uint8_t type = msg[0];
+
+    // 1. 鼠标包 [0x02, Buttons, X_L, X_H, Y_L, Y_H, Wheel]
+    if (type == 0x02 && size >= 7) {
+        uint8_t buttons = msg[1];
+        uint16_t x_web = msg[2] | (msg[3] << 8);
+        uint16_t y_web = msg[4] | (msg[5] << 8);
+        int8_t wheel = (int8_t)msg[6];
+
+        // 计算坐标映射 (Web 32767 -> CH9329 4095)
+        int x_hid = (int)((long long)x_web * 4095 / 32767);
+        int y_hid = (int)((long long)y_web * 4095 / 32767);
+
+        // 构造命令并入队
+        HidCommand cmd;
+        cmd.type = HidCommand::CMD_MOUSE_ABS;
+        cmd.param1 = x_hid;
+        cmd.param2 = y_hid;
+        cmd.param3 = buttons;
+        cmd.param4 = wheel;
+        cmd.markEvent(HidCommand::SRC_WEB, eventUs);
+        HidPacketQueue::instance()->push(cmd);
+    }
+    // 2. 键盘包 [0x01, Mods, Key1 .. Key6] (旧版网页只带 1 个键)
+    //    网页端发送的是它按住的完整集合，由 HID I/O 线程与其他来源合并，报告不变时不发送
+    else if (type == 0x01 && size >= 3) {
+        uint8_t keys[HidCommand::kKeySlots] = {0};
+        int count = qMin((int)size - 2, (int)HidCommand::kKeySlots);
+        memcpy(keys, msg + 2, count);
+        HidCommand cmd = {HidCommand::CMD_KEYBOARD, msg[1], 0, 0, 0, 0, 0, HidCommand::SRC_WEB};
+        cmd.setKeys(keys);
+        cmd.markEvent(HidCommand::SRC_WEB, eventUs);
+        HidPacketQueue::instance()->push(cmd);
+    }
+    // 3. 文本输入包 [0x03, Flags, Layout, IntervalMs, UTF-8 文本...]
+    //    Flags bit0：逐键确认；Layout：0 = us，1 = uk。超过单条消息上限 (1MB) 的文本由网页端分段发送，依次追加
+    else if (type == 0x03 && size > 4) {
+        static const char *layouts[] = {"us", "uk"};
+        QString layout = msg[2] < 2 ? layouts[msg[2]] : "?";
+        QString text = QString::fromUtf8(reinterpret_cast<const char*>(msg + 4), (int)size - 4);
+        emit remoteTextReceived(text, layout, msg[3], (msg[1] & 0x01) != 0);
+    }
+}
+
+// ================= 采集线程主循环 =================
+
+void VideoController::syncCameraWatch(bool paused)
+{
+    int fd = (!paused && m_camera && m_camera->isCapturing() && m_cameraRetryAtMs < 0) ? m_camera->fd() : -1;
+    if (fd == m_watchedCameraFd) return;
+
+    if (m_watchedCameraFd >= 0) m_reactor.remove(m_watchedCameraFd);
+    m_watchedCameraFd = -1;
+    // 未采集时 V4L2 fd 的 poll 一直报 POLLERR，只在采集中监听
+    if (fd >= 0 && m_reactor.add(fd, EPOLLIN | EPOLLPRI, [this](uint32_t events) { onCameraReady(events); })) {
+        m_watchedCameraFd = fd;
+        m_lastFrameMs = m_loopClock.elapsed();
+    }
+}
+
+void VideoController::onCameraReady(uint32_t events)
+{
+    FrameLease frame = m_camera->takeFrame((events & EPOLLPRI) != 0);
+
+    if (frame) {
+        m_lastFrameMs = m_loopClock.elapsed();
+        // 信号源切换后的首帧：记录恢复耗时 (发现 + 重启)
+        if (m_lossStartMs >= 0) {
+            m_lastDetectMs = (int)(m_lossDetectedMs - m_lossStartMs);
+            m_lastRestartMs = (int)(m_lastFrameMs - m_lossDetectedMs);
+            m_lastRecoveryMs = (int)(m_lastFrameMs - m_lossStartMs);
+            m_lossStartMs = -1;
+            qDebug() << "[videocontroller] Source recovered in" << m_lastRecoveryMs << "ms (detect"
+                     << m_lastDetectMs << "ms, restart" << m_lastRestartMs << "ms)";
+        }
+        // 采集阶段耗时：驱动打时间戳 -> 分发给下游
+        qint64 ageUs = monotonicUs() - frame.timestampUs();
+        // 分支1: 本地显示
+        m_displayQueue.push(frame.share());
+        // 分支2: 网络 (没有客户端时不编码)
+        if (m_netClients > 0) {
+            m_encodeQueue.push(frame.share());
+        }
+        if (frame.timestampUs() > 0 && ageUs >= 0 && ageUs < 10000000) {
+            m_captureCounter.record(ageUs);
+        }
+        // frame 离开作用域时释放本线程的引用，下游全部用完后缓冲区自动归还
+    } else if (m_camera->takeSourceChange()) {
+        // === 信号源变化事件 (V4L2_EVENT_SOURCE_CHANGE) ===
+        // 立即按新时序重配，无需等待超时
+        qDebug() << "[videocontroller] Source change event. Reconfiguring...";
+        markSourceLost(m_loopClock.elapsed());
+        reconfigureForSource();
+        m_lastFrameMs = m_loopClock.elapsed();
+    } else if (events & EPOLLERR) {
+        // 没有排队的缓冲区 (全部被下游占用) 时 fd 持续报错：暂停监听，等租约归还
+        m_cameraRetryAtMs = m_loopClock.elapsed() + CAMERA_RETRY_MS;
+    }
+}
+
+int VideoController::nextTimeoutMs(bool paused) const
+{
+    qint64 now = m_loopClock.elapsed();
+    qint64 due = m_reportAtMs;
+    if (m_restartAtMs >= 0) due = qMin(due, m_restartAtMs);
+    if (m_cameraRetryAtMs >= 0) due = qMin(due, m_cameraRetryAtMs);
+    if (m_watchedCameraFd >= 0 && !paused) due = qMin(due, m_lastFrameMs + SIGNAL_LOST_MS);
+    if (m_server && m_server->has_pending()) due = qMin(due, now + PENDING_CHECK_MS);
+    return (int)qMax<qint64>(0, due - now);
+}
+
 void VideoController::run()
 {
     qDebug() << "[videocontroller] Run loop started.";
 
-    // 超时计数器
-    int timeoutCounter = 0;
+    // 下游阶段随采集线程启停
+    m_displayStage->launch();
+    m_encodeStage->launch();
+
+    m_loopClock.start();
+    m_reportAtMs = REPORT_INTERVAL_MS;
+    m_restartAtMs = -1;
+    m_cameraRetryAtMs = -1;
 
     while (true) {
-        // --- 1. 线程控制与等待 ---
+        // --- 1. 线程控制 ---
+        bool paused;
         {
             QMutexLocker locker(&m_mutex);
             if (m_abort) break;
-
-            // 如果暂停 且 没有配置更改任务，则休眠
-            // 注意：如果有 dirty 标记，即使是 pause 状态也要醒来处理配置
-            if (m_pause && !m_dirtyCamera && !m_dirtyNetwork) {
-                m_cond.wait(&m_mutex);
-                if (m_abort) break;
-            }
+            paused = m_pause;
         }
 
         // --- 2. 状态同步 (核心重构) ---
         // 所有的 new/delete/restart 都在这里完成
         syncHardwareState();
+        {
+            // 同步过程中可能因启动失败而暂停
+            QMutexLocker locker(&m_mutex);
+            paused = m_pause;
+        }
+        syncCameraWatch(paused);
 
-        // --- 3. 网络接收 ---
-        if (m_server) {
-            m_server->handle_new_connections();
-            auto msgs = m_server->process_client_messages();
-
-            for (const auto& msg : msgs) {
-                if (msg.empty()) continue;
-                uint8_t type = msg[0];
-
-                // === 解析逻辑移到这里 ===
-
-                // 1. 鼠标包 [0x02, Buttons, X_L, X_H, Y_L, Y_H, Wheel]
-                if (type == 0x02 && msg.size() >= 7) {
-                    uint8_t buttons = msg[1];
-                    uint16_t x_web = msg[2] | (msg[3] << 8);
-                    uint16_t y_web = msg[4] | (msg[5] << 8);
-                    int8_t wheel = (msg.size() > 6) ? (int8_t)msg[6] : 0;
-
-                    // 计算坐标映射 (Web 32767 -> CH9329 4095)
-                    int x_hid = (int)((long long)x_web * 4095 / 32767);
-                    int y_hid = (int)((long long)y_web * 4095 / 32767);
-
-                    // 构造命令并入队
-                    HidCommand cmd;
-                    cmd.type = HidCommand::CMD_MOUSE_ABS;
-                    cmd.param1 = x_hid;
-                    cmd.param2 = y_hid;
-                    cmd.param3 = buttons;
-                    cmd.param4 = wheel;
-                    HidPacketQueue::instance()->push(cmd);
-                }
-                // 2. 键盘包 [0x01, Mods, Key]
-                else if (type == 0x01 && msg.size() >= 3) {
-                    HidCommand cmd;
-                    cmd.type = HidCommand::CMD_KEYBOARD;
-                    cmd.param1 = msg[1]; // Mods
-                    cmd.param2 = msg[2]; // Key
-                    HidPacketQueue::instance()->push(cmd);
-                }
-            }
-
+        // --- 3. 等待事件 ---
+        // 帧就绪、网页输入、编码数据、配置变化都会立即唤醒；
+        // 暂停时只剩网络与配置事件 (以及统计输出) 会唤醒本线程
+        m_reactor.runOnce(nextTimeoutMs(paused));
 
+        // --- 4. 定时任务 ---
+        qint64 now = m_loopClock.elapsed();
+        if (m_cameraRetryAtMs >= 0 && now >= m_cameraRetryAtMs) {
+            m_cameraRetryAtMs = -1;
+        }
+        // 连上却迟迟不发请求 (或不收应答) 的连接
+        if (m_server && m_server->has_pending()) m_server->expire_pending();
+        if (m_restartAtMs >= 0 && now >= m_restartAtMs) {
+            m_restartAtMs = -1;
+            reconfigureForSource();     // 按当前时序 (查询不到则用原配置) 重启
+            m_lastFrameMs = m_loopClock.elapsed();
+        } else if (m_watchedCameraFd >= 0 && !paused && now - m_lastFrameMs > SIGNAL_LOST_MS) {
+            // === 没信号 ===
+            // 兜底重启逻辑 (驱动不支持源变化事件，或信号丢失后未再上报)
+            qDebug() << "[videocontroller] Signal lost. Restarting camera...";
+            markSourceLost(now);
+            flushFrameQueues();
+            m_camera->stopCapturing();  // 发送 STREAM_OFF
+            m_restartAtMs = now + RESTART_SETTLE_MS; // 歇一会，让硬件复位 (期间网络照常处理)
         }
 
-        // --- 4. 采集与分发 ---
-        if (m_camera && m_camera->isCapturing()) {
-            size_t len = 0;
-            int index = -1;
-            // dequeue 是非阻塞的，没数据会很快返回 nullptr
-            uint8_t* rawData = m_camera->dequeue(len, index);
-
-            if (rawData) {
-                // 分支1: 本地
-                QImage img;
-                m_camera->toQImage(rawData, len, img);
-                emit frameReady(img);
-                // 分支2: 网络 (直接使用成员变量，已经在 syncHardwareState 中保证了有效性)
-                if (m_encoder && m_server && m_server->GetClientNumber() > 0) {
-                    m_encoder->encode(rawData, [this](uint8_t* data, int size){
-                        m_server->broadcast(data, size);
-                    });
-                }
-                m_camera->enqueue(index);
-            }else{
-                // === 没信号 (dequeue返回空) ===
-                timeoutCounter++;
-                // 自动重启逻辑
-                // 假设 dequeue 超时是 200ms (select)，那么 10 次就是 2秒
-                // 如果你没有用 select，而是纯非阻塞轮询，这里阈值要设大一点（比如 200）
-                if (timeoutCounter > 10) {
-                    qDebug() << "[videocontroller] Signal lost. Restarting camera...";
-                    // 执行重启序列 (模拟手动点击“应用修改”)
-                    m_camera->stopCapturing();  // 发送 STREAM_OFF
-                    QThread::msleep(200);       // 歇一会，让硬件复位
-                    //加锁？
-                    m_camera->startCapturing(m_cfgWidth, m_cfgHeight, m_cfgFmt, m_cfgFps); // 发送 STREAM_ON
-                    // 重置计数器，给新一轮尝试留出时间
-                    timeoutCounter = 0;
-                }
-                // 避免 CPU 100% (如果 dequeue 是纯非阻塞且没加 select，这句很重要)
-                QThread::msleep(10);
+        if (now >= m_reportAtMs) {
+            qDebug() << "[videocontroller] Pipeline:" << pipelineReport();
+            if (m_server) {
+                WebServer::SendStats ss = m_server->send_stats();
+                qDebug() << "[videocontroller] Network send: frames" << ss.sent_frames << "dropped" << ss.dropped_frames
+                         << "resyncs" << ss.resyncs << "queued" << ss.queued_bytes << "B max_client" << ss.max_client_bytes << "B";
+                qDebug() << "[videocontroller] Time to first frame:" << m_server->first_frame_latency().summary().c_str();
             }
-
-        } else {
-            msleep(10);
+            m_reportAtMs = now + REPORT_INTERVAL_MS;
         }
     }
+
+    // 先停下游阶段，再丢弃积压，保证所有租约在摄像头关闭前归还
+    m_displayStage->stop();
+    m_encodeStage->stop();
+    if (m_watchedCameraFd >= 0) {
+        m_reactor.remove(m_watchedCameraFd);
+        m_watchedCameraFd = -1;
+    }
+    flushFrameQueues();
+    m_netQueue.clear();
+
     qDebug() << "[videocontroller] Run loop finished.";
 }
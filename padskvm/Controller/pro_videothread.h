@@ -3,15 +3,41 @@
 
 #include <QThread>
 #include <QMutex>
-#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
+#include <vector>
 #include "../Driver/drv_camera.h"
 #include "../Driver/drv_webserver.h"
 #include "../Tool/videoencoder.h"
+#include "../Tool/bounded_queue.h"
+#include "../Tool/event_reactor.h"
+#include "pro_pipelinestage.h"
+
+// 视频流水线：
+//   采集 + 网络 (本线程事件循环) --[显示队列]--> 显示转换阶段 --> frameReady
+//                               --[编码队列]--> 编码阶段 --[网络队列]--> 回到本线程广播
+// 本线程用一个 epoll 事件循环同时等待 V4L2 fd、监听 socket、每个 WebSocket 客户端，
+// 以及编码阶段/配置接口的唤醒：网页输入到达即处理，帧就绪即分发，循环中没有轮询休眠
+// 显示队列/编码队列传递的是同一帧的共享租约，不拷贝原始数据；
+// 任一阶段变慢只会按队列丢弃策略丢帧，不会阻塞采集
 
 class VideoController : public QThread
 {
     Q_OBJECT
 public:
+    enum PipelineQueue {
+        QUEUE_DISPLAY,  // 采集 -> 显示转换 (FrameLease)
+        QUEUE_ENCODE,   // 采集 -> 编码 (FrameLease)
+        QUEUE_NETWORK   // 编码 -> 网络 (H.264 数据包)
+    };
+
+    enum PipelineStageId {
+        STAGE_CAPTURE,
+        STAGE_DISPLAY,
+        STAGE_ENCODE,
+        STAGE_NETWORK
+    };
+
     explicit VideoController(QObject *parent = nullptr);
     ~VideoController();
 
@@ -25,6 +51,13 @@ public:
     // 更新参数 (线程安全地更新配置，并在下一帧生效)
     void updateSettings(int width, int height, unsigned int fmt, int fps);
 
+    // 更新缓冲策略 (缓冲区数量变化时会重启采集，仅取最新帧可即时切换)
+    void setBufferPolicy(int bufferCount, bool latestFrameOnly);
+
+    // 更新本地显示区域尺寸 (UI 线程调用，下一帧生效)
+    // 采集线程据此直接输出显示尺寸的图像，UI 线程不再缩放
+    void setDisplaySize(const QSize &size);
+
     // 彻底退出线程 (析构时调用)
     void quitThread();
 
@@ -34,6 +67,21 @@ public:
     //关闭视频转发
     void stopServer();
 
+    // 设置队列满时的丢弃策略 (任意线程调用，立即生效)
+    void setQueueDropPolicy(PipelineQueue queue, DropPolicy policy);
+
+    // 流水线统计：队列占用/等待时间、各阶段处理耗时
+    QueueStats queueStats(PipelineQueue queue) const;
+    StageStats stageStats(PipelineStageId stage) const;
+    // 一行文本形式的汇总 (调试输出用)
+    QString pipelineReport() const;
+
+    // 最近一次信号源切换的恢复耗时 (ms；-1 表示尚未发生)，从最后一帧算起：
+    //   总耗时 = 发现 (源变化事件或 SIGNAL_LOST_MS 超时) + 重启 (含兜底路径的复位等待) 到新分辨率首帧
+    int lastSourceRecoveryMs() const { return m_lastRecoveryMs; }
+    int lastSourceDetectMs() const { return m_lastDetectMs; }
+    int lastSourceRestartMs() const { return m_lastRestartMs; }
+
     CameraDevice* m_camera;
 
 protected:
@@ -44,17 +92,24 @@ signals:
     // 每一帧处理完发送信号
     void frameReady(QImage image);
 
+    // 信号源分辨率变化并已按新分辨率重启采集
+    void sourceChanged(QSize size);
+
     //向 ui线程 发送网络传入的 键鼠控制 信息
     //void remoteHidPacketReceived(std::vector<uint8_t> data);
 
+    // 网页端请求批量输入文本 (由网络阶段发出，交给 HidController::typeText)
+    void remoteTextReceived(QString text, QString layout, int intervalMs, bool verify);
+
     // 错误信号
     //void errorOccurred(QString msg);
 
 private:
 
     // --- 线程同步与状态变量 ---
+    // 配置接口修改期望参数后 wake() 事件循环 (取代条件变量)
     QMutex m_mutex;
-    QWaitCondition m_cond;
+    EventReactor m_reactor;
 
     bool m_abort;        // true: 彻底退出线程 loop
     bool m_pause;        // true: 暂停采集
@@ -71,13 +126,77 @@ private:
     int m_cfgFps;
     bool m_cfgNetOn; // 期望的网络开关状态
     int m_cfgPort;
+    QSize m_cfgDisplaySize; // 本地显示区域尺寸 (为空则输出源分辨率)
+    int m_cfgBufCount;      // V4L2 缓冲区数量
+    bool m_cfgLatestOnly;   // 仅取最新帧
 
     // --- 实际运行资源 ---
+    // 编码器由本线程创建销毁、编码阶段使用，用锁保护 (只有重配时才会竞争)
+    // 服务器只在本线程使用
     VideoEncoder *m_encoder;
     WebServer *m_server;
+    QMutex m_encoderMutex;
+    std::atomic<int> m_netClients; // 当前客户端数量 (据此决定是否送编码)
+
+    // --- 流水线 ---
+    BoundedQueue<FrameLease> m_displayQueue;
+    BoundedQueue<FrameLease> m_encodeQueue;
+    BoundedQueue<EncodedPacketPtr> m_netQueue; // 编码输出 (只读共享，发送队列直接引用)
+    StageCounter m_captureCounter;
+    StageCounter m_netCounter;      // 广播耗时 (本线程)
+    PipelineStage *m_displayStage;
+    PipelineStage *m_encodeStage;
+
+    // --- 信号源切换 ---
+    qint64 m_lossStartMs;               // 信号源切换前最后一帧的时刻 (-1 表示未在恢复中，m_loopClock)
+    qint64 m_lossDetectedMs;            // 发现切换的时刻 (源变化事件或超时)
+    std::atomic<int> m_lastRecoveryMs;
+    std::atomic<int> m_lastDetectMs;
+    std::atomic<int> m_lastRestartMs;
+
+    // --- 事件循环状态 (只在本线程使用，时刻取自 m_loopClock，ms) ---
+    QElapsedTimer m_loopClock;
+    int m_watchedCameraFd;      // 正在监听的 V4L2 fd (-1 表示未监听)
+    qint64 m_lastFrameMs;       // 最近一次出帧/重配时刻 (信号丢失判断)
+    qint64 m_restartAtMs;       // 信号丢失后等待硬件复位，到点重启采集 (-1 表示无)
+    qint64 m_cameraRetryAtMs;   // 缓冲区全部被下游占用时暂停监听，到点恢复 (-1 表示无)
+    qint64 m_reportAtMs;        // 下次输出流水线统计的时刻
+    uint64_t m_netQueueDropped; // 已处理过的网络队列丢包数 (有新丢包时各客户端从关键帧重新开始)
+    ParameterSetsPtr m_serverHeaders;   // 已交给服务器的 SPS/PPS (变化时更新)
+    std::atomic<bool> m_keyframeRequest; // 新观看者加入：编码阶段下一帧强制 IDR
 
     // 内部状态同步函数
     void syncHardwareState();
+    // 信号源变化后按新 DV 时序重配 (启动失败时安排 RESTART_SETTLE_MS 后重试)
+    void reconfigureForSource();
+    // 记录发现信号源切换 (恢复计时从最后一帧开始，首帧到达时结束)
+    void markSourceLost(qint64 now);
+    // 停止采集前清空持有租约的队列 (否则 stopCapturing 要等待下游阶段消费完)
+    void flushFrameQueues();
+
+    // 各阶段的单步处理 (在各自线程中循环调用)
+    void displayStep();
+    void encodeStep();
+
+    // 事件循环回调 (本线程)
+    void onCameraReady(uint32_t events);
+    void onListenReady();
+    void onClientEvent(int fd, uint32_t events); // 可写/错误队列通知时续发队列，可读/断开时交给 onClientReady
+    void onClientReady(int fd);
+    void onWake();
+    // 采集状态变化后增删 V4L2 fd 的监听 (暂停或未采集时不监听)
+    void syncCameraWatch(bool paused);
+    // 服务器创建/销毁时登记/注销监听 socket 与客户端
+    void attachServer();
+    void detachServer();
+    // 广播网络队列中的编码数据
+    void flushNetworkQueue();
+    // 更新客户端数量；网页端全部断开时松开它按住的键
+    void updateClientCount();
+    // 下一次需要醒来处理定时任务的等待时间 (ms，-1 表示无限等待)
+    int nextTimeoutMs(bool paused) const;
+    // 解析一条网页端传入的键鼠消息并送入 HID 队列 (eventUs：消息收到的时刻，用于输入延迟统计)
+    void dispatchRemoteInput(const uint8_t *msg, size_t size, int64_t eventUs);
 
 };
 
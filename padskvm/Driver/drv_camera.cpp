@@ -7,10 +7,14 @@
 #include <cstring>
 #include <cstdlib>
 #include <QDebug>
+#include <QBuffer>
+#include <QImageReader>
 
 
 CameraDevice::CameraDevice(QObject *parent) : QObject(parent),
-    m_fd(-1), m_isCapturing(false), m_buffers(nullptr), m_nBuffers(0)
+    m_fd(-1), m_isCapturing(false), m_buffers(nullptr), m_nBuffers(0),
+    m_leasedCount(0), m_bufferCount(DEFAULT_BUFFER_COUNT), m_latestOnly(false), m_skippedFrames(0),
+    m_eventsSubscribed(false), m_sourceChanged(false), m_hasPendingTimings(false)
 {
     // 默认初始化
     m_bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -34,6 +38,9 @@ bool CameraDevice::openDevice(const QString &devicePath)
     // 【关键修改】打开设备后立即检测 API 类型
     probeBufferType();
 
+    // 订阅信号源变化事件 (HDMI 分辨率切换)，不支持的驱动退回超时检测
+    subscribeSourceChange();
+
     return true;
 }
 
@@ -57,6 +64,76 @@ void CameraDevice::probeBufferType()
     }
 }
 
+// 订阅 V4L2_EVENT_SOURCE_CHANGE：HDMI 源切换分辨率/插拔时驱动会立即通知
+void CameraDevice::subscribeSourceChange()
+{
+    struct v4l2_event_subscription sub;
+    memset(&sub, 0, sizeof(sub));
+    sub.type = V4L2_EVENT_SOURCE_CHANGE;
+
+    m_eventsSubscribed = (ioctl(m_fd, VIDIOC_SUBSCRIBE_EVENT, &sub) == 0);
+    m_sourceChanged = false;
+    qDebug() << "[Camera] Source change events" << (m_eventsSubscribed ? "subscribed" : "not supported");
+}
+
+// 取出所有待处理事件 (select 的 exceptfds 就绪时调用)
+void CameraDevice::drainEvents()
+{
+    struct v4l2_event ev;
+    memset(&ev, 0, sizeof(ev));
+    while (ioctl(m_fd, VIDIOC_DQEVENT, &ev) == 0) {
+        if (ev.type == V4L2_EVENT_SOURCE_CHANGE &&
+            (ev.u.src_change.changes & V4L2_EVENT_SRC_CH_RESOLUTION)) {
+            m_sourceChanged = true;
+        }
+        memset(&ev, 0, sizeof(ev));
+    }
+}
+
+bool CameraDevice::takeSourceChange()
+{
+    bool changed = m_sourceChanged;
+    m_sourceChanged = false;
+    return changed;
+}
+
+// 查询信号源当前的 DV 时序 (HDMI 输入桥片，如 TC358743)
+// 无信号 / 信号不稳定 / 驱动不支持时返回 false
+bool CameraDevice::queryDvTimings(int &width, int &height, int &fps)
+{
+    if (m_fd < 0) return false;
+
+    struct v4l2_dv_timings timings;
+    memset(&timings, 0, sizeof(timings));
+    if (ioctl(m_fd, VIDIOC_QUERY_DV_TIMINGS, &timings) < 0) {
+        // ENOLINK: 无信号, ENOLCK: 信号不稳定, ENOTTY: 不支持
+        return false;
+    }
+    if (timings.type != V4L2_DV_BT_656_1120) return false;
+
+    const struct v4l2_bt_timings &bt = timings.bt;
+    width = bt.width;
+    height = bt.height;
+    quint64 frameSize = (quint64)V4L2_DV_BT_FRAME_WIDTH(&bt) * V4L2_DV_BT_FRAME_HEIGHT(&bt);
+    fps = frameSize ? (int)((bt.pixelclock + frameSize / 2) / frameSize) : 0;
+
+    m_pendingTimings = timings;
+    m_hasPendingTimings = true;
+    return true;
+}
+
+// 把 queryDvTimings 得到的时序设置给驱动 (必须在停止采集后、重新申请缓存前调用)
+bool CameraDevice::applyDvTimings()
+{
+    if (m_fd < 0 || !m_hasPendingTimings) return false;
+    m_hasPendingTimings = false;
+    if (ioctl(m_fd, VIDIOC_S_DV_TIMINGS, &m_pendingTimings) < 0) {
+        perror("Set DV Timings Failed");
+        return false;
+    }
+    return true;
+}
+
 void CameraDevice::closeDevice()
 {
     stopCapturing();
@@ -70,6 +147,16 @@ void CameraDevice::closeDevice()
 bool CameraDevice::isOpened() const { return m_fd != -1; }
 bool CameraDevice::isCapturing() const { return m_isCapturing; }
 
+void CameraDevice::setBufferCount(unsigned int count)
+{
+    // 至少 2 个才能一边采集一边处理；上限防止占用过多 CMA 内存
+    if (count < 2) count = 2;
+    if (count > 32) count = 32;
+    m_bufferCount = count;
+}
+
+void CameraDevice::setLatestFrameOnly(bool enable) { m_latestOnly = enable; }
+
 // ================= V4L2 查询逻辑 =================
 
 QList<QPair<QString, unsigned int>> CameraDevice::getSupportedFormats()
@@ -191,10 +278,10 @@ bool CameraDevice::startCapturing(int width, int height, unsigned int pixelForma
     }
     ioctl(m_fd, VIDIOC_S_PARM, &streamparm);
 
-    // 3. 申请缓存
+    // 3. 申请缓存 (驱动可能调整数量，以回读的 req.count 为准)
     struct v4l2_requestbuffers req;
     memset(&req, 0, sizeof(req));
-    req.count = 4;
+    req.count = m_bufferCount;
     req.type = m_bufType; // 【关键】
     req.memory = V4L2_MEMORY_MMAP;
     if (ioctl(m_fd, VIDIOC_REQBUFS, &req) < 0) {
@@ -203,7 +290,7 @@ bool CameraDevice::startCapturing(int width, int height, unsigned int pixelForma
     }
 
     // 4. Mmap
-    m_buffers = (VideoBuffer*)calloc(req.count, sizeof(*m_buffers));
+    m_buffers = new VideoBuffer[req.count](); // 含 atomic 引用计数，不能用 calloc
     m_nBuffers = req.count;
     if (!initMmap()) return false; // 封装了 Mmap 逻辑
 
@@ -214,13 +301,6 @@ bool CameraDevice::startCapturing(int width, int height, unsigned int pixelForma
         return false;
     }
 
-    // 6. 预分配 RGB 缓冲区
-    if (m_pixelFormat == V4L2_PIX_FMT_YUYV ||
-        m_pixelFormat == V4L2_PIX_FMT_UYVY ||
-        m_pixelFormat == V4L2_PIX_FMT_RGB565) {
-        m_rgbBuffer.resize(m_width * m_height * 3);
-    }
-
     m_isCapturing = true;
     return true;
 }
@@ -229,12 +309,15 @@ void CameraDevice::stopCapturing()
 {
     if (!m_isCapturing) return;
 
+    // 消费者可能仍在读取 mmap 缓冲区，必须等全部租约归还后才能解除映射
+    waitLeasesReturned();
+
     enum v4l2_buf_type type = (v4l2_buf_type)m_bufType;
     ioctl(m_fd, VIDIOC_STREAMOFF, &type);
 
     freeMmap();
     if (m_buffers) {
-        free(m_buffers);
+        delete[] m_buffers;
         m_buffers = nullptr;
     }
 
@@ -280,6 +363,7 @@ bool CameraDevice::initMmap()
         }
 
         if (m_buffers[i].start == MAP_FAILED) return false;
+        m_buffers[i].index = i;
 
         // 入队
         if (ioctl(m_fd, VIDIOC_QBUF, &buf) < 0) return false;
@@ -290,30 +374,15 @@ bool CameraDevice::initMmap()
 void CameraDevice::freeMmap()
 {
     for (unsigned int i = 0; i < m_nBuffers; ++i) {
-        if (m_buffers[i].start != MAP_FAILED)
+        if (m_buffers[i].start && m_buffers[i].start != MAP_FAILED)
             munmap(m_buffers[i].start, m_buffers[i].length);
     }
 }
 
-// 1. 出队
-uint8_t* CameraDevice::dequeue(size_t &out_len, int &out_index)
+// 从内核取出一个已就绪的缓冲区，并记录本帧信息
+// 没有就绪帧 (EAGAIN) 或出错时返回 false
+bool CameraDevice::dequeueBuffer(VideoBuffer *&out)
 {
-    if (!m_isCapturing || !m_buffers || m_fd < 0) return nullptr;
-//====================================================================
-    // 1. 使用 select 等待数据 (避免非阻塞模式下的 CPU 空转)
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(m_fd, &fds);
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 200000; // 200ms 超时
-    // 即使 fd 是非阻塞的，select 依然会阻塞在这里等待，直到有数据或超时
-    int r = select(m_fd + 1, &fds, NULL, NULL, &tv);
-    if (r <= 0) {
-        // r=0 (超时) 或 r<0 (错误)
-        return nullptr;
-    }
-//====================================================================
     struct v4l2_buffer buf;
     struct v4l2_plane planes[1];
     memset(&buf, 0, sizeof(buf));
@@ -334,18 +403,80 @@ uint8_t* CameraDevice::dequeue(size_t &out_len, int &out_index)
         if (errno != EAGAIN) {
             perror("DQBUF failed");
         }
-        return nullptr;
+        return false;
     }
 
-    out_index = buf.index;
-
+    VideoBuffer *vb = &m_buffers[buf.index];
     if (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
-        out_len = planes[0].bytesused;
+        vb->bytesused = planes[0].bytesused;
     } else {
-        out_len = buf.bytesused;
+        vb->bytesused = buf.bytesused;
+    }
+    vb->sequence = buf.sequence;
+    vb->timestampUs = (qint64)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+    out = vb;
+    return true;
+}
+
+// 1. 出队：返回帧租约
+FrameLease CameraDevice::acquireFrame()
+{
+    if (!m_isCapturing || !m_buffers || m_fd < 0) return FrameLease();
+//====================================================================
+    // 1. 使用 select 等待数据 (避免非阻塞模式下的 CPU 空转)
+    //    订阅了事件时同时等待 exceptfds (V4L2 事件以 POLLPRI 通知)
+    fd_set fds, efds;
+    FD_ZERO(&fds);
+    FD_ZERO(&efds);
+    FD_SET(m_fd, &fds);
+    if (m_eventsSubscribed) FD_SET(m_fd, &efds);
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 200000; // 200ms 超时
+    // 即使 fd 是非阻塞的，select 依然会阻塞在这里等待，直到有数据或超时
+    int r = select(m_fd + 1, &fds, NULL, m_eventsSubscribed ? &efds : NULL, &tv);
+    if (r <= 0) {
+        // r=0 (超时) 或 r<0 (错误)
+        return FrameLease();
     }
+    bool eventPending = m_eventsSubscribed && FD_ISSET(m_fd, &efds);
+    if (!eventPending && !FD_ISSET(m_fd, &fds)) return FrameLease();
+//====================================================================
+    return takeFrame(eventPending);
+}
+
+FrameLease CameraDevice::takeFrame(bool eventPending)
+{
+    if (!m_isCapturing || !m_buffers || m_fd < 0) return FrameLease();
+
+    // 信号源变化：不再出帧，交给上层按新时序重配
+    if (eventPending && m_eventsSubscribed) {
+        drainEvents();
+        if (m_sourceChanged) return FrameLease();
+    }
+
+    // fd 为非阻塞模式，没有就绪帧时 DQBUF 返回 EAGAIN
+    VideoBuffer *vb = nullptr;
+    if (!dequeueBuffer(vb)) return FrameLease();
+
+    // 仅取最新帧：把已就绪的缓冲区全部取出，只保留最新的一帧，其余立即归还内核
+    // (fd 为非阻塞模式，没有更多就绪帧时 DQBUF 返回 EAGAIN)
+    if (m_latestOnly) {
+        VideoBuffer *newer = nullptr;
+        while (dequeueBuffer(newer)) {
+            enqueue(vb->index);
+            m_skippedFrames.fetch_add(1, std::memory_order_relaxed);
+            vb = newer;
+        }
+    }
+
+    vb->refs.store(1, std::memory_order_relaxed);
 
-    return static_cast<uint8_t*>(m_buffers[buf.index].start);
+    {
+        QMutexLocker locker(&m_leaseMutex);
+        m_leasedCount++;
+    }
+    return FrameLease(this, vb);
 }
 
 // 2. 入队
@@ -370,35 +501,102 @@ void CameraDevice::enqueue(int index)
     ioctl(m_fd, VIDIOC_QBUF, &buf);
 }
 
-// 3. 转换：Raw -> QImage
-void CameraDevice::toQImage(const uint8_t* rawData, size_t len, QImage &outImage)
+// 租约最后一个引用释放：归还内核并唤醒可能在等待的 stopCapturing
+// 可能在任意消费者线程调用 (VIDIOC_QBUF 本身是线程安全的)
+void CameraDevice::releaseLease(VideoBuffer *buffer)
 {
-    if (!rawData) return;
-    // 分支 1: YUYV (4:2:2 Packed)
-    if (m_pixelFormat == V4L2_PIX_FMT_YUYV) {
-        // 软转码：YUYV -> RGB (写入 m_rgbBuffer)
-        yuyv_to_rgb(rawData, m_rgbBuffer.data(), m_width, m_height);
+    enqueue(buffer->index);
+    QMutexLocker locker(&m_leaseMutex);
+    m_leasedCount--;
+    m_leaseCond.wakeAll();
+}
+
+void CameraDevice::waitLeasesReturned()
+{
+    QMutexLocker locker(&m_leaseMutex);
+    while (m_leasedCount > 0) {
+        if (!m_leaseCond.wait(&m_leaseMutex, 1000)) {
+            qDebug() << "[Camera] Waiting for" << m_leasedCount << "frame lease(s) to be returned";
+        }
+    }
+}
+
+// ================= FrameLease =================
+
+FrameLease &FrameLease::operator=(FrameLease &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_camera = other.m_camera;
+        m_buffer = other.m_buffer;
+        other.m_camera = nullptr;
+        other.m_buffer = nullptr;
+    }
+    return *this;
+}
+
+FrameLease FrameLease::share() const
+{
+    if (!m_buffer) return FrameLease();
+    m_buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    return FrameLease(m_camera, m_buffer);
+}
 
-        // 深拷贝：生成独立的 QImage，防止 m_rgbBuffer 在下一帧被覆盖时影响 UI 显示
-        // 注意：QImage(data, ...) 构造函数默认浅拷贝，必须加 .copy()
-        outImage = QImage(m_rgbBuffer.data(), m_width, m_height, QImage::Format_RGB888).copy();
+void FrameLease::reset()
+{
+    if (!m_buffer) return;
+    // acq_rel：保证其他消费者对数据的读取都发生在归还内核之前
+    if (m_buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_camera->releaseLease(m_buffer);
+    }
+    m_camera = nullptr;
+    m_buffer = nullptr;
+}
 
+// V4L2 格式 -> 转换内核格式 (不支持软转码的格式返回 false)
+static bool toConvertFormat(unsigned int pixelFormat, ColorConvert::SourceFormat &out)
+{
+    switch (pixelFormat) {
+        case V4L2_PIX_FMT_YUYV:   out = ColorConvert::SRC_YUYV;   return true;
+        case V4L2_PIX_FMT_UYVY:   out = ColorConvert::SRC_UYVY;   return true;
+        case V4L2_PIX_FMT_RGB565: out = ColorConvert::SRC_RGB565; return true;
+        default: return false;
     }
-    // 分支 2: UYVY (4:2:2 Packed)
-    else if (m_pixelFormat == V4L2_PIX_FMT_UYVY) {
-        uyvy_to_rgb(rawData, m_rgbBuffer.data(), m_width, m_height);
-        outImage = QImage(m_rgbBuffer.data(), m_width, m_height, QImage::Format_RGB888).copy();
+}
+
+// 3. 转换：Raw -> QImage
+void CameraDevice::toQImage(const uint8_t* rawData, size_t len, QImage &outImage, const QSize &targetSize)
+{
+    if (!rawData) return;
+
+    // 输出尺寸：给定显示尺寸时按 KeepAspectRatio 适配 (只缩小不放大，放大仍交给 UI)
+    QSize srcSize(m_width, m_height);
+    QSize outSize = srcSize;
+    if (!targetSize.isEmpty()) {
+        QSize fit = srcSize.scaled(targetSize, Qt::KeepAspectRatio);
+        if (fit.width() < srcSize.width() && !fit.isEmpty()) outSize = fit;
     }
-    // 分支 3: RGBP (RGB565 16bit)
-    else if (m_pixelFormat == V4L2_PIX_FMT_RGB565) {
-        rgb565_to_rgb(rawData, m_rgbBuffer.data(), m_width, m_height);
-        outImage = QImage(m_rgbBuffer.data(), m_width, m_height, QImage::Format_RGB888).copy();
+
+    ColorConvert::SourceFormat srcFmt;
+    // 分支 1: YUYV / UYVY (4:2:2 Packed)、RGBP (RGB565 16bit)
+    // 由 ColorConvert 按 CPU 能力选择 SIMD 内核，输出 RGB32 (QPixmap 原生格式，显示时免转换)
+    // 转换与缩放一次完成，直接写入新 QImage：没有全尺寸中间缓冲，也不需要 .copy()
+    if (toConvertFormat(m_pixelFormat, srcFmt)) {
+        outImage = QImage(outSize, QImage::Format_RGB32);
+        m_scaler.convert(srcFmt, rawData, m_width * 2, m_width, m_height,
+                         outImage.bits(), outImage.bytesPerLine(),
+                         outSize.width(), outSize.height());
     }
-    // 分支 4: MJPEG
+    // 分支 2: MJPEG
     else if (m_pixelFormat == V4L2_PIX_FMT_MJPEG) {
-        // MJPEG 直接解压
-        outImage.loadFromData(rawData, len);
-        // loadFromData 内部会自动创建深拷贝的内存
+        // MJPEG 直接解压；缩小时让解码器按目标尺寸输出 (libjpeg 可在 DCT 域缩放)
+        QByteArray jpeg = QByteArray::fromRawData(reinterpret_cast<const char*>(rawData), (int)len);
+        QBuffer buffer(&jpeg);
+        QImageReader reader(&buffer, "JPEG");
+        if (outSize != srcSize) {
+            reader.setScaledSize(outSize);
+        }
+        outImage = reader.read(); // read 返回独立的深拷贝
     }
 }
 
@@ -420,81 +618,3 @@ void CameraDevice::toQImage(const uint8_t* rawData, size_t len, QImage &outImage
 
 //    return true;
 //}
-
-// 内部算法 // YUYV: Y0 U0 Y1 V0
-void CameraDevice::yuyv_to_rgb(const unsigned char *yuyv, unsigned char *rgb, int width, int height)
-{
-    int y0, u, y1, v;
-    int r0, g0, b0, r1, g1, b1;
-    int i = 0, j = 0;
-
-    for (int row = 0; row < height; row++) {
-        for (int col = 0; col < width; col += 2) {
-            y0 = yuyv[i++]; u  = yuyv[i++];
-            y1 = yuyv[i++]; v  = yuyv[i++];
-
-            // 你的原始优化算法
-            r0 = y0 + 1.402 * (v - 128);
-            g0 = y0 - 0.34414 * (u - 128) - 0.71414 * (v - 128);
-            b0 = y0 + 1.772 * (u - 128);
-
-            r1 = y1 + 1.402 * (v - 128);
-            g1 = y1 - 0.34414 * (u - 128) - 0.71414 * (v - 128);
-            b1 = y1 + 1.772 * (u - 128);
-
-            auto clamp = [](int x) { return (x < 0) ? 0 : ((x > 255) ? 255 : x); };
-            rgb[j++] = clamp(r0); rgb[j++] = clamp(g0); rgb[j++] = clamp(b0);
-            rgb[j++] = clamp(r1); rgb[j++] = clamp(g1); rgb[j++] = clamp(b1);
-        }
-    }
-}
-// UYVY: U0 Y0 V0 Y1 (与 YUYV 只是字节序不同)
-void CameraDevice::uyvy_to_rgb(const unsigned char *uyvy, unsigned char *rgb, int width, int height)
-{
-    int y0, u, y1, v;
-    int i = 0, j = 0;
-    auto clamp = [](int x) { return (x < 0) ? 0 : ((x > 255) ? 255 : x); };
-
-    for (int row = 0; row < height; row++) {
-        for (int col = 0; col < width; col += 2) {
-            // UYVY 排列
-            u  = uyvy[i++]; y0 = uyvy[i++];
-            v  = uyvy[i++]; y1 = uyvy[i++];
-
-            // 下面的公式与 YUYV 完全一致
-            int c = y0 - 16;
-            int d = u - 128;
-            int e = v - 128;
-            rgb[j++] = clamp((298 * c + 409 * e + 128) >> 8);           // R
-            rgb[j++] = clamp((298 * c - 100 * d - 208 * e + 128) >> 8); // G
-            rgb[j++] = clamp((298 * c + 516 * d + 128) >> 8);           // B
-
-            c = y1 - 16;
-            rgb[j++] = clamp((298 * c + 409 * e + 128) >> 8);           // R
-            rgb[j++] = clamp((298 * c - 100 * d - 208 * e + 128) >> 8); // G
-            rgb[j++] = clamp((298 * c + 516 * d + 128) >> 8);           // B
-        }
-    }
-}
-
-// RGB565 -> RGB888
-void CameraDevice::rgb565_to_rgb(const unsigned char *raw, unsigned char *rgb, int width, int height)
-{
-    const uint16_t *src = (const uint16_t *)raw;
-    int j = 0;
-    int totalPixels = width * height;
-
-    for (int i = 0; i < totalPixels; ++i) {
-        uint16_t pixel = src[i];
-
-        // 提取 5-6-5 分量
-        uint8_t r5 = (pixel >> 11) & 0x1F;
-        uint8_t g6 = (pixel >> 5) & 0x3F;
-        uint8_t b5 = pixel & 0x1F;
-
-        // 扩展到 8 位 (R5->R8: x << 3 | x >> 2)
-        rgb[j++] = (r5 << 3) | (r5 >> 2);
-        rgb[j++] = (g6 << 2) | (g6 >> 4);
-        rgb[j++] = (b5 << 3) | (b5 >> 2);
-    }
-}
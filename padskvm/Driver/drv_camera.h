@@ -4,6 +4,11 @@
 #include <QImage>
 #include <QObject>
 #include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+#include "../Tool/colorconvert.h"
 
 // Linux headers
 #include <linux/videodev2.h>
@@ -11,6 +16,57 @@
 struct VideoBuffer {
     void   *start;
     size_t  length;
+
+    // --- 出队期间有效 (由 FrameLease 持有) ---
+    int              index;      // V4L2 缓冲区索引
+    size_t           bytesused;  // 本帧有效数据长度
+    uint32_t         sequence;   // 驱动帧序号
+    qint64           timestampUs;// 驱动采集时间戳 (us, CLOCK_MONOTONIC)
+    std::atomic<int> refs;       // 持有该缓冲区的 FrameLease 数量
+};
+
+class CameraDevice;
+
+// 帧租约：持有一个已出队的 V4L2 mmap 缓冲区
+// - 只能移动不能拷贝；需要多个消费者并发读取同一帧时显式调用 share() 增加引用
+// - 最后一个引用析构 (或 reset) 时自动把缓冲区归还内核 (VIDIOC_QBUF)
+// - 数据只读，且在租约存活期间一直有效 (零拷贝)
+class FrameLease
+{
+public:
+    FrameLease() = default;
+    ~FrameLease() { reset(); }
+
+    FrameLease(FrameLease &&other) noexcept
+        : m_camera(other.m_camera), m_buffer(other.m_buffer)
+    {
+        other.m_camera = nullptr;
+        other.m_buffer = nullptr;
+    }
+    FrameLease &operator=(FrameLease &&other) noexcept;
+
+    FrameLease(const FrameLease &) = delete;
+    FrameLease &operator=(const FrameLease &) = delete;
+
+    // 为另一个消费者创建同一帧的新引用
+    FrameLease share() const;
+    // 提前释放 (最后一个引用时归还缓冲区)
+    void reset();
+
+    bool isValid() const { return m_buffer != nullptr; }
+    explicit operator bool() const { return isValid(); }
+
+    const uint8_t *data() const { return m_buffer ? static_cast<const uint8_t*>(m_buffer->start) : nullptr; }
+    size_t size() const { return m_buffer ? m_buffer->bytesused : 0; }
+    uint32_t sequence() const { return m_buffer ? m_buffer->sequence : 0; }
+    qint64 timestampUs() const { return m_buffer ? m_buffer->timestampUs : 0; }
+
+private:
+    friend class CameraDevice;
+    FrameLease(CameraDevice *camera, VideoBuffer *buffer) : m_camera(camera), m_buffer(buffer) {}
+
+    CameraDevice *m_camera = nullptr;
+    VideoBuffer  *m_buffer = nullptr;
 };
 
 class CameraDevice : public QObject
@@ -35,24 +91,54 @@ public:
     void stopCapturing();
     bool isCapturing() const;
 
-    // === [新增] 拆分 API (支持分流架构) ===
-
-    // 1. 出队：获取一帧原始数据 (阻塞等待)
-    //    返回: 原始数据指针 (失败返回 nullptr)
-    //    out_len: 数据长度
-    //    out_index: 缓冲区索引 (用于 enqueue)
-    uint8_t* dequeue(size_t &out_len, int &out_index);
+    // 信号源变化 (HDMI 输入切换分辨率)
+    // acquireFrame 收到 V4L2_EVENT_SOURCE_CHANGE 时返回无效租约并置位，取走后清零
+    bool takeSourceChange();
+    bool hasSourceChangeEvents() const { return m_eventsSubscribed; }
+    // 查询当前 DV 时序 (成功后由 applyDvTimings 在重启采集前设置给驱动)
+    bool queryDvTimings(int &width, int &height, int &fps);
+    bool applyDvTimings();
+
+    // 缓冲策略
+    // 缓冲区数量 (V4L2 环形队列深度，默认 DEFAULT_BUFFER_COUNT，下一次 startCapturing 生效)
+    //   越多越能吸收编码/UI 的短暂卡顿，但积压时显示的帧也越旧
+    //   默认 6：显示/编码流水线最多同时持有 4 帧，另留 2 个给驱动轮转
+    static const unsigned int DEFAULT_BUFFER_COUNT = 6;
+    void setBufferCount(unsigned int count);
+    unsigned int bufferCount() const { return m_bufferCount; }
+    // 仅取最新帧：出队时取出全部就绪帧，只返回最新一帧，其余立即归还 (以流畅度换延迟)
+    void setLatestFrameOnly(bool enable);
+    bool isLatestFrameOnly() const { return m_latestOnly; }
+    // 仅取最新帧模式下累计跳过的帧数 (任意线程可读)
+    quint64 skippedFrames() const { return m_skippedFrames.load(std::memory_order_relaxed); }
 
-    // 2. 入队：归还缓冲区给内核
-    void enqueue(int index);
+    // === [新增] 拆分 API (支持分流架构) ===
 
-    // 3. 转换：将原始数据转为 QImage (用于 UI 显示)
-    //    支持 YUYV (软转码) 和 MJPEG (软解码)
-    void toQImage(const uint8_t* rawData, size_t len, QImage &outImage);
+    // 1. 出队：获取一帧原始数据的租约 (阻塞等待，最长 200ms)
+    //    返回: 无效租约表示超时或出错
+    //    租约的最后一个引用释放时缓冲区自动归还内核，无需手动入队
+    //    注意：stopCapturing 会等待所有租约归还，持有租约的线程不要调用 stopCapturing
+    FrameLease acquireFrame();
+    // 1'. 不等待的出队 (由外部事件循环监听 fd() 就绪后调用)
+    //    eventPending：fd 报告了 POLLPRI (有待处理的 V4L2 事件)
+    //    没有就绪帧 (或收到信号源变化事件) 时返回无效租约
+    FrameLease takeFrame(bool eventPending);
+    // 设备 fd (采集中可用 poll/epoll 监听 POLLIN 帧就绪、POLLPRI 事件；未打开为 -1)
+    int fd() const { return m_fd; }
+
+    // 2. 转换：将原始数据转为 QImage (用于 UI 显示)
+    //    支持 YUYV/UYVY/RGB565 (SIMD 软转码，输出 RGB32) 和 MJPEG (软解码)
+    //    targetSize: 显示区域尺寸，非空时转换与缩小一次完成 (KeepAspectRatio)，
+    //                UI 线程无需再 scaled；为空则输出源分辨率
+    //    只能在显示转换阶段线程调用 (m_scaler 不加锁)
+    void toQImage(const uint8_t* rawData, size_t len, QImage &outImage, const QSize &targetSize = QSize());
 
     // [兼容旧接口] 内部自动调用上述三个函数
     //bool captureFrame(QImage &image);
 
+    // 获取当前采集分辨率 (驱动回读值)
+    QSize frameSize() const { return QSize(m_width, m_height); }
+
     // 获取当前像素格式 (供 VideoThread 判断是否允许转发)
     unsigned int getPixelFormat() const { return m_pixelFormat; }
 
@@ -60,13 +146,21 @@ private:
     // 内部辅助函数
     bool initMmap();
     void freeMmap();
-    // 视频转换函数
-    void yuyv_to_rgb(const unsigned char *yuyv, unsigned char *rgb, int width, int height);
-    void uyvy_to_rgb(const unsigned char *uyvy, unsigned char *rgb, int width, int height);
-    void rgb565_to_rgb(const unsigned char *raw, unsigned char *rgb, int width, int height);
+
+    // 出队：取出一个就绪缓冲区 (无就绪帧返回 false)
+    bool dequeueBuffer(VideoBuffer *&out);
+    // 入队：归还缓冲区给内核 (由 FrameLease 最后一个引用释放时调用)
+    friend class FrameLease;
+    void enqueue(int index);
+    void releaseLease(VideoBuffer *buffer);
+    // 等待所有租约归还 (停止采集、释放 mmap 之前调用)
+    void waitLeasesReturned();
 
     // 辅助函数：检测设备是否为 MPLANE
     void probeBufferType();
+    // 辅助函数：订阅 / 处理信号源变化事件
+    void subscribeSourceChange();
+    void drainEvents();
 
 private:
 
@@ -86,8 +180,25 @@ private:
     int m_height;
     unsigned int m_pixelFormat;
 
-    // 缓存池 (RGB数据容器)
-    QVector<unsigned char> m_rgbBuffer;
+    // 租约计数 (已出队未归还的缓冲区数量)
+    QMutex m_leaseMutex;
+    QWaitCondition m_leaseCond;
+    int m_leasedCount;
+
+    // 缓冲策略
+    unsigned int m_bufferCount;
+    bool m_latestOnly;
+    std::atomic<quint64> m_skippedFrames;
+
+    // 信号源变化事件
+    bool m_eventsSubscribed;
+    bool m_sourceChanged;
+    bool m_hasPendingTimings;
+    struct v4l2_dv_timings m_pendingTimings;
+
+    // 融合转换/缩放器 (行缓存 + 列映射表)：只由显示转换阶段线程通过 toQImage 使用，无锁
+    // (采集线程只出队/入队缓冲，不调用 toQImage)
+    ColorConvert::Scaler m_scaler;
 };
 
 #endif // DRV_CAMERA_H
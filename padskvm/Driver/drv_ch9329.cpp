@@ -1,6 +1,11 @@
 #include "drv_ch9329.h"
+#include "../Tool/safe_queue.h"
 #include <QDebug>
-#include <unistd.h>
+#include <QTimer>
+#include <QThread>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <cstring>
 
 // CH9329 协议常量
 const uint8_t CH9329_HEAD_0 = 0x57;
@@ -12,11 +17,106 @@ const uint8_t CMD_GET_INFO = 0x01;
 const uint8_t CMD_SEND_KB_GENERAL_DATA = 0x02;
 const uint8_t CMD_SEND_MS_REL_DATA = 0x05;
 const uint8_t CMD_SEND_MS_ABS_DATA = 0x04;
+const uint8_t CMD_GET_PARA_CFG = 0x08;
+const uint8_t CMD_SET_PARA_CFG = 0x09;
+const uint8_t CMD_RESET = 0x0F;
+
+// 应答命令码
+const uint8_t REPLY_OK_FLAG = 0x80;   // 正常应答：command | 0x80
+const uint8_t REPLY_ERR_FLAG = 0xC0;  // 异常应答：command | 0xC0，数据为 1 字节状态码
+const uint8_t STATUS_SUCCESS = 0x00;
+const uint8_t STATUS_ERR_SUM = 0xE4;  // 芯片收到的包校验和错误 (未执行，可安全重发)
+
+// 协商参数
+const int PROBE_TIMEOUT_MS = 100;     // 探测单个速率的应答超时
+const int RESET_SETTLE_MS = 300;      // 复位后芯片重新就绪的等待时间
+const int VERIFY_ROUNDS = 3;          // 新速率往返验证次数
+
+// 应答跟踪参数
+const int64_t ACK_TIMEOUT_US = 100000; // 超过 100ms 未应答视为丢失
+const size_t MAX_INFLIGHT = 64;        // 在途队列上限 (芯片长时间不应答时防止堆积)
+const int MAX_RETRANSMIT = 2;          // 同一包最多重发次数
+
+// 指令码 -> 报告类型 (HidCommand::Type)，非报告类指令返回 -1
+static int reportTypeOf(uint8_t command)
+{
+    switch (command) {
+    case CMD_SEND_KB_GENERAL_DATA: return HidCommand::CMD_KEYBOARD;
+    case CMD_SEND_MS_ABS_DATA:     return HidCommand::CMD_MOUSE_ABS;
+    case CMD_SEND_MS_REL_DATA:     return HidCommand::CMD_MOUSE_REL;
+    default:                       return -1;
+    }
+}
+
+// ==========================================
+// 应答统计
+// ==========================================
+int CH9329LinkStats::slotOf(uint8_t command)
+{
+    switch (command) {
+    case CMD_SEND_KB_GENERAL_DATA: return SLOT_KEYBOARD;
+    case CMD_SEND_MS_ABS_DATA:     return SLOT_MOUSE_ABS;
+    case CMD_SEND_MS_REL_DATA:     return SLOT_MOUSE_REL;
+    default:                       return SLOT_OTHER;
+    }
+}
+
+const char *CH9329LinkStats::slotName(int slot)
+{
+    switch (slot) {
+    case SLOT_KEYBOARD:  return "kb";
+    case SLOT_MOUSE_ABS: return "abs";
+    case SLOT_MOUSE_REL: return "rel";
+    default:             return "other";
+    }
+}
+
+int CH9329LinkStats::statusSlot(uint8_t status)
+{
+    if (status >= 0xE1 && status <= 0xE6) return status - 0xE1;
+    return kStatusSlots - 1;
+}
+
+void CH9329LinkStats::reset()
+{
+    for (int i = 0; i < SLOT_COUNT; ++i) m_rtt[i].reset();
+    m_sent = 0;
+    m_acked = 0;
+    m_nacked = 0;
+    m_retransmits = 0;
+    m_noReply = 0;
+    m_badReplies = 0;
+    m_unmatched = 0;
+    m_superseded = 0;
+    for (int i = 0; i < kStatusSlots; ++i) m_status[i] = 0;
+}
+
+std::string CH9329LinkStats::summary() const
+{
+    char buf[192];
+    snprintf(buf, sizeof(buf), "sent=%llu ack=%llu nak=%llu retx=%llu stale=%llu noreply=%llu badreply=%llu unmatched=%llu",
+             (unsigned long long)sent(), (unsigned long long)acked(), (unsigned long long)nacked(),
+             (unsigned long long)retransmits(), (unsigned long long)superseded(), (unsigned long long)noReply(),
+             (unsigned long long)badReplies(), (unsigned long long)unmatched());
+    std::string out = buf;
+    for (int i = 0; i < SLOT_COUNT; ++i) {
+        if (m_rtt[i].count() == 0) continue;
+        out += " | ";
+        out += slotName(i);
+        out += ": ";
+        out += m_rtt[i].summary();
+    }
+    return out;
+}
 
 CH9329Driver::CH9329Driver(QObject *parent)
-    : QObject(parent), m_serial(new QSerialPort(this))
+    : HidBackend(parent), m_serial(new QSerialPort(this)), m_stats(nullptr),
+      m_writeSeq(0), m_relButtons(0)
 {
+    memset(m_lastSeq, 0, sizeof(m_lastSeq));
     // QSerialPort 作为子对象，随父对象自动析构，无需手动 delete
+    connect(m_serial, &QSerialPort::readyRead, this, &CH9329Driver::onReadyRead);
+    connect(m_serial, &QSerialPort::bytesWritten, this, &HidBackend::bytesFlushed);
 }
 
 CH9329Driver::~CH9329Driver()
@@ -52,6 +152,8 @@ void CH9329Driver::closeDevice()
     if (m_serial->isOpen()) {
         m_serial->close();
     }
+    m_inflight.clear();
+    m_rxBuffer.clear();
 }
 
 // 同步检查函数，仅在初始化连接时使用
@@ -60,24 +162,246 @@ bool CH9329Driver::checkConnection()
     if (!m_serial->isOpen()) return false;
     // 清空缓冲区
     m_serial->clear();
-    std::vector<uint8_t> emptyData;
-    sendPacket(CMD_GET_INFO, emptyData);
-    // 必须等待数据写入完成
-    if (!m_serial->waitForBytesWritten(100)) return false;
     // 等待设备回复 (超时设为 300ms)
-    if (m_serial->waitForReadyRead(300)) {
-        QByteArray response = m_serial->readAll();
-        // 简单校验：长度 > 0 且 帧头正确
-        if (response.size() > 0 && (uint8_t)response[0] == CH9329_HEAD_0) {
-            return true;
+    return transact(CMD_GET_INFO, std::vector<uint8_t>(), nullptr, 300);
+}
+
+// ==========================================
+// 同步收发 / 帧解析
+// ==========================================
+bool CH9329Driver::parseFrame(QByteArray &buffer, uint8_t &command, std::vector<uint8_t> &data,
+                              bool *badChecksum)
+{
+    if (badChecksum) *badChecksum = false;
+    for (;;) {
+        // 1. 找帧头
+        int start = -1;
+        for (int i = 0; i + 1 < buffer.size(); ++i) {
+            if ((uint8_t)buffer[i] == CH9329_HEAD_0 && (uint8_t)buffer[i + 1] == CH9329_HEAD_1) {
+                start = i;
+                break;
+            }
+        }
+        if (start < 0) {
+            // 保留可能是半个帧头的最后一个字节
+            if (!buffer.isEmpty() && (uint8_t)buffer[buffer.size() - 1] == CH9329_HEAD_0) {
+                buffer.remove(0, buffer.size() - 1);
+            } else {
+                buffer.clear();
+            }
+            return false;
+        }
+        if (start > 0) buffer.remove(0, start);
+
+        // 2. 头(2) + 地址(1) + 命令(1) + 长度(1) + 数据(len) + 校验(1)
+        if (buffer.size() < 5) return false;
+        int len = (uint8_t)buffer[4];
+        int total = 5 + len + 1;
+        if (buffer.size() < total) return false;
+
+        uint8_t sum = 0;
+        for (int i = 0; i < total - 1; ++i) sum += (uint8_t)buffer[i];
+        if (sum != (uint8_t)buffer[total - 1]) {
+            // 校验错误：丢掉这一帧的帧头，继续找下一帧
+            if (badChecksum) {
+                *badChecksum = true;
+                command = (uint8_t)buffer[3];
+                buffer.remove(0, total);
+                return false;
+            }
+            buffer.remove(0, 2);
+            continue;
+        }
+
+        command = (uint8_t)buffer[3];
+        data.assign(reinterpret_cast<const uint8_t*>(buffer.constData()) + 5,
+                    reinterpret_cast<const uint8_t*>(buffer.constData()) + 5 + len);
+        buffer.remove(0, total);
+        return true;
+    }
+}
+
+bool CH9329Driver::transact(uint8_t command, const std::vector<uint8_t> &data,
+                            std::vector<uint8_t> *reply, int timeoutMs)
+{
+    if (!m_serial->isOpen()) return false;
+
+    m_serial->readAll(); // 丢弃残留
+    if (writeFrame(command, data) == 0) return false;
+    if (!m_serial->waitForBytesWritten(timeoutMs)) return false;
+
+    QByteArray buffer;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < timeoutMs) {
+        if (!m_serial->waitForReadyRead(timeoutMs - (int)timer.elapsed())) break;
+        buffer.append(m_serial->readAll());
+
+        uint8_t replyCmd = 0;
+        std::vector<uint8_t> replyData;
+        while (parseFrame(buffer, replyCmd, replyData)) {
+            if (replyCmd == (command | REPLY_OK_FLAG)) {
+                if (reply) *reply = replyData;
+                return true;
+            }
+            if (replyCmd == (command | REPLY_ERR_FLAG)) {
+                qDebug() << "[CH9329] Command" << command << "rejected, status"
+                         << (replyData.empty() ? -1 : replyData[0]);
+                return false;
+            }
+            // 其他帧 (如上一条指令迟到的应答) 忽略
         }
     }
     return false;
 }
 
+bool CH9329Driver::verifyLink(int rounds)
+{
+    for (int i = 0; i < rounds; ++i) {
+        if (!transact(CMD_GET_INFO, std::vector<uint8_t>(), nullptr, PROBE_TIMEOUT_MS)) return false;
+    }
+    return true;
+}
+
+// ==========================================
+// 参数配置 / 波特率协商
+// ==========================================
+bool CH9329Driver::readConfig(std::vector<uint8_t> &cfg)
+{
+    if (!transact(CMD_GET_PARA_CFG, std::vector<uint8_t>(), &cfg, 300)) return false;
+    return (int)cfg.size() >= CH9329Config::SIZE;
+}
+
+bool CH9329Driver::writeConfig(const std::vector<uint8_t> &cfg)
+{
+    std::vector<uint8_t> status;
+    if (!transact(CMD_SET_PARA_CFG, cfg, &status, 300)) return false;
+    return !status.empty() && status[0] == STATUS_SUCCESS;
+}
+
+bool CH9329Driver::softReset()
+{
+    std::vector<uint8_t> status;
+    bool ok = transact(CMD_RESET, std::vector<uint8_t>(), &status, 300);
+    // 芯片复位期间串口不可用，等待其重新就绪
+    QThread::msleep(RESET_SETTLE_MS);
+    m_serial->clear();
+    return ok && !status.empty() && status[0] == STATUS_SUCCESS;
+}
+
+QList<int> CH9329Driver::standardBaudRates()
+{
+    // 出厂默认 9600 优先，其次是最常被改到的 115200
+    return QList<int>() << 9600 << 115200 << 57600 << 38400 << 19200;
+}
+
+int CH9329Driver::probeBaudRate(const QList<int> &candidates)
+{
+    if (!m_serial->isOpen()) return 0;
+    for (int baud : candidates) {
+        m_serial->setBaudRate(baud);
+        m_serial->clear();
+        if (transact(CMD_GET_INFO, std::vector<uint8_t>(), nullptr, PROBE_TIMEOUT_MS)) {
+            qDebug() << "[CH9329] Device answers at" << baud;
+            return baud;
+        }
+    }
+    return 0;
+}
+
+bool CH9329Driver::switchChipBaud(int fromBaud, int toBaud)
+{
+    m_serial->setBaudRate(fromBaud);
+    std::vector<uint8_t> cfg;
+    if (!readConfig(cfg)) return false;
+
+    cfg.resize(CH9329Config::SIZE);
+    auto setBaud = [&cfg](int baud) {
+        cfg[CH9329Config::OFF_BAUD + 0] = (uint8_t)((baud >> 24) & 0xFF);
+        cfg[CH9329Config::OFF_BAUD + 1] = (uint8_t)((baud >> 16) & 0xFF);
+        cfg[CH9329Config::OFF_BAUD + 2] = (uint8_t)((baud >> 8) & 0xFF);
+        cfg[CH9329Config::OFF_BAUD + 3] = (uint8_t)(baud & 0xFF);
+    };
+    setBaud(toBaud);
+    if (!writeConfig(cfg)) return false;
+
+    // 新参数复位后生效
+    if (!softReset()) {
+        // 复位未确认：芯片多半仍按原速率运行，主机保持原速率，
+        // 并把参数改回去，免得下次上电芯片换了速率而记录的还是旧值
+        qDebug() << "[CH9329] Reset not acknowledged, keeping baud" << fromBaud;
+        m_serial->setBaudRate(fromBaud);
+        setBaud(fromBaud);
+        writeConfig(cfg);
+        return false;
+    }
+    m_serial->setBaudRate(toBaud);
+    m_serial->clear();
+    return true;
+}
+
+int CH9329Driver::upgradeBaudRate(int targetBaud)
+{
+    if (!m_serial->isOpen()) return 0;
+    int current = m_serial->baudRate();
+    if (current >= targetBaud) return current;
+
+    qDebug() << "[CH9329] Switching baud" << current << "->" << targetBaud;
+    if (!switchChipBaud(current, targetBaud)) {
+        // 参数没写进去或复位未确认：芯片仍在原速率 (不对则重新探测)，不记录新速率
+        qDebug() << "[CH9329] Parameter config failed, staying at" << current;
+        m_serial->setBaudRate(current);
+        return verifyLink(1) ? current : probeBaudRate(standardBaudRates());
+    }
+
+    if (verifyLink(VERIFY_ROUNDS)) {
+        qDebug() << "[CH9329] Link verified at" << targetBaud;
+        return targetBaud;
+    }
+
+    // 新速率不可靠：如果还能在新速率上说话，把芯片改回原速率
+    qDebug() << "[CH9329] Verification at" << targetBaud << "failed, reverting";
+    if (verifyLink(1)) {
+        switchChipBaud(targetBaud, current);
+    } else {
+        m_serial->setBaudRate(current);
+    }
+    if (verifyLink(1)) return current;
+
+    // 状态未知：全速率重新探测
+    return probeBaudRate(standardBaudRates());
+}
+
+int CH9329Driver::savedBaudRate(const QString &portName, int fallback)
+{
+    QSettings settings("padskvm", "padskvm");
+    settings.beginGroup("ch9329");
+    int baud = settings.value(QString(portName).replace('/', '_'), fallback).toInt();
+    settings.endGroup();
+    return baud > 0 ? baud : fallback;
+}
+
+void CH9329Driver::saveBaudRate(const QString &portName, int baud)
+{
+    QSettings settings("padskvm", "padskvm");
+    settings.beginGroup("ch9329");
+    settings.setValue(QString(portName).replace('/', '_'), baud);
+    settings.endGroup();
+}
+
+int CH9329Driver::baudRate() const
+{
+    return m_serial->baudRate();
+}
+
+std::string CH9329Driver::statsSummary() const
+{
+    return m_stats ? m_stats->summary() : std::string();
+}
+
 // === 鼠标逻辑 ===
 //绝对坐标
-void CH9329Driver::sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) {
+int CH9329Driver::sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) {
     if (x < 1) x = 1;
     if (x > 4095) x = 4095;
     if (y < 1) y = 1;
@@ -93,11 +417,11 @@ void CH9329Driver::sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) {
     data.push_back((uint8_t)((char)wheel));
 
     //qDebug() << "[CH9329] Abs Send: X=" << x << " Y=" << y << " Btn=" << buttons;
-    sendPacket(CMD_SEND_MS_ABS_DATA, data);
+    return sendPacket(CMD_SEND_MS_ABS_DATA, data);
 }
 
 //相对坐标
-void CH9329Driver::sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel) {
+int CH9329Driver::sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel) {
     if (xRel > 127) xRel = 127;
     if (xRel < -128) xRel = -128;
     if (yRel > 127) yRel = 127;
@@ -110,29 +434,54 @@ void CH9329Driver::sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t whee
     data.push_back((uint8_t)((char)yRel));
     data.push_back((uint8_t)((char)wheel)); // 滚轮字节
     //data.push_back(0x00);
-    sendPacket(CMD_SEND_MS_REL_DATA, data);
+    return sendPacket(CMD_SEND_MS_REL_DATA, data);
 }
 
 //点击事件
 void CH9329Driver::clickMouse(uint8_t button) {
     sendMouseRel(0, 0, button, 0);
-    usleep(50000); // 50ms 点击间隔
-    sendMouseRel(0, 0, 0, 0);
+    // 50ms 后松开：交给所在线程的事件循环，不阻塞调用线程
+    QTimer::singleShot(50, this, [this]() {
+        sendMouseRel(0, 0, 0, 0);
+    });
 }
 
 // === 键盘值发送 ===
-void CH9329Driver::sendKbPacket(uint8_t modifiers, uint8_t key) {
+int CH9329Driver::sendKbPacket(uint8_t modifiers, uint8_t key) {
+    const uint8_t keys[6] = {key, 0, 0, 0, 0, 0};
+    return sendKbReport(modifiers, keys);
+}
+
+int CH9329Driver::sendKbReport(uint8_t modifiers, const uint8_t keys[6]) {
     std::vector<uint8_t> data(8, 0x00);
     data[0] = modifiers;
     data[1] = 0x00; // 保留位
-    data[2] = key;
-    // data[3]~[7] 默认为0
-    sendPacket(CMD_SEND_KB_GENERAL_DATA, data);
+    for (int i = 0; i < 6; ++i) {
+        data[2 + i] = keys[i];
+    }
+    return sendPacket(CMD_SEND_KB_GENERAL_DATA, data);
 }
 // === 底层发送 ===
-void CH9329Driver::sendPacket(uint8_t command, const std::vector<uint8_t> &data)
+int CH9329Driver::sendPacket(uint8_t command, const std::vector<uint8_t> &data)
 {
-    if (!m_serial || !m_serial->isOpen()) return;
+    int bytes = writeFrame(command, data);
+    if (bytes == 0 || !m_stats) return bytes;
+
+    int64_t now = LatencyHistogram::nowUs();
+    expireInflight(now);
+    if (m_inflight.size() >= MAX_INFLIGHT) {
+        m_inflight.pop_front();
+        m_stats->m_noReply++;
+    }
+    PendingCmd pending = {command, data, now, 0, m_lastSeq[command & 0x3F]};
+    m_inflight.push_back(pending);
+    m_stats->m_sent++;
+    return bytes;
+}
+
+int CH9329Driver::writeFrame(uint8_t command, const std::vector<uint8_t> &data)
+{
+    if (!m_serial || !m_serial->isOpen()) return 0;
 
     // 1. 组包
     uint8_t len = data.size();
@@ -160,8 +509,114 @@ void CH9329Driver::sendPacket(uint8_t command, const std::vector<uint8_t> &data)
 
     packet.push_back(sum);
 
+    // 记录写出顺序：应答晚到时据此判断该包是否已被同类新包取代
+    m_lastSeq[command & 0x3F] = ++m_writeSeq;
+    if (command == CMD_SEND_MS_REL_DATA && data.size() > 1) m_relButtons = data[1];
+
     // 2. 发送 (非阻塞，写入缓冲区即返回，不会卡顿 UI)
     m_serial->write(reinterpret_cast<const char*>(packet.data()), packet.size());
     // 注意：在此处不需要 waitForBytesWritten，让 Qt 事件循环去处理发送，
+    return (int)packet.size();
+}
 
+// ==========================================
+// 异步应答跟踪
+// ==========================================
+void CH9329Driver::setAckTracking(CH9329LinkStats *stats)
+{
+    m_stats = stats;
+    m_inflight.clear();
+    m_rxBuffer.clear();
+}
+
+void CH9329Driver::onReadyRead()
+{
+    // 未开启跟踪时不读取，数据留给同步收发 (transact)
+    if (!m_stats) return;
+
+    m_rxBuffer.append(m_serial->readAll());
+    int64_t now = LatencyHistogram::nowUs();
+
+    uint8_t reply = 0;
+    std::vector<uint8_t> data;
+    for (;;) {
+        bool badChecksum = false;
+        if (parseFrame(m_rxBuffer, reply, data, &badChecksum)) {
+            handleReply(reply, data, now);
+            continue;
+        }
+        if (!badChecksum) break;
+
+        // 应答帧本身损坏：无法得知结果，对应的指令出队但不重发 (相对位移不能重复执行)
+        m_stats->m_badReplies++;
+        uint8_t command = reply & 0x3F;
+        if (!m_inflight.empty() && m_inflight.front().command == command) {
+            m_inflight.pop_front();
+        }
+    }
+    expireInflight(now);
+}
+
+void CH9329Driver::handleReply(uint8_t reply, const std::vector<uint8_t> &data, int64_t nowUs)
+{
+    uint8_t command = reply & 0x3F;
+    bool isError = (reply & REPLY_ERR_FLAG) == REPLY_ERR_FLAG;
+
+    // 芯片按顺序应答：队首之前未应答的指令视为丢失
+    while (!m_inflight.empty() && m_inflight.front().command != command) {
+        m_inflight.pop_front();
+        m_stats->m_noReply++;
+    }
+    if (m_inflight.empty()) {
+        m_stats->m_unmatched++;
+        return;
+    }
+
+    PendingCmd pending = m_inflight.front();
+    m_inflight.pop_front();
+    m_stats->m_rtt[CH9329LinkStats::slotOf(command)].record(nowUs - pending.sentUs);
+
+    uint8_t status = data.empty() ? STATUS_SUCCESS : data[0];
+    if (!isError && status == STATUS_SUCCESS) {
+        m_stats->m_acked++;
+        emit acknowledged(reportTypeOf(command), true);
+        return;
+    }
+
+    m_stats->m_nacked++;
+    m_stats->m_status[CH9329LinkStats::statusSlot(status)]++;
+
+    // 校验和错误说明芯片没有执行该包，可以重发
+    if (status == STATUS_ERR_SUM && pending.retries < MAX_RETRANSMIT) {
+        // 115200 下应答到达时下一包往往已在线路上：若之后写出过同类报告，原样重发会让旧状态
+        // 覆盖新状态 (松开之后再按下 -> 卡键；绝对坐标回退)
+        if (m_lastSeq[pending.command & 0x3F] != pending.seq) {
+            if (pending.command != CMD_SEND_MS_REL_DATA || pending.data.size() < 2) {
+                // 键盘/绝对坐标等状态报告：新包已带当前状态，丢弃即可
+                m_stats->m_superseded++;
+                emit acknowledged(reportTypeOf(command), false);
+                return;
+            }
+            // 相对位移是增量，丢了会少走一段：补发位移与滚轮，按键改为最新状态
+            pending.data[1] = m_relButtons;
+        }
+        int bytes = writeFrame(pending.command, pending.data);
+        if (bytes == 0) return;
+        pending.seq = m_lastSeq[pending.command & 0x3F];
+        pending.sentUs = nowUs;
+        pending.retries++;
+        m_inflight.push_back(pending);
+        m_stats->m_retransmits++;
+        emit retransmitted(bytes);
+        return;
+    }
+    emit acknowledged(reportTypeOf(command), false);
+}
+
+void CH9329Driver::expireInflight(int64_t nowUs)
+{
+    while (!m_inflight.empty() && nowUs - m_inflight.front().sentUs > ACK_TIMEOUT_US) {
+        m_inflight.pop_front();
+        m_stats->m_noReply++;
+    }
 }
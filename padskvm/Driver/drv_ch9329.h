@@ -1,10 +1,82 @@
 #ifndef DRV_CH9329_H
 #define DRV_CH9329_H
 
-#include <QObject>
+#include "drv_hidbackend.h"
 #include <QSerialPort>
+#include <QList>
+#include <QByteArray>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+#include "../Tool/latency_histogram.h"
 
-class CH9329Driver : public QObject
+// CH9329 参数配置 (CMD_GET_PARA_CFG / CMD_SET_PARA_CFG 的 50 字节数据)
+namespace CH9329Config {
+    const int SIZE          = 50;
+    const int OFF_WORK_MODE = 0;   // 芯片工作模式
+    const int OFF_SER_MODE  = 1;   // 串口通信模式
+    const int OFF_ADDR      = 2;   // 串口地址
+    const int OFF_BAUD      = 3;   // 波特率 (4 字节，大端)
+    const int OFF_INTERVAL  = 9;   // 串口包间隔 (2 字节，大端，ms)
+}
+
+// CH9329 应答统计 (驱动在 I/O 线程写入，任意线程读取)
+// - 每类指令：发送 -> 收到应答的往返时间分布
+// - 应答结果：成功 / 芯片报错 (按状态码) / 无应答 / 应答帧校验错误 / 无法对应的应答
+class CH9329LinkStats
+{
+public:
+    enum CmdSlot {
+        SLOT_KEYBOARD,
+        SLOT_MOUSE_ABS,
+        SLOT_MOUSE_REL,
+        SLOT_OTHER,
+        SLOT_COUNT
+    };
+    // 芯片错误状态码 0xE1 ~ 0xE6 (超时/帧头/命令码/校验和/参数/操作失败)，其余归入最后一格
+    static const int kStatusSlots = 7;
+
+    CH9329LinkStats() { reset(); }
+
+    static int slotOf(uint8_t command);
+    static const char *slotName(int slot);
+
+    void reset();
+
+    const LatencyHistogram &rtt(int slot) const { return m_rtt[slot]; }
+    quint64 sent() const { return m_sent; }
+    quint64 acked() const { return m_acked; }
+    quint64 nacked() const { return m_nacked; }
+    quint64 retransmits() const { return m_retransmits; }
+    quint64 noReply() const { return m_noReply; }
+    quint64 badReplies() const { return m_badReplies; }
+    quint64 unmatched() const { return m_unmatched; }
+    // 报校验和错误、但之后已写出同类新报告而不再原样重发的次数
+    quint64 superseded() const { return m_superseded; }
+    // 某个错误状态码出现的次数
+    quint64 statusCount(uint8_t status) const { return m_status[statusSlot(status)]; }
+
+    // "sent=... ack=... nak=... ... | kb: n=... p50=..."
+    std::string summary() const;
+
+private:
+    friend class CH9329Driver;
+    static int statusSlot(uint8_t status);
+
+    LatencyHistogram m_rtt[SLOT_COUNT];
+    std::atomic<quint64> m_sent;
+    std::atomic<quint64> m_acked;
+    std::atomic<quint64> m_nacked;
+    std::atomic<quint64> m_retransmits;
+    std::atomic<quint64> m_noReply;
+    std::atomic<quint64> m_badReplies;
+    std::atomic<quint64> m_unmatched;
+    std::atomic<quint64> m_superseded;
+    std::atomic<quint64> m_status[kStatusSlots];
+};
+
+class CH9329Driver : public HidBackend
 {
     Q_OBJECT
 public:
@@ -14,25 +86,101 @@ public:
     // 初始化串口：portName 例如 "COM3" 或 "ttyUSB0"
     bool init(const QString &portName, int baudRate);
 
+    const char *name() const override { return "CH9329"; }
+
     // 关闭串口
-    void closeDevice();
+    void closeDevice() override;
 
     // 检查连接（同步阻塞检查，仅初始化时调用）
     bool checkConnection();
 
+    // === 波特率协商 (同步阻塞，仅初始化时调用) ===
+    // 常用波特率，按探测优先级排列
+    static QList<int> standardBaudRates();
+    // 依次以候选波特率发送 GET_INFO，串口停在设备应答的速率上；返回该速率，全部失败返回 0
+    int probeBaudRate(const QList<int> &candidates);
+    // 把芯片和本机串口切换到 targetBaud (写参数配置 + 复位)，再做多次往返验证；
+    // 验证失败则把芯片改回原速率。返回最终生效的速率，设备失联返回 0
+    int upgradeBaudRate(int targetBaud);
+
+    // 读写 50 字节参数配置 / 软复位 (参数配置复位后生效)
+    bool readConfig(std::vector<uint8_t> &cfg);
+    bool writeConfig(const std::vector<uint8_t> &cfg);
+    bool softReset();
+
+    // 协商结果持久化 (按串口名记录上次可用的波特率)
+    static int savedBaudRate(const QString &portName, int fallback);
+    static void saveBaudRate(const QString &portName, int baud);
+
+    // 异步应答跟踪：stats 非空时，发送的指令记入在途队列，收到的应答按顺序与之对应，
+    // 统计往返时间与状态码，芯片报校验和错误 (0xE4) 时自动重发；nullptr 关闭跟踪。
+    // 应答比后续包晚到：若之后已写出同类报告，键盘/绝对坐标等状态报告不再重发 (新包已带当前状态)，
+    // 相对位移按最新的按键状态补发位移量
+    // 同步收发 (checkConnection / 波特率协商) 期间必须关闭
+    void setAckTracking(CH9329LinkStats *stats);
+
+    // 当前串口波特率 (用于估算包在线路上的传输时间)
+    int baudRate() const override;
+    // 应答统计摘要 (开启跟踪时)
+    std::string statsSummary() const override;
+
     // --- 鼠标业务功能函数 ---
-    void sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel);
-    void sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel);
+    // send* 返回写入串口的字节数 (未打开时为 0)
+    int sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) override;
+    int sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel) override;
     void clickMouse(uint8_t button);
 
     // --- 键盘业务功能函数 ---
-    void sendKbPacket(uint8_t modifiers, uint8_t key);
+    int sendKbPacket(uint8_t modifiers, uint8_t key);
+    // 完整键盘报告：修饰键 + 最多 6 个同时按下的键 (6KRO)，未用的位置填 0
+    int sendKbReport(uint8_t modifiers, const uint8_t keys[6]) override;
+
+    // 从接收缓冲中解析一帧：成功时移除该帧并返回命令码与数据；
+    // 缓冲开头的垃圾字节会被丢弃；数据不完整返回 false (保留缓冲)
+    // badChecksum 非空时，遇到校验错误的完整帧会置 true 并丢弃该帧
+    static bool parseFrame(QByteArray &buffer, uint8_t &command, std::vector<uint8_t> &data,
+                           bool *badChecksum = nullptr);
+
+private slots:
+    // 串口可读：解析应答并与在途指令对应
+    void onReadyRead();
 
 private:
+    // 在途指令 (已写出、等待应答)
+    struct PendingCmd {
+        uint8_t command;
+        std::vector<uint8_t> data;
+        int64_t sentUs;
+        int retries;
+        uint32_t seq;       // 写出序号 (重发时更新)
+    };
+
     // 持有一个Q串口
     QSerialPort *m_serial;
-    // 内部发包函数
-    void sendPacket(uint8_t command, const std::vector<uint8_t> &data);
+    // 内部发包函数 (跟踪开启时记入在途队列)
+    int sendPacket(uint8_t command, const std::vector<uint8_t> &data);
+    // 组帧并写出，返回字节数 (同时记录该指令码最近一次写出的序号)
+    int writeFrame(uint8_t command, const std::vector<uint8_t> &data);
+    // 处理一帧应答
+    void handleReply(uint8_t reply, const std::vector<uint8_t> &data, int64_t nowUs);
+    // 丢弃超时未应答的在途指令
+    void expireInflight(int64_t nowUs);
+    // 同步收发：发送 command 并等待对应应答帧 (成功应答 = command | 0x80)
+    // reply 为应答数据段；设备返回错误帧 (command | 0xC0) 或超时返回 false
+    bool transact(uint8_t command, const std::vector<uint8_t> &data,
+                  std::vector<uint8_t> *reply, int timeoutMs);
+    // 多次 GET_INFO 往返验证当前速率
+    bool verifyLink(int rounds);
+    // 修改芯片波特率 (写参数 + 复位)，并把本机串口切换过去
+    // 复位未确认时把参数改回 fromBaud、本机保持 fromBaud，返回 false
+    bool switchChipBaud(int fromBaud, int toBaud);
+
+    CH9329LinkStats *m_stats;          // 为空表示不跟踪应答
+    std::deque<PendingCmd> m_inflight;
+    QByteArray m_rxBuffer;
+    uint32_t m_writeSeq;               // 写出序号 (每写出一帧加一)
+    uint32_t m_lastSeq[64];            // 各指令码 (低 6 位) 最近一次写出的序号
+    uint8_t m_relButtons;              // 最近一次写出的相对鼠标报告中的按键状态
 };
 
 #endif // DRV_CH9329_H
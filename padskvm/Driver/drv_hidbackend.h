@@ -0,0 +1,45 @@
+#ifndef DRV_HIDBACKEND_H
+#define DRV_HIDBACKEND_H
+
+#include <QObject>
+#include <cstdint>
+#include <string>
+
+// HID 输出后端接口 (HID I/O 线程持有一个实例)
+// - CH9329Driver：串口 -> CH9329 芯片，受波特率限制
+// - HidGadgetDriver：Linux USB gadget，直接写 /dev/hidgN，原生 USB 轮询速率
+// send* 返回写出的字节数，0 表示未送出 (设备未打开/忙/不支持)
+class HidBackend : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HidBackend(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~HidBackend() {}
+
+    virtual const char *name() const = 0;
+    virtual void closeDevice() = 0;
+
+    virtual int sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) = 0;
+    virtual int sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel) = 0;
+    // 修饰键 + 最多 6 个同时按下的键 (6KRO)，未用的位置填 0
+    virtual int sendKbReport(uint8_t modifiers, const uint8_t keys[6]) = 0;
+
+    // 链路模型 (供发送调度估算何时可以写下一包)
+    // 串口波特率，非串口返回 0
+    virtual int baudRate() const = 0;
+    // 相邻两包的最小间隔 (us)，例如 USB 端点的轮询间隔
+    virtual int minReportIntervalUs() const { return 0; }
+
+    // 后端自己的统计 (写出/忙/错误等)，用于周期日志
+    virtual std::string statsSummary() const { return std::string(); }
+
+signals:
+    // 后端自动重发了一包 (bytes 为写出的字节数，供发送调度计入链路占用)
+    void retransmitted(int bytes);
+    // 一份报告得到最终结果：type 为 HidCommand::Type，ok 为 false 表示设备报错且不再重发
+    void acknowledged(int type, bool ok);
+    // 已写出的字节交给了设备 (串口 bytesWritten / gadget write 返回)，按写出顺序依次完成
+    void bytesFlushed(qint64 bytes);
+};
+
+#endif // DRV_HIDBACKEND_H
@@ -0,0 +1,211 @@
+#include "drv_hidgadget.h"
+#include <QDebug>
+#include <QStringList>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *GADGET_PREFIX = "gadget:";
+// 绝对坐标的逻辑最大值 (与报告描述符 LOGICAL_MAXIMUM 一致)
+static const int ABS_MAX = 4095;
+
+HidGadgetDriver::HidGadgetDriver(QObject *parent)
+    : HidBackend(parent), m_absWarned(false), m_written(0), m_busy(0), m_replaced(0), m_errors(0)
+{
+    for (int i = 0; i < DEV_COUNT; ++i) {
+        m_fd[i] = -1;
+        m_writeNotifier[i] = nullptr;
+        m_pendingLen[i] = 0;
+    }
+}
+
+HidGadgetDriver::~HidGadgetDriver()
+{
+    closeDevice();
+}
+
+bool HidGadgetDriver::isGadgetSpec(const QString &spec)
+{
+    return spec.startsWith(GADGET_PREFIX);
+}
+
+QString HidGadgetDriver::detectGadget()
+{
+    // hidg_setup.sh 按 键盘、相对鼠标、绝对鼠标 的顺序创建功能
+    QStringList nodes;
+    for (int i = 0; i < DEV_COUNT; ++i) {
+        QString node = QString("/dev/hidg%1").arg(i);
+        if (!QFileInfo::exists(node)) break;
+        nodes << node;
+    }
+    if (nodes.size() < 2) return QString();
+    return GADGET_PREFIX + nodes.join(',');
+}
+
+bool HidGadgetDriver::init(const QString &spec)
+{
+    closeDevice();
+    m_absWarned = false;
+
+    if (!isGadgetSpec(spec)) return false;
+    // 不用 QString::SkipEmptyParts (Qt 5.15 起弃用)，分割后去掉空项
+    QStringList nodes = spec.mid((int)strlen(GADGET_PREFIX)).split(',');
+    nodes.removeAll(QString());
+    if (nodes.size() < 2 || nodes.size() > DEV_COUNT) {
+        qDebug() << "[HIDG] Bad gadget spec:" << spec;
+        return false;
+    }
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        QByteArray path = nodes[i].trimmed().toLocal8Bit();
+        m_fd[i] = ::open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (m_fd[i] < 0) {
+            qDebug() << "[HIDG] Open" << path.constData() << "failed:" << strerror(errno);
+            closeDevice();
+            return false;
+        }
+        // 只在有待写报告时启用
+        Device dev = (Device)i;
+        m_writeNotifier[i] = new QSocketNotifier(m_fd[i], QSocketNotifier::Write, this);
+        m_writeNotifier[i]->setEnabled(false);
+        connect(m_writeNotifier[i], &QSocketNotifier::activated, this, [this, dev]() { flushPending(dev); });
+    }
+    qDebug() << "[HIDG] Opened" << nodes.join(", ")
+             << (m_fd[DEV_MOUSE_ABS] < 0 ? "(no absolute mouse)" : "");
+    return true;
+}
+
+void HidGadgetDriver::closeDevice()
+{
+    for (int i = 0; i < DEV_COUNT; ++i) {
+        if (m_writeNotifier[i]) {
+            m_writeNotifier[i]->setEnabled(false);
+            delete m_writeNotifier[i];
+            m_writeNotifier[i] = nullptr;
+        }
+        m_pendingLen[i] = 0;
+        if (m_fd[i] >= 0) {
+            ::close(m_fd[i]);
+            m_fd[i] = -1;
+        }
+    }
+}
+
+bool HidGadgetDriver::tryWrite(Device dev, const uint8_t *report, int len, bool &err)
+{
+    err = false;
+    for (;;) {
+        ssize_t n = ::write(m_fd[dev], report, len);
+        if (n == len) {
+            m_written++;
+            emit bytesFlushed(len); // f_hid 的 write 返回即已放入端点请求
+            return true;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return false;
+        // f_hid 一次 write 就是一份报告，不会只写一部分；普通文件/FIFO 也不应出现
+        m_errors++;
+        if (n < 0) qDebug() << "[HIDG] Write failed:" << strerror(errno);
+        err = true;
+        return false;
+    }
+}
+
+int HidGadgetDriver::writeReport(Device dev, const uint8_t *report, int len)
+{
+    if (m_fd[dev] < 0) return 0;
+
+    if (m_pendingLen[dev] > 0) {
+        // 上一份还在等端点：用新报告替换 (报告是完整状态)，相对鼠标累加位移与滚轮，
+        // 被替换的那份按已完成结算，保持写出记账连续
+        if (dev == DEV_MOUSE_REL) {
+            uint8_t *p = m_pending[dev];
+            p[0] = report[0];
+            for (int i = 1; i < 4; ++i) {
+                p[i] = (uint8_t)(int8_t)qBound(-127, (int)(int8_t)p[i] + (int)(int8_t)report[i], 127);
+            }
+        } else {
+            memcpy(m_pending[dev], report, len);
+        }
+        m_replaced++;
+        emit bytesFlushed(len);
+        return len;
+    }
+
+    bool err;
+    if (tryWrite(dev, report, len, err)) return len;
+    if (err) return 0;
+
+    // 上一份报告还没被主机取走：存为待写报告，端点可写时补写，不阻塞 I/O 线程
+    memcpy(m_pending[dev], report, len);
+    m_pendingLen[dev] = len;
+    m_busy++;
+    if (m_writeNotifier[dev]) m_writeNotifier[dev]->setEnabled(true);
+    return len;
+}
+
+void HidGadgetDriver::flushPending(Device dev)
+{
+    int len = m_pendingLen[dev];
+    if (len == 0 || m_fd[dev] < 0) {
+        if (m_writeNotifier[dev]) m_writeNotifier[dev]->setEnabled(false);
+        return;
+    }
+    bool err;
+    if (!tryWrite(dev, m_pending[dev], len, err) && !err) return; // 仍然忙，等下一次可写
+    // 写出或出错都结束等待 (出错时按已完成结算，避免写出记账卡住)
+    if (err) emit bytesFlushed(len);
+    m_pendingLen[dev] = 0;
+    m_writeNotifier[dev]->setEnabled(false);
+}
+
+int HidGadgetDriver::sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel)
+{
+    if (m_fd[DEV_MOUSE_ABS] < 0) {
+        if (!m_absWarned) {
+            m_absWarned = true;
+            qDebug() << "[HIDG] No absolute mouse function, absolute reports dropped";
+        }
+        return 0;
+    }
+
+    x = qBound(0, x, ABS_MAX);
+    y = qBound(0, y, ABS_MAX);
+    const uint8_t report[6] = {
+        buttons,
+        (uint8_t)(x & 0xFF), (uint8_t)(x >> 8),
+        (uint8_t)(y & 0xFF), (uint8_t)(y >> 8),
+        (uint8_t)wheel
+    };
+    return writeReport(DEV_MOUSE_ABS, report, sizeof(report));
+}
+
+int HidGadgetDriver::sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel)
+{
+    // boot 协议位移为 int8，超出部分截断 (合并器已把单包位移限制在该范围内)
+    const uint8_t report[4] = {
+        buttons,
+        (uint8_t)(int8_t)qBound(-127, xRel, 127),
+        (uint8_t)(int8_t)qBound(-127, yRel, 127),
+        (uint8_t)wheel
+    };
+    return writeReport(DEV_MOUSE_REL, report, sizeof(report));
+}
+
+int HidGadgetDriver::sendKbReport(uint8_t modifiers, const uint8_t keys[6])
+{
+    const uint8_t report[8] = {modifiers, 0, keys[0], keys[1], keys[2], keys[3], keys[4], keys[5]};
+    return writeReport(DEV_KEYBOARD, report, sizeof(report));
+}
+
+std::string HidGadgetDriver::statsSummary() const
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "written=%llu busy=%llu replaced=%llu errors=%llu",
+             (unsigned long long)m_written.load(), (unsigned long long)m_busy.load(),
+             (unsigned long long)m_replaced.load(), (unsigned long long)m_errors.load());
+    return buf;
+}
@@ -0,0 +1,82 @@
+#ifndef DRV_HIDGADGET_H
+#define DRV_HIDGADGET_H
+
+#include "drv_hidbackend.h"
+#include <QString>
+#include <atomic>
+
+class QSocketNotifier;
+
+// Linux USB gadget HID 后端
+// 板子的 USB OTG 口以 gadget 模式接到被控机，通过 configfs 创建 HID 功能 (见 Tool/hidgadget/hidg_setup.sh)，
+// 内核为每个功能生成 /dev/hidgN，写入一份报告即在下一次 USB 轮询时送出 (高速设备 1ms)，不再受串口波特率限制
+//
+// 设备描述串：gadget:<键盘>,<相对鼠标>[,<绝对鼠标>]，例如 gadget:/dev/hidg0,/dev/hidg1,/dev/hidg2
+// 报告格式 (与 hidg_setup.sh 中的报告描述符一一对应)：
+//   键盘     8 字节 [修饰键, 0, k1..k6]            (boot 协议)
+//   相对鼠标 4 字节 [按键, dx, dy, 滚轮]           (boot 协议)
+//   绝对鼠标 6 字节 [按键, xL, xH, yL, yH, 滚轮]    坐标范围 0 ~ 4095，与 CH9329 一致
+// 节点以 O_RDWR | O_NONBLOCK 打开且不创建文件，调试时可用普通文件或 FIFO 代替 (先 mkfifo 并打开读端)
+// 端点忙 (EAGAIN) 时不阻塞 I/O 线程也不丢报告：每个功能保留最新一份未写出的报告，
+// 端点可写时补写 (报告是完整状态，新报告直接替换旧的；相对鼠标的位移累加)，松开动作不会丢失
+class HidGadgetDriver : public HidBackend
+{
+    Q_OBJECT
+public:
+    explicit HidGadgetDriver(QObject *parent = nullptr);
+    ~HidGadgetDriver();
+
+    // 打开描述串中的设备节点：键盘与相对鼠标必须存在，绝对鼠标可省略
+    bool init(const QString &spec);
+
+    // 是否为 gadget 描述串
+    static bool isGadgetSpec(const QString &spec);
+    // 按本机已有的 /dev/hidg0 ~ hidg2 生成描述串 (没有 gadget 时返回空串)
+    static QString detectGadget();
+
+    const char *name() const override { return "USB Gadget"; }
+    void closeDevice() override;
+
+    int sendMouseAbs(int x, int y, uint8_t buttons, int8_t wheel) override;
+    int sendMouseRel(int xRel, int yRel, uint8_t buttons, int8_t wheel) override;
+    int sendKbReport(uint8_t modifiers, const uint8_t keys[6]) override;
+
+    int baudRate() const override { return 0; }
+    // 高速 USB 下 f_hid 中断端点的默认轮询间隔，更快写入只会得到 EAGAIN
+    int minReportIntervalUs() const override { return REPORT_INTERVAL_US; }
+    // 写出/端点忙/被替换/错误计数
+    std::string statsSummary() const override;
+
+    static const int REPORT_INTERVAL_US = 1000;
+
+private:
+    enum Device {
+        DEV_KEYBOARD,
+        DEV_MOUSE_REL,
+        DEV_MOUSE_ABS,
+        DEV_COUNT
+    };
+
+    static const int MAX_REPORT_BYTES = 8;
+
+    // 送出一份完整报告：端点忙或已有报告在等待时存为待写报告，端点可写后补写
+    // 返回接收的字节数 (写出或待写)，失败为 0
+    int writeReport(Device dev, const uint8_t *report, int len);
+    // 立即写一次：true 为已写出，false 为端点忙 (EAGAIN)；出错时 err 置 true
+    bool tryWrite(Device dev, const uint8_t *report, int len, bool &err);
+    // 端点可写：补写待写报告
+    void flushPending(Device dev);
+
+    int m_fd[DEV_COUNT];
+    QSocketNotifier *m_writeNotifier[DEV_COUNT]; // 有待写报告时监听端点可写
+    uint8_t m_pending[DEV_COUNT][MAX_REPORT_BYTES];
+    int m_pendingLen[DEV_COUNT];  // 0 表示没有待写报告
+    bool m_absWarned;             // 未配置绝对鼠标时只提示一次
+
+    std::atomic<quint64> m_written;
+    std::atomic<quint64> m_busy;      // 端点忙、改为待写的次数
+    std::atomic<quint64> m_replaced;  // 待写报告被更新的报告替换 (或位移合并) 的次数
+    std::atomic<quint64> m_errors;
+};
+
+#endif // DRV_HIDGADGET_H
@@ -12,9 +12,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>
 #include <openssl/sha.h>
 #include <openssl/bio.h>
@@ -23,6 +25,11 @@
 #include <iostream>
 #include <algorithm> // 只需要 algorithm，不需要 fstream 和 sstream 了
 
+// MSG_ZEROCOPY 需要 Linux 4.14+ 的内核与头文件，旧工具链上整段编译掉，回退为普通发送
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define WEBSERVER_HAS_ZEROCOPY 1
+#endif
+
 // --- 辅助函数：使用 QFile 读取资源文件 ---
 std::string load_file_content(const std::string& filename) {
     // 将 std::string 转为 QString 以适配 QFile
@@ -48,7 +55,9 @@ std::string load_file_content(const std::string& filename) {
     return data.toStdString();
 }
 
-WebServer::WebServer(int port) {
+WebServer::WebServer(int port)
+    : total_queued_bytes_(0), sent_frames_(0), dropped_frames_(0), resyncs_(0),
+      zerocopy_sends_(0), zerocopy_copied_(0) {
     server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd_ < 0) {
         perror("Socket creation failed");
@@ -80,108 +89,548 @@ WebServer::WebServer(int port) {
 }
 
 WebServer::~WebServer() {
-    for (int fd : clients_) {
-        close(fd);
+    auto it = clients_.begin();
+    while (it != clients_.end()) {
+        it = close_client(it);
+    }
+    while (!pending_.empty()) {
+        close_pending(pending_.begin()->first);
     }
     close(server_fd_);
 }
 
+std::vector<int>::iterator WebServer::close_client(std::vector<int>::iterator it) {
+    int fd = *it;
+    if (fd_watcher_) fd_watcher_(fd, false);
+    auto sit = sessions_.find(fd);
+    if (sit != sessions_.end()) {
+        // 未完成的零拷贝引用随之释放：内核已锁住这些页，关闭后即使内存被复用也只影响这条连接最后的数据
+        total_queued_bytes_ -= sit->second.queued_bytes;
+        sessions_.erase(sit);
+    }
+    close(fd);
+    return clients_.erase(it);
+}
+
 void WebServer::handle_new_connections() {
+    // 一次取完所有等待中的连接 (监听 socket 为非阻塞，没有连接时 accept 返回 EAGAIN)
+    while (accept_client()) {}
+}
+
+bool WebServer::accept_client() {
     struct sockaddr_in client_addr;
     socklen_t addrlen = sizeof(client_addr);
     
     int client_fd = accept(server_fd_, (struct sockaddr *)&client_addr, &addrlen);
-    if (client_fd < 0) return; 
+    if (client_fd < 0) return false; 
 
-    // 读取请求头
-    char buffer[2048] = {0};
-    int n = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-    if (n <= 0) {
+    // 只连不发的连接积压太多：不再接收新的，等超时清理
+    if (pending_.size() >= MAX_PENDING) {
         close(client_fd);
-        return;
+        return true;
+    }
+
+    // 非阻塞：请求头、应答都由事件循环在 socket 就绪时处理，不在这里等待
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+
+    PendingConn& p = pending_[client_fd];
+    p.sent = 0;
+    p.upgrade = false;
+    // 发往本机的数据内核总是拷贝，零拷贝只有额外开销
+    p.loopback = (ntohl(client_addr.sin_addr.s_addr) >> 24) == 127;
+    p.want_write = false;
+    p.accept_us = LatencyHistogram::nowUs();
+    if (fd_watcher_) fd_watcher_(client_fd, true);
+
+    // 请求通常随连接一起到达，先读一次，省一轮事件循环
+    read_pending(client_fd, p);
+    return true;
+}
+
+void WebServer::read_pending(int fd, PendingConn& p) {
+    char buffer[2048];
+    size_t total = 0;
+    while (total < MAX_READ_PER_EVENT) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            close_pending(fd);
+            return;
+        }
+        total += (size_t)n;
+        // 应答阶段再收到的数据 (如 keep-alive 的下一个请求) 直接丢弃：短连接，发完即关
+        if (!p.reply.empty()) continue;
+
+        p.request.append(buffer, (size_t)n);
+        if (p.request.find("\r\n\r\n") != std::string::npos) {
+            route_request(fd, p); // 之后 p 可能已被移除
+            return;
+        }
+        if (p.request.size() > MAX_REQUEST_BYTES) {
+            close_pending(fd);
+            return;
+        }
     }
+}
+
+// 静态文件应答 (找不到时返回 not_found)
+static std::string http_file_reply(const char* resource, const char* content_type, const char* not_found) {
+    std::string content = load_file_content(resource);
+    if (content.empty()) return not_found;
+    std::string reply = std::string("HTTP/1.1 200 OK\r\nContent-Type: ") + content_type
+                      + "\r\nContent-Length: " + std::to_string(content.size()) + "\r\n\r\n";
+    reply += content;
+    return reply;
+}
+
+void WebServer::route_request(int fd, PendingConn& p) {
+    const char* request = p.request.c_str();
 
     // --- 路由逻辑 ---
 
     // 1. WebSocket 升级请求
-    if (strstr(buffer, "Upgrade: websocket")) {
-        if (do_handshake(client_fd, buffer)) {
-            int flags = fcntl(client_fd, F_GETFL, 0);
-            fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-            clients_.push_back(client_fd);
-            qDebug() << "[WebServer] New Client";   //: %s\n", inet_ntoa(client_addr.sin_addr));
-        } else {
-            close(client_fd);
+    if (strstr(request, "Upgrade: websocket")) {
+        if (!do_handshake(request, p.reply)) {
+            close_pending(fd);
+            return;
         }
+        p.upgrade = true;
     }
     // 2. 请求 /jmuxer.min.js
-    else if (strstr(buffer, "GET /jmuxer.min.js HTTP")) {
-        std::string content = load_file_content(":/jmuxer.min.js");
-        if (content.empty()) {
-            const char* not_found = "HTTP/1.1 404 Not Found\r\n\r\n";
-            send(client_fd, not_found, strlen(not_found), 0);
-        } else {
-            std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/javascript\r\nContent-Length: " 
-                               + std::to_string(content.size()) + "\r\n\r\n";
-            send(client_fd, header.c_str(), header.size(), 0);
-            send(client_fd, content.c_str(), content.size(), 0);
-        }
-        close(client_fd); // 发送完文件即关闭 HTTP 短连接
+    else if (strstr(request, "GET /jmuxer.min.js HTTP")) {
+        p.reply = http_file_reply(":/jmuxer.min.js", "application/javascript",
+                                  "HTTP/1.1 404 Not Found\r\n\r\n");
     }
     // 3. 请求 / 或 /index.html
-    else if (strstr(buffer, "GET / HTTP") || strstr(buffer, "GET /index.html HTTP")) {
-        std::string content = load_file_content(":/index.html");
-        if (content.empty()) {
-            const char* not_found = "HTTP/1.1 404 Not Found\r\n\r\nFile index.html not found on server.";
-            send(client_fd, not_found, strlen(not_found), 0);
-        } else {
-            std::string header = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " 
-                               + std::to_string(content.size()) + "\r\n\r\n";
-            send(client_fd, header.c_str(), header.size(), 0);
-            send(client_fd, content.c_str(), content.size(), 0);
-        }
-        close(client_fd);
+    else if (strstr(request, "GET / HTTP") || strstr(request, "GET /index.html HTTP")) {
+        p.reply = http_file_reply(":/index.html", "text/html",
+                                  "HTTP/1.1 404 Not Found\r\n\r\nFile index.html not found on server.");
     }
     // 其他请求忽略
     else {
-        close(client_fd);
+        close_pending(fd);
+        return;
+    }
+    std::string().swap(p.request);
+    flush_pending(fd, p);
+}
+
+void WebServer::flush_pending(int fd, PendingConn& p) {
+    while (p.sent < p.reply.size()) {
+        ssize_t n = send(fd, p.reply.data() + p.sent, p.reply.size() - p.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 发送缓冲满 (较大的 js 文件)：等可写时继续
+            if (!p.want_write && write_watcher_) write_watcher_(fd, true);
+            p.want_write = true;
+            return;
+        }
+        if (n <= 0) {
+            close_pending(fd);
+            return;
+        }
+        p.sent += (size_t)n;
+    }
+    if (p.want_write && write_watcher_) write_watcher_(fd, false);
+
+    if (p.upgrade) {
+        promote_client(fd, p.loopback);
+    } else {
+        close_pending(fd); // 发送完文件即关闭 HTTP 短连接
+    }
+}
+
+void WebServer::close_pending(int fd) {
+    if (fd_watcher_) fd_watcher_(fd, false);
+    pending_.erase(fd);
+    close(fd);
+}
+
+void WebServer::expire_pending() {
+    int64_t now = LatencyHistogram::nowUs();
+    std::vector<int> expired;
+    for (const auto& entry : pending_) {
+        if (now - entry.second.accept_us > PENDING_TIMEOUT_US) expired.push_back(entry.first);
     }
+    for (int fd : expired) close_pending(fd);
 }
 
-void WebServer::broadcast(uint8_t* data, int len) {
+void WebServer::promote_client(int client_fd, bool loopback) {
+    // fd 已在事件循环中监听 (回调同一个)，只需从待握手表移到客户端表
+    pending_.erase(client_fd);
+    clients_.push_back(client_fd);
+    Session& session = sessions_[client_fd];
+    session.ring.resize(MAX_QUEUED_FRAMES);
+    session.head = 0;
+    session.count = 0;
+    session.queued_bytes = 0;
+    // 新客户端从关键帧开始 (之前的 P 帧没有参考无法解码)，先收参数集
+    session.waiting_idr = true;
+    session.want_write = false;
+    session.needs_headers = true;
+    session.join_us = LatencyHistogram::nowUs();
+    session.zerocopy = !loopback && enable_zerocopy(client_fd);
+    session.zerocopy_capable = session.zerocopy;
+    session.zc_next_id = 0;
+    session.zc_copied_run = 0;
+    // 请求编码器下一帧就输出 IDR，新观看者不用等到 GOP 结束
+    if (keyframe_requester_) keyframe_requester_();
+    qDebug() << "[WebServer] New Client";
+}
+
+void WebServer::broadcast(const uint8_t* data, int len, bool keyframe) {
+    if (clients_.empty()) return;
+    std::shared_ptr<std::vector<uint8_t>> owner = std::make_shared<std::vector<uint8_t>>(data, data + len);
+    broadcast(owner, owner->data(), owner->size(), keyframe);
+}
+
+void WebServer::broadcast(std::shared_ptr<const void> owner, const uint8_t* data, size_t len, bool keyframe) {
     if (clients_.empty()) return;
 
-    uint8_t frame_header[14];
-    int header_len = 0;
+    // 帧头与负载引用放在同一个只读对象里，所有客户端共享 (负载不拷贝)
+    std::shared_ptr<WireFrame> frame = std::make_shared<WireFrame>();
+    uint8_t* frame_header = frame->header;
     frame_header[0] = 0x82;
 
     if (len <= 125) {
         frame_header[1] = len;
-        header_len = 2;
+        frame->header_len = 2;
     } else if (len <= 65535) {
         frame_header[1] = 126;
         *(uint16_t*)&frame_header[2] = htons(len);
-        header_len = 4;
+        frame->header_len = 4;
     } else {
         frame_header[1] = 127;
         *(uint64_t*)&frame_header[2] = htonll(len);
-        header_len = 10;
+        frame->header_len = 10;
     }
+    frame->owner = std::move(owner);
+    frame->payload = data;
+    frame->payload_size = len;
+    frame->keyframe = keyframe;
+    frame->control = false;
 
     auto it = clients_.begin();
     while (it != clients_.end()) {
-        int fd = *it;
-        bool success = true;
-        if (send(fd, frame_header, header_len, MSG_NOSIGNAL) < 0) success = false;
-        if (success && send(fd, data, len, MSG_NOSIGNAL) < 0) success = false;
-
-        if (!success) {
-            close(fd);
-            it = clients_.erase(it);
+        Session& s = sessions_[*it];
+        queue_video(s, frame);
+        if (!flush(*it, s)) {
+            it = close_client(it);
         } else {
             ++it;
         }
     }
+    enforce_global_cap();
+}
+
+void WebServer::set_stream_headers(std::shared_ptr<const void> owner, const uint8_t* data, size_t len) {
+    // 参数集只有几十字节，超过 64KB 视为无效
+    if (!owner || len == 0 || len > 65535) {
+        stream_headers_.reset();
+        return;
+    }
+    std::shared_ptr<WireFrame> frame = std::make_shared<WireFrame>();
+    frame->header[0] = 0x82;
+    if (len <= 125) {
+        frame->header[1] = (uint8_t)len;
+        frame->header_len = 2;
+    } else {
+        frame->header[1] = 126;
+        *(uint16_t*)&frame->header[2] = htons((uint16_t)len);
+        frame->header_len = 4;
+    }
+    frame->owner = std::move(owner);
+    frame->payload = data;
+    frame->payload_size = len;
+    frame->keyframe = false;
+    frame->control = true;
+    stream_headers_ = frame;
+}
+
+void WebServer::flush_client(int fd) {
+    auto pit = pending_.find(fd);
+    if (pit != pending_.end()) {
+        flush_pending(fd, pit->second);
+        return;
+    }
+    auto sit = sessions_.find(fd);
+    if (sit == sessions_.end()) return;
+    // EPOLLERR 可能只是错误队列里有完成通知：读空，否则水平触发会一直报告
+    if (sit->second.zerocopy_capable) reap_zerocopy(fd, sit->second);
+    if (!flush(fd, sit->second)) {
+        auto it = std::find(clients_.begin(), clients_.end(), fd);
+        if (it != clients_.end()) close_client(it);
+    }
+}
+
+void WebServer::resync_all() {
+    for (auto& entry : sessions_) {
+        start_resync(entry.second);
+    }
+}
+
+WebServer::SendStats WebServer::send_stats() const {
+    SendStats stats = {sent_frames_, dropped_frames_, resyncs_, total_queued_bytes_, 0,
+                       zerocopy_sends_, zerocopy_copied_, 0};
+    for (const auto& entry : sessions_) {
+        stats.max_client_bytes = std::max(stats.max_client_bytes, entry.second.queued_bytes);
+        stats.zerocopy_inflight += entry.second.zc_inflight.size();
+    }
+    return stats;
+}
+
+bool WebServer::push_frame(Session& s, const WireFramePtr& frame) {
+    if (s.count >= s.ring.size()) return false;
+    OutFrame& f = s.ring[(s.head + s.count) % s.ring.size()];
+    f.frame = frame;
+    f.offset = 0;
+    s.count++;
+    s.queued_bytes += frame->size();
+    total_queued_bytes_ += frame->size();
+    return true;
+}
+
+void WebServer::queue_control(int fd, Session& s, uint8_t opcode, const uint8_t* payload, size_t len) {
+    if (len > 125) len = 125;
+    std::shared_ptr<WireFrame> frame = std::make_shared<WireFrame>();
+    frame->header[0] = 0x80 | opcode;
+    frame->header[1] = (uint8_t)len;
+    frame->header_len = 2;
+    std::shared_ptr<std::vector<uint8_t>> owner = std::make_shared<std::vector<uint8_t>>(payload, payload + len);
+    frame->payload = owner->data();
+    frame->payload_size = owner->size();
+    frame->owner = std::move(owner);
+    frame->keyframe = false;
+    frame->control = true;
+
+    // 槽位满时先腾出未开始发送的视频帧 (接收方已经跟不上，视频本来就要重新同步)
+    if (s.count >= s.ring.size()) start_resync(s);
+    if (!push_frame(s, frame)) {
+        qDebug() << "[WebServer] Send queue full, control frame dropped, fd" << fd;
+    }
+}
+
+void WebServer::queue_video(Session& s, const WireFramePtr& frame) {
+    size_t size = frame->size();
+    bool backlogged = s.count >= BACKLOG_FRAMES || s.queued_bytes > BACKLOG_BYTES
+                   || s.queued_bytes + size > CLIENT_MAX_BYTES || s.count >= s.ring.size();
+
+    // 积压过多：旧帧已经没有意义，丢掉未发送的部分，从关键帧重新开始
+    if (backlogged && !s.waiting_idr) start_resync(s);
+
+    if (s.waiting_idr) {
+        // 只有关键帧能让解码器重新同步，且清空后仍要放得下 (新客户端跳过的帧不算丢帧)
+        if (!frame->keyframe || s.queued_bytes + size > CLIENT_MAX_BYTES || s.count + 1 >= s.ring.size()) {
+            if (!s.needs_headers) dropped_frames_++;
+            return;
+        }
+        s.waiting_idr = false;
+        if (s.needs_headers) {
+            if (stream_headers_) push_frame(s, stream_headers_);
+            s.needs_headers = false;
+        }
+    }
+    push_frame(s, frame);
+}
+
+size_t WebServer::start_resync(Session& s) {
+    // 保留已开始发送的帧 (必须发完，否则对端 WebSocket 流错乱) 与控制帧，其余视频帧按顺序丢弃
+    size_t cap = s.ring.size();
+    size_t kept = 0;
+    size_t freed = 0;
+    for (size_t i = 0; i < s.count; ++i) {
+        OutFrame& f = s.ring[(s.head + i) % cap];
+        if (f.offset > 0 || f.frame->control) {
+            if (kept != i) s.ring[(s.head + kept) % cap] = std::move(f);
+            kept++;
+        } else {
+            freed += f.frame->size();
+            f.frame.reset();
+            dropped_frames_++;
+        }
+    }
+    for (size_t i = kept; i < s.count; ++i) {
+        s.ring[(s.head + i) % cap].frame.reset();
+    }
+    s.count = kept;
+    s.queued_bytes -= freed;
+    total_queued_bytes_ -= freed;
+
+    if (!s.waiting_idr) {
+        s.waiting_idr = true;
+        resyncs_++;
+    }
+    return freed;
+}
+
+void WebServer::enforce_global_cap() {
+    while (total_queued_bytes_ > GLOBAL_MAX_BYTES) {
+        // 每次只处理积压最多的客户端，网络好的客户端不受影响
+        Session* worst = nullptr;
+        for (auto& entry : sessions_) {
+            if (!worst || entry.second.queued_bytes > worst->queued_bytes) worst = &entry.second;
+        }
+        if (!worst || start_resync(*worst) == 0) break;
+    }
+}
+
+bool WebServer::flush(int fd, Session& s) {
+    if (!s.zc_inflight.empty()) reap_zerocopy(fd, s);
+
+    bool allow_zerocopy = s.zerocopy;
+    while (s.count > 0) {
+        struct iovec iov[MAX_IOV];
+        bool zerocopy = false;
+        int iovcnt = gather(s, iov, allow_zerocopy, zerocopy);
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; ++i) total += iov[i].iov_len;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#ifdef WEBSERVER_HAS_ZEROCOPY
+        if (zerocopy) flags |= MSG_ZEROCOPY;
+#endif
+        ssize_t n = sendmsg(fd, &msg, flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            // 锁页额度 (optmem_max) 用完：本轮改用普通发送
+            if (zerocopy && errno == ENOBUFS) {
+                allow_zerocopy = false;
+                continue;
+            }
+            return false;
+        }
+        if (zerocopy) {
+            // 每次成功的零拷贝发送占用一个序号，完成通知按序号区间返回；期间保持帧的引用
+            ZeroCopyRef ref = {s.zc_next_id++, s.ring[s.head].frame};
+            s.zc_inflight.push_back(std::move(ref));
+            zerocopy_sends_++;
+        }
+        consume(fd, s, (size_t)n);
+        if ((size_t)n < total) break; // 短写：内核发送缓冲已满，等可写通知
+    }
+
+    // 队列非空才需要可写通知 (水平触发，一直开着会空转)
+    bool want = s.count > 0;
+    if (want != s.want_write) {
+        s.want_write = want;
+        if (write_watcher_) write_watcher_(fd, want);
+    }
+    return true;
+}
+
+int WebServer::gather(Session& s, struct iovec* iov, bool allow_zerocopy, bool& zerocopy) {
+    size_t cap = s.ring.size();
+    int iovcnt = 0;
+    zerocopy = false;
+    for (size_t i = 0; i < s.count && iovcnt + 2 <= MAX_IOV; ++i) {
+        const OutFrame& f = s.ring[(s.head + i) % cap];
+        const WireFrame& w = *f.frame;
+        size_t header_left = f.offset < w.header_len ? w.header_len - f.offset : 0;
+        size_t payload_off = f.offset > w.header_len ? f.offset - w.header_len : 0;
+        size_t payload_left = w.payload_size - payload_off;
+
+        // 大负载单独一次发送，便于按帧登记零拷贝引用
+        bool large = allow_zerocopy && payload_left >= ZEROCOPY_MIN_BYTES;
+        if (large && i > 0) break;
+
+        if (header_left > 0) {
+            iov[iovcnt].iov_base = const_cast<uint8_t*>(w.header + f.offset);
+            iov[iovcnt].iov_len = header_left;
+            iovcnt++;
+        }
+        if (payload_left > 0) {
+            iov[iovcnt].iov_base = const_cast<uint8_t*>(w.payload + payload_off);
+            iov[iovcnt].iov_len = payload_left;
+            iovcnt++;
+        }
+        if (large) {
+            zerocopy = true;
+            break;
+        }
+    }
+    return iovcnt;
+}
+
+void WebServer::consume(int fd, Session& s, size_t n) {
+    size_t cap = s.ring.size();
+    s.queued_bytes -= n;
+    total_queued_bytes_ -= n;
+    while (n > 0 && s.count > 0) {
+        OutFrame& f = s.ring[s.head];
+        size_t left = f.frame->size() - f.offset;
+        if (n < left) {
+            f.offset += n;
+            return;
+        }
+        n -= left;
+        if (s.join_us > 0 && !f.frame->control) {
+            int64_t us = LatencyHistogram::nowUs() - s.join_us;
+            first_frame_latency_.record(us);
+            s.join_us = 0;
+            qDebug() << "[WebServer] First frame to fd" << fd << "after" << us / 1000 << "ms";
+        }
+        f.frame.reset();
+        s.head = (s.head + 1) % cap;
+        s.count--;
+        sent_frames_++;
+    }
+}
+
+bool WebServer::enable_zerocopy(int fd) {
+#ifdef WEBSERVER_HAS_ZEROCOPY
+    int one = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+void WebServer::reap_zerocopy(int fd, Session& s) {
+#ifdef WEBSERVER_HAS_ZEROCOPY
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break; // EAGAIN：没有更多通知
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR) continue;
+            const struct sock_extended_err* err = (const struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // [ee_info, ee_data] 区间内的发送已完成，内核不再引用这些内存
+            uint32_t lo = err->ee_info;
+            uint32_t hi = err->ee_data;
+            auto done = std::remove_if(s.zc_inflight.begin(), s.zc_inflight.end(),
+                                       [lo, hi](const ZeroCopyRef& ref) { return ref.id - lo <= hi - lo; });
+            s.zc_inflight.erase(done, s.zc_inflight.end());
+
+            // 内核实际做了拷贝 (loopback、网卡不支持 scatter-gather 等)：零拷贝只剩额外开销，连续出现则停用
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zerocopy_copied_ += hi - lo + 1;
+                if (s.zerocopy && ++s.zc_copied_run >= ZEROCOPY_COPIED_LIMIT) {
+                    s.zerocopy = false;
+                    qDebug() << "[WebServer] Zerocopy falls back to copying, disabled for fd" << fd;
+                }
+            } else {
+                s.zc_copied_run = 0;
+            }
+        }
+    }
+#else
+    (void)fd;
+    (void)s;
+#endif
 }
 
 uint64_t WebServer::htonll(uint64_t val) {
@@ -205,14 +654,14 @@ char* WebServer::base64_encode(const unsigned char* input, int length) {
     return buff;
 }
 
-bool WebServer::do_handshake(int client_fd, char* buf) {
-    char *key_start = strstr(buf, "Sec-WebSocket-Key");
+bool WebServer::do_handshake(const char* buf, std::string& response) {
+    const char *key_start = strstr(buf, "Sec-WebSocket-Key");
     if (!key_start) return false;
     key_start = strchr(key_start, ':');
     if (!key_start) return false;
     key_start++; 
     while (*key_start == ' ') key_start++;
-    char *key_end = strstr(key_start, "\r\n");
+    const char *key_end = strstr(key_start, "\r\n");
     if (!key_end) return false;
 
     char client_key[128] = {0};
@@ -228,61 +677,96 @@ bool WebServer::do_handshake(int client_fd, char* buf) {
     SHA1((unsigned char *)combined, strlen(combined), sha1_hash);
     char *accept_key = base64_encode(sha1_hash, SHA_DIGEST_LENGTH);
 
-    char response[512];
-    sprintf(response, 
+    response = std::string(
         "HTTP/1.1 101 Switching Protocols\r\n"
         "Upgrade: websocket\r\n"
         "Connection: Upgrade\r\n"
-        "Sec-WebSocket-Accept: %s\r\n\r\n", 
-        accept_key);
-    
-    send(client_fd, response, strlen(response), 0);
+        "Sec-WebSocket-Accept: ") + accept_key + "\r\n\r\n";
     free(accept_key);
     return true;
 }
 std::vector<std::vector<uint8_t>> WebServer::process_client_messages() {
     std::vector<std::vector<uint8_t>> messages;
-    uint8_t buf[2048]; 
+    // 拷贝一份：read_client 可能关闭并移除客户端
+    const std::vector<int> fds = clients_;
+    for (int fd : fds) {
+        read_client(fd, [&messages](const uint8_t* data, size_t size) {
+            messages.emplace_back(data, data + size);
+        });
+    }
+    return messages;
+}
 
-    auto it = clients_.begin();
-    while (it != clients_.end()) {
-        int fd = *it;
-        int n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
-        
-        if (n > 0) {
-            uint8_t opcode = buf[0] & 0x0F;
-            uint8_t payload_len = buf[1] & 0x7F;
-
-            if (opcode == 0x8) { // Close
-                close(fd);
-                it = clients_.erase(it);
-                continue;
-            }
+void WebServer::reject_client(int fd, uint16_t status) {
+    auto it = std::find(clients_.begin(), clients_.end(), fd);
+    if (it == clients_.end()) return;
+    uint8_t code[2] = {(uint8_t)(status >> 8), (uint8_t)(status & 0xFF)};
+    Session& s = sessions_[fd];
+    queue_control(fd, s, WsFrameParser::OP_CLOSE, code, sizeof(code));
+    // 尽力发出 close 帧 (以及前面正在发送的帧)，然后关闭
+    flush(fd, s);
+    close_client(it);
+}
 
-            // Opcode 0x1 (Text) 或 0x2 (Binary) 均处理
-            if ((opcode == 0x1 || opcode == 0x2) && payload_len > 0) {
-                // 简单处理短包
-                if (payload_len < 126) {
-                    uint32_t masking_key;
-                    memcpy(&masking_key, &buf[2], 4);
-                    
-                    std::vector<uint8_t> decoded(payload_len);
-                    uint8_t* mask = (uint8_t*)&masking_key;
-                    
-                    for (int i = 0; i < payload_len; i++) {
-                        decoded[i] = buf[6 + i] ^ mask[i % 4];
-                    }
-                    messages.push_back(decoded);
-                }
+void WebServer::read_client(int fd, const MessageHandler& on_message) {
+    auto pit = pending_.find(fd);
+    if (pit != pending_.end()) {
+        read_pending(fd, pit->second);
+        return;
+    }
+    auto sit = sessions_.find(fd);
+    if (sit == sessions_.end()) return;
+    Session& session = sit->second;
+    WsFrameParser& parser = session.parser;
+
+    // 一次把内核里积压的数据读完 (快速移动鼠标时一次可读到几十帧)，再逐帧解析
+    size_t total = 0;
+    while (total < MAX_READ_PER_EVENT) {
+        ssize_t n = recv(fd, parser.prepare(RECV_CHUNK), RECV_CHUNK, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            // 对端关闭或连接出错 (事件循环为水平触发，出错的 fd 不关掉会一直报告就绪)
+            auto it = std::find(clients_.begin(), clients_.end(), fd);
+            if (it != clients_.end()) close_client(it);
+            return;
+        }
+        parser.commit((size_t)n);
+        total += (size_t)n;
+
+        WsFrameParser::Message msg;
+        while (parser.next(msg)) {
+            switch (msg.opcode) {
+            case WsFrameParser::OP_TEXT:
+            case WsFrameParser::OP_BINARY:
+                if (msg.size > 0) on_message(msg.data, msg.size);
+                break;
+            case WsFrameParser::OP_PING:
+                queue_control(fd, session, WsFrameParser::OP_PONG, msg.data, msg.size);
+                break;
+            case WsFrameParser::OP_CLOSE:
+                // 原样回送对端的关闭码后关闭
+                queue_control(fd, session, WsFrameParser::OP_CLOSE, msg.data, msg.size < 2 ? msg.size : 2);
+                flush(fd, session);
+                close_client(std::find(clients_.begin(), clients_.end(), fd));
+                return;
+            default: // OP_PONG
+                break;
             }
-        } else if (n == 0) {
-            close(fd);
-            it = clients_.erase(it);
-            continue;
         }
-        ++it;
+        if (parser.hasError()) {
+            qDebug() << "[WebServer] Protocol error:" << parser.error();
+            reject_client(fd, parser.closeCode());
+            return;
+        }
+        // 短读说明内核缓冲已读空，省掉一次返回 EAGAIN 的 recv
+        if ((size_t)n < RECV_CHUNK) break;
+    }
+    // 发出本批产生的 pong
+    if (session.count > 0 && !flush(fd, session)) {
+        auto it = std::find(clients_.begin(), clients_.end(), fd);
+        if (it != clients_.end()) close_client(it);
     }
-    return messages;
 }
 
 // 获取客户端数量
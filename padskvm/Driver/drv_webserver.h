@@ -3,7 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <cstdint> // for uint8_t, uint64_t
+#include <sys/uio.h> // for iovec
+
+#include "drv_wsparser.h"
+#include "../Tool/latency_histogram.h"
 
 class WebServer {
 public:
@@ -13,26 +21,229 @@ public:
     // 析构函数：关闭所有连接
     ~WebServer();
 
-    // 核心轮询函数：
-    // 1. 尝试 accept 新连接
-    // 2. 如果是 HTTP GET，发送 index.html
-    // 3. 如果是 WebSocket Upgrade，完成握手并加入 clients_ 列表
+    // 核心轮询函数：accept 所有等待中的连接，设为非阻塞后交给事件循环监听 (fd_watcher)
+    // 请求头到齐后 (read_client 读到) 再路由：
+    // 1. 如果是 HTTP GET，发送 index.html / jmuxer.min.js 后关闭
+    // 2. 如果是 WebSocket Upgrade，握手应答发完后加入 clients_ 列表
+    // 读请求、写应答都不阻塞，连上却不发请求的客户端超时后由 expire_pending 关闭
     void handle_new_connections();
 
-    // 广播二进制数据给所有已连接的 WebSocket 客户端
-    void broadcast(uint8_t* data, int len);
+    // 关闭超过 PENDING_TIMEOUT_US 仍未完成请求/应答的连接 (事件循环定时调用)
+    void expire_pending();
+    // 是否有未完成握手的连接 (有则事件循环需要定时醒来清理)
+    bool has_pending() const { return !pending_.empty(); }
+
+    // 广播一帧视频数据给所有已连接的 WebSocket 客户端
+    // 数据封装成一个 WebSocket 帧放入每个客户端的发送队列 (各客户端共享同一份)，能写多少立即写多少，
+    // 剩余部分在 socket 可写时继续发送。keyframe 表示该包含 IDR，积压过多的客户端从这里重新开始
+    // 帧头与负载用一次 sendmsg 发出；负载较大且内核支持时用 MSG_ZEROCOPY，内核直接引用这份内存
+    // owner 保证 data 有效：所有客户端发完 (零拷贝完成) 之前一直持有，期间 data 不得修改
+    void broadcast(std::shared_ptr<const void> owner, const uint8_t* data, size_t len, bool keyframe);
+    // 同上，拷贝一份数据
+    void broadcast(const uint8_t* data, int len, bool keyframe);
+
+    // socket 可写或有错误队列通知时调用 (事件循环报告 EPOLLOUT / EPOLLERR)：
+    // 回收零拷贝完成通知，继续发送该客户端的队列 (握手未完成的连接继续发送 HTTP 应答)
+    void flush_client(int client_fd);
+
+    // 所有客户端丢弃尚未开始发送的视频帧，等下一个关键帧再继续 (上游丢过包、解码参考已断时调用)
+    void resync_all();
+
+    // 码流参数集 (SPS/PPS)：新客户端在第一个关键帧之前先收到这一份，即使关键帧本身不带参数集也能解码
+    // owner 保证 data 有效，参数集变化时重新设置
+    void set_stream_headers(std::shared_ptr<const void> owner, const uint8_t* data, size_t len);
 
+    // 新客户端握手完成时调用，请求编码器尽快输出关键帧 (不必等 GOP 结束)
+    void set_keyframe_requester(std::function<void()> requester) { keyframe_requester_ = std::move(requester); }
+
+    // 首帧耗时：握手完成 -> 第一个关键帧完整写入 socket
+    const LatencyHistogram& first_frame_latency() const { return first_frame_latency_; }
+
+    // 发送统计
+    struct SendStats {
+        uint64_t sent_frames;     // 完整发出的帧数
+        uint64_t dropped_frames;  // 因积压丢弃的视频帧数
+        uint64_t resyncs;         // 进入"等关键帧"状态的次数
+        size_t queued_bytes;      // 所有客户端队列中尚未发送的字节 (共享数据按客户端重复计)
+        size_t max_client_bytes;  // 积压最多的客户端
+        uint64_t zerocopy_sends;  // MSG_ZEROCOPY 发送次数
+        uint64_t zerocopy_copied; // 其中内核回退为拷贝的次数 (如 loopback、网卡不支持 SG)
+        size_t zerocopy_inflight; // 等待完成通知的发送次数
+    };
+    SendStats send_stats() const;
+
+    // 收到一条完整的文本/二进制消息 (data 只在回调期间有效)
+    typedef std::function<void(const uint8_t* data, size_t size)> MessageHandler;
+
+    // 轮询所有客户端，返回收到的消息 (拷贝；事件循环请用 read_client)
     std::vector<std::vector<uint8_t>> process_client_messages();
 
+    // 读取单个客户端 (事件循环报告该 fd 可读时调用；握手未完成的连接在这里继续读请求头)
+    // 读到 EAGAIN 或本次读取上限为止，解析出的每条完整消息依次交给 on_message；
+    // ping 回复 pong，close 或协议错误时回复 close 并关闭连接
+    void read_client(int client_fd, const MessageHandler& on_message);
+
     // 获取当前连接的客户端数量
     int GetClientNumber();
 
+    // 监听 socket (非阻塞，可读表示有新连接)
+    int listen_fd() const { return server_fd_; }
+
+    // 客户端 fd 增删通知 (added 为 false 时在 close 之前调用)，供事件循环同步监听
+    void set_fd_watcher(std::function<void(int fd, bool added)> watcher) { fd_watcher_ = std::move(watcher); }
+
+    // 客户端是否需要可写通知 (发送队列非空时为 true)，供事件循环增删 EPOLLOUT
+    void set_write_watcher(std::function<void(int fd, bool want)> watcher) { write_watcher_ = std::move(watcher); }
+
+    // 发送队列限制
+    static const size_t MAX_QUEUED_FRAMES = 64;          // 每个客户端的队列槽位 (环形)
+    static const size_t BACKLOG_FRAMES = 30;             // 积压超过这么多帧 (约 1 秒) 即丢帧等关键帧
+    static const size_t BACKLOG_BYTES = 512 * 1024;      // 或积压超过这么多字节
+    static const size_t CLIENT_MAX_BYTES = 2 * 1024 * 1024;  // 单个客户端的队列上限
+    static const size_t GLOBAL_MAX_BYTES = 8 * 1024 * 1024;  // 所有客户端队列合计上限
+
+    // 负载不小于此值时用 MSG_ZEROCOPY (更小的包锁页与完成通知的开销超过拷贝)
+    static const size_t ZEROCOPY_MIN_BYTES = 16 * 1024;
+    // 连续这么多次完成通知都报告内核回退为拷贝，则该客户端不再尝试零拷贝
+    static const unsigned ZEROCOPY_COPIED_LIMIT = 8;
+
+    // 未完成握手的连接：请求头上限、同时存在的数量上限 (超过的新连接直接关闭)、超时
+    static const size_t MAX_REQUEST_BYTES = 8192;
+    static const size_t MAX_PENDING = 32;
+    static const int64_t PENDING_TIMEOUT_US = 5000000;
+
 private:
     int server_fd_;
+    // 一个 WebSocket 帧 (帧头 + 负载)，创建后只读，视频帧由所有客户端共享同一份
+    // 零拷贝发送时内核直接引用帧头与负载的内存，完成通知到达前必须保持有效且不被修改
+    struct WireFrame {
+        uint8_t header[10];
+        size_t header_len;
+        std::shared_ptr<const void> owner; // 负载的持有者 (编码数据包或 vector)
+        const uint8_t* payload;
+        size_t payload_size;
+        bool keyframe;  // 含 IDR 的视频帧
+        bool control;   // 控制帧 (pong/close) 与码流参数集，不参与丢帧
+        size_t size() const { return header_len + payload_size; }
+    };
+    typedef std::shared_ptr<const WireFrame> WireFramePtr;
+
+    // 发送队列中的一项
+    struct OutFrame {
+        WireFramePtr frame;
+        size_t offset;  // 已发送的字节数 (>0 表示已开始发送，不能再丢弃)
+    };
+
+    // 等待完成通知的零拷贝发送 (id 为该 socket 上零拷贝发送的序号)
+    struct ZeroCopyRef {
+        uint32_t id;
+        WireFramePtr frame;
+    };
+
+    // 每个客户端的状态
+    struct Session {
+        WsFrameParser parser;
+        std::vector<OutFrame> ring;  // 发送队列 (MAX_QUEUED_FRAMES 个槽位的环形缓冲)
+        size_t head;
+        size_t count;
+        size_t queued_bytes;         // 队列中尚未发送的字节
+        bool waiting_idr;            // 积压过多：丢弃视频帧直到下一个关键帧
+        bool want_write;             // 已请求可写通知
+        bool needs_headers;          // 还没收到过关键帧：先补发参数集
+        int64_t join_us;             // 握手完成时刻 (首帧发完后清零)
+        bool zerocopy;               // 已开启 SO_ZEROCOPY 且未因回退拷贝而停用
+        bool zerocopy_capable;       // 曾开启 SO_ZEROCOPY (需要回收错误队列中的通知)
+        uint32_t zc_next_id;         // 下一次零拷贝发送的序号
+        unsigned zc_copied_run;      // 连续回退为拷贝的通知数
+        std::deque<ZeroCopyRef> zc_inflight;
+    };
+
+    // 尚未完成 HTTP 请求/应答的连接 (请求头可能分几次到达、应答可能分几次写出)
+    struct PendingConn {
+        std::string request;    // 已收到的请求头
+        std::string reply;      // 待发送的应答 (101 握手或静态文件，非空表示已路由)
+        size_t sent;
+        bool upgrade;           // 应答发完后转为 WebSocket 客户端
+        bool loopback;          // 对端是本机 (不开零拷贝)
+        bool want_write;        // 已请求可写通知
+        int64_t accept_us;      // 接入时刻 (超时清理)
+    };
+
     std::vector<int> clients_; // 存储所有 WebSocket 客户端的 socket fd
+    std::unordered_map<int, PendingConn> pending_;
+    std::unordered_map<int, Session> sessions_;
+    std::function<void(int, bool)> fd_watcher_;
+    std::function<void(int, bool)> write_watcher_;
+    std::function<void()> keyframe_requester_;
+    WireFramePtr stream_headers_;
+    LatencyHistogram first_frame_latency_;
+
+    size_t total_queued_bytes_;
+    uint64_t sent_frames_;
+    uint64_t dropped_frames_;
+    uint64_t resyncs_;
+    uint64_t zerocopy_sends_;
+    uint64_t zerocopy_copied_;
+
+    // 一次 sendmsg 最多合并的 iovec 数 (每帧帧头、负载各一项)
+    static const int MAX_IOV = 32;
+
+    // 每次 recv 的大小与单次 read_client 的读取上限 (超过的留到下一轮，避免一个客户端占住事件循环)
+    static const size_t RECV_CHUNK = 16384;
+    static const size_t MAX_READ_PER_EVENT = 256 * 1024;
+
+    // 接入一个等待中的连接 (没有等待的连接返回 false)
+    bool accept_client();
+
+    // 关闭客户端并通知监听方，返回下一个元素
+    std::vector<int>::iterator close_client(std::vector<int>::iterator it);
+
+    // 读取未完成握手连接的请求头，到齐后路由
+    void read_pending(int client_fd, PendingConn& p);
+    // 按请求生成应答 (101 握手或静态文件) 并开始发送；不认识的请求直接关闭
+    void route_request(int client_fd, PendingConn& p);
+    // 继续发送应答 (短写时等可写)，发完后升级为 WebSocket 客户端或关闭 HTTP 短连接
+    void flush_pending(int client_fd, PendingConn& p);
+    void close_pending(int client_fd);
+    // 握手完成：建立发送队列，加入 clients_
+    void promote_client(int client_fd, bool loopback);
+
+    // 控制帧 (pong / close，负载不超过 125 字节) 排入发送队列，保证不会插进正在发送的视频帧中间
+    void queue_control(int client_fd, Session& s, uint8_t opcode, const uint8_t* payload, size_t len);
+
+    // 视频帧排入发送队列，按积压情况决定是否丢弃
+    void queue_video(Session& s, const WireFramePtr& frame);
+
+    // 入队 (队列满返回 false)
+    bool push_frame(Session& s, const WireFramePtr& frame);
+
+    // 丢弃尚未开始发送的视频帧并进入"等关键帧"状态，返回释放的字节数
+    size_t start_resync(Session& s);
+
+    // 合计积压超过 GLOBAL_MAX_BYTES 时，从积压最多的客户端开始丢帧
+    void enforce_global_cap();
+
+    // 尽量发送队列中的数据 (非阻塞，短写时留到可写时继续)，连接出错返回 false
+    // 小帧合并成一次 sendmsg；大负载单独一次 sendmsg，可用时带 MSG_ZEROCOPY
+    bool flush(int client_fd, Session& s);
+
+    // 按队列顺序填充 iovec，返回项数；zerocopy 返回本批是否应使用零拷贝
+    int gather(Session& s, struct iovec* iov, bool allow_zerocopy, bool& zerocopy);
+
+    // 发送了 n 字节：推进队首各帧的偏移，移出已发完的帧 (第一个视频帧发完时记录首帧耗时)
+    void consume(int client_fd, Session& s, size_t n);
+
+    // 开启 socket 的 SO_ZEROCOPY (内核或头文件不支持时返回 false)
+    static bool enable_zerocopy(int client_fd);
+
+    // 读取错误队列中的零拷贝完成通知，释放对应帧的引用
+    void reap_zerocopy(int client_fd, Session& s);
+
+    // 回复 close (status 为关闭码) 后关闭客户端
+    void reject_client(int client_fd, uint16_t status);
 
-    // 辅助函数：WebSocket 握手逻辑
-    bool do_handshake(int client_fd, char* request_buffer);
+    // 辅助函数：WebSocket 握手逻辑 (生成 101 应答，请求无效返回 false)
+    bool do_handshake(const char* request_buffer, std::string& response);
     
     // 辅助函数：Base64 编码 (用于握手验证)
     char* base64_encode(const unsigned char* input, int length);
@@ -0,0 +1,167 @@
+#include "drv_wsparser.h"
+#include <cstring>
+
+// 接收缓冲的初始大小 (大多数键鼠消息只有几字节，一个缓冲能容纳一整批)
+static const size_t INITIAL_BUFFER = 4096;
+
+WsFrameParser::WsFrameParser(size_t maxMessage)
+    : m_maxMessage(maxMessage), m_in(INITIAL_BUFFER), m_head(0), m_tail(0),
+      m_inFragment(false), m_fragOpcode(0),
+      m_error(nullptr), m_errorCode(0), m_frames(0), m_messages(0)
+{
+}
+
+void WsFrameParser::reset()
+{
+    m_head = m_tail = 0;
+    m_fragments.clear();
+    m_inFragment = false;
+    m_fragOpcode = 0;
+    m_error = nullptr;
+    m_errorCode = 0;
+}
+
+uint8_t *WsFrameParser::prepare(size_t n)
+{
+    if (m_tail + n > m_in.size()) {
+        // 先把未解析的数据挪到开头，仍不够再扩容
+        if (m_head > 0) {
+            size_t remain = m_tail - m_head;
+            if (remain > 0) memmove(m_in.data(), m_in.data() + m_head, remain);
+            m_head = 0;
+            m_tail = remain;
+        }
+        if (m_tail + n > m_in.size()) {
+            size_t cap = m_in.size() * 2;
+            if (cap < m_tail + n) cap = m_tail + n;
+            m_in.resize(cap);
+        }
+    }
+    return m_in.data() + m_tail;
+}
+
+void WsFrameParser::commit(size_t n)
+{
+    m_tail += n;
+    if (m_tail > m_in.size()) m_tail = m_in.size();
+}
+
+void WsFrameParser::feed(const uint8_t *data, size_t len)
+{
+    memcpy(prepare(len), data, len);
+    commit(len);
+}
+
+void WsFrameParser::unmask(uint8_t *data, size_t len, const uint8_t key[4])
+{
+    // 8 字节一组异或 (掩码按字节序重复两次，与对齐无关)
+    uint8_t key8[8] = {key[0], key[1], key[2], key[3], key[0], key[1], key[2], key[3]};
+    uint64_t k;
+    memcpy(&k, key8, sizeof(k));
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        v ^= k;
+        memcpy(data + i, &v, sizeof(v));
+    }
+    for (; i < len; ++i) {
+        data[i] ^= key[i & 3];
+    }
+}
+
+bool WsFrameParser::fail(const char *reason, uint16_t code)
+{
+    m_error = reason;
+    m_errorCode = code;
+    return false;
+}
+
+bool WsFrameParser::next(Message &msg)
+{
+    while (!m_error) {
+        size_t avail = m_tail - m_head;
+        if (avail < 2) return false;
+
+        uint8_t *p = m_in.data() + m_head;
+        bool fin = (p[0] & 0x80) != 0;
+        uint8_t opcode = p[0] & 0x0F;
+        bool masked = (p[1] & 0x80) != 0;
+        uint64_t len = p[1] & 0x7F;
+
+        if (p[0] & 0x70) return fail("reserved bits set");
+        // 客户端发来的帧必须加掩码 (RFC 6455 5.1)
+        if (!masked) return fail("unmasked client frame");
+
+        size_t hdr = 2;
+        if (len == 126) {
+            if (avail < 4) return false;
+            len = ((uint64_t)p[2] << 8) | p[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (avail < 10) return false;
+            len = 0;
+            for (int i = 0; i < 8; ++i) len = (len << 8) | p[2 + i];
+            if (len >> 63) return fail("invalid 64-bit length");
+            hdr = 10;
+        }
+
+        bool control = (opcode & 0x08) != 0;
+        if (control) {
+            if (!fin) return fail("fragmented control frame");
+            if (len > 125) return fail("control frame too long");
+            if (opcode != OP_CLOSE && opcode != OP_PING && opcode != OP_PONG) return fail("unknown control opcode");
+        } else if (opcode != OP_CONTINUATION && opcode != OP_TEXT && opcode != OP_BINARY) {
+            return fail("unknown data opcode");
+        }
+
+        // 超过上限时不等数据收齐就报错，避免为恶意长度扩容
+        size_t already = (opcode == OP_CONTINUATION) ? m_fragments.size() : 0;
+        if (!control && len > m_maxMessage - already) return fail("message too large", 1009);
+
+        const uint8_t *key = p + hdr;
+        hdr += 4;
+        if (avail < hdr + len) return false;
+
+        uint8_t *payload = p + hdr;
+        unmask(payload, (size_t)len, key);
+        m_head += hdr + (size_t)len;
+        m_frames++;
+
+        if (control) {
+            msg.opcode = opcode;
+            msg.data = payload;
+            msg.size = (size_t)len;
+            m_messages++;
+            return true;
+        }
+
+        if (opcode == OP_CONTINUATION) {
+            if (!m_inFragment) return fail("continuation without start");
+            m_fragments.insert(m_fragments.end(), payload, payload + len);
+            if (!fin) continue;
+            m_inFragment = false;
+            msg.opcode = m_fragOpcode;
+            msg.data = m_fragments.data();
+            msg.size = m_fragments.size();
+            m_messages++;
+            return true;
+        }
+
+        // TEXT / BINARY
+        if (m_inFragment) return fail("new message inside fragmented message");
+        if (fin) {
+            // 单帧消息：直接返回接收缓冲中的数据，不拷贝
+            msg.opcode = opcode;
+            msg.data = payload;
+            msg.size = (size_t)len;
+            m_messages++;
+            return true;
+        }
+        m_inFragment = true;
+        m_fragOpcode = opcode;
+        m_fragments.assign(payload, payload + len);
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef DRV_WSPARSER_H
+#define DRV_WSPARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// WebSocket 帧流式解析器 (服务端方向：解析浏览器发来的帧，每个客户端一份)
+// - 增量解析：一次 recv 可以包含多帧、半帧，帧可以跨多次 recv
+// - 支持 7/16/64 位长度、分片消息重组 (分片之间可以插入控制帧)、ping/pong/close
+// - 零分配：接收缓冲即解码区，完整的单帧消息直接在接收缓冲中原地去掩码后返回指针；
+//   只有分片消息拷贝到重组区。两块缓冲都只增不减，稳定后不再分配内存
+// - 协议错误 (未加掩码、保留位、控制帧过长/分片、消息超过上限等) 后停止解析，
+//   调用方应关闭连接
+// 纯 C++ 实现，不依赖 Qt (Tool/wsbench 直接编译本文件做吞吐测试)
+class WsFrameParser
+{
+public:
+    enum Opcode {
+        OP_CONTINUATION = 0x0,
+        OP_TEXT         = 0x1,
+        OP_BINARY       = 0x2,
+        OP_CLOSE        = 0x8,
+        OP_PING         = 0x9,
+        OP_PONG         = 0xA
+    };
+
+    // 一条完整消息：数据消息为重组后的全部内容，控制帧为其负载
+    struct Message {
+        uint8_t opcode;
+        const uint8_t *data;
+        size_t size;
+    };
+
+    static const size_t kDefaultMaxMessage = 1 << 20; // 单条消息上限 1MB
+
+    explicit WsFrameParser(size_t maxMessage = kDefaultMaxMessage);
+
+    // 接收：prepare 返回至少 n 字节的可写空间，直接 recv 进去后 commit 实际字节数
+    uint8_t *prepare(size_t n);
+    void commit(size_t n);
+    // 拷贝写入 (= prepare + memcpy + commit)
+    void feed(const uint8_t *data, size_t len);
+
+    // 取下一条完整消息；数据不完整或已出错返回 false
+    // msg.data 在下一次调用 next/prepare/feed 之前有效
+    bool next(Message &msg);
+
+    bool hasError() const { return m_error != nullptr; }
+    const char *error() const { return m_error; }
+    // 出错时应回复的关闭码：1009 消息过大，1002 其他协议错误
+    uint16_t closeCode() const { return m_errorCode; }
+
+    // 丢弃所有缓冲与状态 (保留已分配的内存)
+    void reset();
+
+    // 已接收但尚未解析的字节数
+    size_t buffered() const { return m_tail - m_head; }
+    // 统计：解析出的帧数 / 消息数
+    uint64_t frameCount() const { return m_frames; }
+    uint64_t messageCount() const { return m_messages; }
+
+    // 按 4 字节掩码对 data 原地异或 (掩码从 key[0] 开始)
+    static void unmask(uint8_t *data, size_t len, const uint8_t key[4]);
+
+private:
+    bool fail(const char *reason, uint16_t code = 1002);
+
+    size_t m_maxMessage;
+    std::vector<uint8_t> m_in;   // 接收缓冲，[m_head, m_tail) 为未解析数据
+    size_t m_head;
+    size_t m_tail;
+
+    std::vector<uint8_t> m_fragments; // 分片消息重组区
+    bool m_inFragment;
+    uint8_t m_fragOpcode;
+
+    const char *m_error;
+    uint16_t m_errorCode;
+    uint64_t m_frames;
+    uint64_t m_messages;
+};
+
+#endif // DRV_WSPARSER_H
@@ -75,6 +75,23 @@ void ui_display::startSerialLogic()
         // 数据：COM3
         cmb_hid_UartSelect->addItem(label, info.portName());
     }
+    // 额外串口 (QSerialPortInfo 不会列出伪终端)：PADSKVM_EXTRA_SERIAL=/tmp/ttyCH9329[:...]
+    // 用于连接 Tool/ch9329emu 模拟器
+    QStringList extraPorts = QString::fromLocal8Bit(qgetenv("PADSKVM_EXTRA_SERIAL")).split(':');
+    extraPorts.removeAll(QString()); // 不用已弃用的 QString::SkipEmptyParts
+    for (const QString &port : extraPorts) {
+        cmb_hid_UartSelect->addItem(port + " (模拟器)", port);
+    }
+    // USB gadget 后端：本机已通过 configfs 创建 /dev/hidgN 时列出；
+    // PADSKVM_HID_GADGET=键盘,相对鼠标[,绝对鼠标] 可指定其他节点 (普通文件/FIFO 用于无硬件调试)
+    const QString gadget = HidGadgetDriver::detectGadget();
+    if (!gadget.isEmpty()) {
+        cmb_hid_UartSelect->addItem("USB Gadget (" + gadget.mid(7) + ")", gadget);
+    }
+    const QString gadgetEnv = QString::fromLocal8Bit(qgetenv("PADSKVM_HID_GADGET"));
+    if (!gadgetEnv.isEmpty()) {
+        cmb_hid_UartSelect->addItem("USB Gadget (" + gadgetEnv + ")", "gadget:" + gadgetEnv);
+    }
     // 默认选中第一个
     if (cmb_hid_UartSelect->count() > 0) {
         cmb_hid_UartSelect->setCurrentIndex(0);
@@ -95,6 +112,12 @@ void ui_display::startSerialLogic()
     cmb_hid_DevSelect->clear();
     cmb_hid_DevSelect->addItem("CH9329");
     cmb_hid_DevSelect->setCurrentIndex(0);
+
+    // 4. 发送线程调度：实时 (SCHED_FIFO) 需要 root 或 CAP_SYS_NICE，失败时保持普通调度
+    cmb_hid_PrioSelect->clear();
+    cmb_hid_PrioSelect->addItem("普通", false);
+    cmb_hid_PrioSelect->addItem("实时", true);
+    cmb_hid_PrioSelect->setCurrentIndex(0);
 }
 
 //参数更改逻辑
@@ -112,6 +135,7 @@ void ui_display::on_btn_hid_SetApply_clicked()
 
     // 2. 通过处理类尝试连接
     bool isConnected = m_HidManager->initDriver(portName, baudRate);
+    m_HidManager->setRealtimePriority(cmb_hid_PrioSelect->currentData().toBool());
 
     // 3. 更新单选框使能状态
     rbt_hid_AbsMode->setEnabled(isConnected);
@@ -120,7 +144,8 @@ void ui_display::on_btn_hid_SetApply_clicked()
     // 4. 根据结果更新 UI 和 逻辑状态
     if (isConnected) {
         // === 成功逻辑 ===
-        lbl_vid_HIDStatus->setText("通信成功");
+        int linkBaud = m_HidManager->linkBaudRate();
+        lbl_vid_HIDStatus->setText(QString("通信成功 (%1)").arg(linkBaud > 0 ? QString::number(linkBaud) : QString("USB")));
         lbl_vid_HIDStatus->setStyleSheet("QLabel { background-color: transparent; color: #00CC00; border: none; padding: 0px; font-size: 11pt; }");// 绿色高亮
 
         // 连接成功后，默认进入绝对坐标模式
@@ -167,6 +192,19 @@ void ui_display::startCameraLogic()
 
         // 连接信号并启动线程
         connect(m_VideoManager, &VideoController::frameReady, this, &ui_display::handleFrame);
+        // 信号源切换分辨率后，同步 HID 坐标映射
+        connect(m_VideoManager, &VideoController::sourceChanged, this, [this](QSize size){
+            if (m_HidManager && lbl_ui_VideoShow) {
+                m_HidManager->setSourceResolution(size, lbl_ui_VideoShow->size());
+            }
+        });
+        // 网页端批量输入文本
+        connect(m_VideoManager, &VideoController::remoteTextReceived, this,
+                [this](QString text, QString layout, int intervalMs, bool verify){
+            if (m_HidManager) {
+                m_HidManager->typeText(text, layout, intervalMs, verify);
+            }
+        });
         m_VideoManager->start(); // 启动循环，但此时 m_pause 为 true，线程会 wait
 
         // ========== 修改后的初始化选中逻辑 ====================================================
@@ -230,15 +268,21 @@ void ui_display::handleFrame(QImage image)
 {
     if (image.isNull() || !lbl_ui_VideoShow) return;
 
-    // 1. 获取 Label 尺寸
+    // 1. 获取 Label 尺寸，并告知采集线程 (下一帧起按此尺寸转换)
     QSize labelSize = lbl_ui_VideoShow->size();
+    m_VideoManager->setDisplaySize(labelSize);
+
+    // 2. 采集线程已按显示尺寸输出时直接显示；
+    //    仅在尺寸不符 (窗口刚缩放 / 源比控件小需要放大) 时才在 UI 线程缩放
+    //    允许 1 像素的取整误差，避免无意义的重缩放
+    QSize fitSize = image.size().scaled(labelSize, Qt::KeepAspectRatio);
+    if (qAbs(fitSize.width() - image.width()) > 1 || qAbs(fitSize.height() - image.height()) > 1) {
+        // 使用 Qt::FastTransformation 保证预览流畅度，若需画质可改用 Qt::SmoothTransformation
+        image = image.scaled(labelSize, Qt::KeepAspectRatio, Qt::FastTransformation);
+    }
 
-    // 2. 先在 CPU 中缩放 QImage (效率更高)
-    // 使用 Qt::FastTransformation 保证预览流畅度，若需画质可改用 Qt::SmoothTransformation
-    QImage scaledImg = image.scaled(labelSize, Qt::KeepAspectRatio, Qt::FastTransformation);
-
-    // 3. 仅转换缩放后的图像到 Pixmap
-    lbl_ui_VideoShow->setPixmap(QPixmap::fromImage(scaledImg));
+    // 3. 转换到 Pixmap (RGB32 为原生格式，无需再做像素格式转换)
+    lbl_ui_VideoShow->setPixmap(QPixmap::fromImage(image));
 }
 
 //应用视频修改
@@ -256,7 +300,9 @@ void ui_display::on_btn_vid_SetApply_clicked()
         }
     }
 
-    // 直接调用 updateSettings，线程内部会自动暂停、重配、重启
+    // 先更新缓冲策略，再调用 updateSettings，线程内部会自动暂停、重配、重启
+    m_VideoManager->setBufferPolicy(cmb_vid_BufSelect->currentData().toInt(),
+                                    cmb_vid_ModeSelect->currentData().toBool());
     m_VideoManager->updateSettings(sz.width(), sz.height(), fmt, fps);
 
     // 同步通知 HID 控制器源分辨率已变更
@@ -616,8 +662,18 @@ void ui_display::initSideBar()
     cmb_vid_FmtSelect = new ElaComboBox(grpVideo);
     cmb_vid_ResSelect = new ElaComboBox(grpVideo);
     cmb_vid_FpsSelect = new ElaComboBox(grpVideo);
+    cmb_vid_BufSelect = new ElaComboBox(grpVideo);
+    cmb_vid_ModeSelect = new ElaComboBox(grpVideo);
     btn_vid_SetApply = new ElaPushButton("应用视频修改", grpVideo);
 
+    // 缓冲策略：缓冲多更平滑，仅最新帧延迟更低
+    updateComboBox<int>(cmb_vid_BufSelect, {2, 3, 4, 6, 8}, [](const int& n){
+        return QString("%1 帧").arg(n);
+    });
+    cmb_vid_BufSelect->setCurrentIndex(cmb_vid_BufSelect->findData((int)CameraDevice::DEFAULT_BUFFER_COUNT));
+    cmb_vid_ModeSelect->addItem("顺序 (平滑)", false);
+    cmb_vid_ModeSelect->addItem("最新 (低延迟)", true);
+
     connect(cmb_vid_FmtSelect, QOverload<int>::of(&ElaComboBox::currentIndexChanged), this, &ui_display::on_cmb_vid_FmtSelect_currentIndexChanged);
     connect(cmb_vid_ResSelect, QOverload<int>::of(&ElaComboBox::currentIndexChanged), this, &ui_display::on_cmb_vid_ResSelect_currentIndexChanged);
     connect(btn_vid_SetApply, &ElaPushButton::clicked, this, &ui_display::on_btn_vid_SetApply_clicked);
@@ -625,6 +681,8 @@ void ui_display::initSideBar()
     addSideSettingItem(vBox, "格式:", cmb_vid_FmtSelect);
     addSideSettingItem(vBox, "分辨率:", cmb_vid_ResSelect);
     addSideSettingItem(vBox, "帧率:", cmb_vid_FpsSelect);
+    addSideSettingItem(vBox, "缓冲:", cmb_vid_BufSelect);
+    addSideSettingItem(vBox, "出帧:", cmb_vid_ModeSelect);
     vBox->addWidget(btn_vid_SetApply);
 
     // --- 2. HID 设置 Group ---
@@ -634,6 +692,7 @@ void ui_display::initSideBar()
     cmb_hid_UartSelect = new ElaComboBox(grpHid);
     cmb_hid_BtrSelect = new ElaComboBox(grpHid);
     cmb_hid_DevSelect = new ElaComboBox(grpHid);
+    cmb_hid_PrioSelect = new ElaComboBox(grpHid);
     btn_hid_SetApply = new ElaPushButton("应用HID修改", grpHid);
 
     connect(btn_hid_SetApply, &ElaPushButton::clicked, this, &ui_display::on_btn_hid_SetApply_clicked);
@@ -641,6 +700,7 @@ void ui_display::initSideBar()
     addSideSettingItem(hBox, "串口选择:", cmb_hid_UartSelect);
     addSideSettingItem(hBox, "波特率:", cmb_hid_BtrSelect);
     addSideSettingItem(hBox, "设备选择:", cmb_hid_DevSelect);
+    addSideSettingItem(hBox, "发送调度:", cmb_hid_PrioSelect);
     hBox->addWidget(btn_hid_SetApply);
 
     // --- 3. IP-KVM Group ---
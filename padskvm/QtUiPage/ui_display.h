@@ -126,12 +126,15 @@ private:
     ElaComboBox *cmb_vid_FmtSelect;
     ElaComboBox *cmb_vid_ResSelect;
     ElaComboBox *cmb_vid_FpsSelect;
+    ElaComboBox *cmb_vid_BufSelect;   // 缓冲区数量
+    ElaComboBox *cmb_vid_ModeSelect;  // 出帧模式 (顺序 / 仅最新)
     ElaPushButton *btn_vid_SetApply;
 
     // 3.2 HID设置
     ElaComboBox *cmb_hid_UartSelect;
     ElaComboBox *cmb_hid_BtrSelect;
     ElaComboBox *cmb_hid_DevSelect;
+    ElaComboBox *cmb_hid_PrioSelect;  // HID I/O 线程调度 (普通 / 实时)
     ElaPushButton *btn_hid_SetApply;
 
     // 3.3 IP-KVM 设置
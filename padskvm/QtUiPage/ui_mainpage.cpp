@@ -281,10 +281,11 @@ void ui_mainpage::on_btnOpenSerialHID_clicked()
     QString SERSTAT= "启用失败";QString SERCOL= "red";
     QString HIDSTAT= "通信失败";QString HIDCOL= "red";
 
-    // 2. 转换为const char*（本地编码）并传入init
-    if(tempDriver.init(fullPortPath.toLocal8Bit().constData(), 9600)){
+    // 2. 用上次协商成功的波特率测试，不通再探测常用波特率 (只测试，不修改芯片参数)
+    int baud = CH9329Driver::savedBaudRate(fullPortPath, 9600);
+    if(tempDriver.init(fullPortPath.toLocal8Bit().constData(), baud)){
         SERSTAT="启用成功";SERCOL= "green";
-        if(tempDriver.checkConnection()) {
+        if(tempDriver.checkConnection() || tempDriver.probeBaudRate(CH9329Driver::standardBaudRates()) > 0) {
             HIDSTAT="通信成功";HIDCOL= "green";
         }
     }
@@ -0,0 +1,243 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// 队列满时的丢弃策略
+enum class DropPolicy {
+    DropNewest, // 拒绝新元素 (保留积压，适合不能乱序/跳帧的数据)
+    DropOldest  // 挤掉最旧元素 (保留最新，适合实时视频)
+};
+
+// 队列统计快照 (单位：us)
+struct QueueStats {
+    uint64_t pushed = 0;     // 成功入队数
+    uint64_t popped = 0;     // 消费者取出数
+    uint64_t dropped = 0;    // 按策略丢弃数
+    size_t   size = 0;       // 当前占用
+    size_t   highWater = 0;  // 历史最大占用
+    int64_t  lastWaitUs = 0; // 最近一个元素在队列中等待的时间
+    int64_t  avgWaitUs = 0;  // 等待时间 EWMA (1/16)
+    int64_t  maxWaitUs = 0;  // 最大等待时间
+};
+
+// 有界无锁队列 (Vyukov 环形队列，多生产者/多消费者安全)
+// - 固定容量，构造后不再分配内存；元素只移动不拷贝 (可存放 FrameLease 这类只能移动的对象)
+// - push/pop 无锁；只有消费者在队列为空需要睡眠时才使用互斥量 (waitPop)
+// - DropOldest 时生产者会代替消费者弹出最旧元素，因此依赖 MPMC 安全性
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity, DropPolicy policy = DropPolicy::DropOldest)
+        : m_capacity(capacity < 2 ? 2 : capacity),  // 算法要求至少 2 个槽位
+          m_cells(new Cell[m_capacity]),
+          m_policy(policy)
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    size_t capacity() const { return m_capacity; }
+
+    void setDropPolicy(DropPolicy policy) { m_policy.store(policy, std::memory_order_relaxed); }
+    DropPolicy dropPolicy() const { return m_policy.load(std::memory_order_relaxed); }
+
+    // 入队。返回 false 表示新元素按 DropNewest 策略被丢弃
+    bool push(T &&item)
+    {
+        while (!tryPush(item)) {
+            if (m_policy.load(std::memory_order_relaxed) == DropPolicy::DropNewest) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // DropOldest：弹出最旧的一个再重试 (被弹出的元素在此析构)
+            T oldest;
+            if (tryPop(oldest, nullptr)) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+        updateHighWater();
+        wakeConsumer();
+        return true;
+    }
+
+    // 非阻塞出队
+    bool pop(T &out)
+    {
+        int64_t waitUs = 0;
+        if (!tryPop(out, &waitUs)) return false;
+        recordPop(waitUs);
+        return true;
+    }
+
+    // 阻塞出队，最多等待 timeoutMs 毫秒
+    bool waitPop(T &out, int timeoutMs)
+    {
+        if (pop(out)) return true;
+        {
+            QMutexLocker locker(&m_waitMutex);
+            m_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (empty()) {
+                m_waitCond.wait(&m_waitMutex, timeoutMs);
+            }
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+        return pop(out);
+    }
+
+    // 丢弃全部积压 (不计入 dropped)
+    void clear()
+    {
+        T item;
+        while (tryPop(item, nullptr)) {
+            item = T();
+        }
+    }
+
+    size_t size() const
+    {
+        size_t enq = m_enqueuePos.load(std::memory_order_acquire);
+        size_t deq = m_dequeuePos.load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    QueueStats stats() const
+    {
+        QueueStats s;
+        s.pushed = m_pushed.load(std::memory_order_relaxed);
+        s.popped = m_popped.load(std::memory_order_relaxed);
+        s.dropped = m_dropped.load(std::memory_order_relaxed);
+        s.size = size();
+        s.highWater = m_highWater.load(std::memory_order_relaxed);
+        s.lastWaitUs = m_lastWaitUs.load(std::memory_order_relaxed);
+        s.avgWaitUs = m_avgWaitUs.load(std::memory_order_relaxed);
+        s.maxWaitUs = m_maxWaitUs.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        int64_t enqueueUs = 0;
+        T data;
+    };
+
+    static int64_t nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 成功时 item 被移走；队列满时 item 保持不变
+    bool tryPush(T &item)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos % m_capacity];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // 满
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->enqueueUs = nowUs();
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &out, int64_t *waitUs)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos % m_capacity];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // 空
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->data);
+        cell->data = T(); // 立即释放槽位持有的资源 (如帧租约)
+        if (waitUs) *waitUs = nowUs() - cell->enqueueUs;
+        cell->seq.store(pos + m_capacity, std::memory_order_release);
+        return true;
+    }
+
+    void recordPop(int64_t waitUs)
+    {
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+        m_lastWaitUs.store(waitUs, std::memory_order_relaxed);
+        int64_t avg = m_avgWaitUs.load(std::memory_order_relaxed);
+        m_avgWaitUs.store(avg + (waitUs - avg) / 16, std::memory_order_relaxed);
+        int64_t maxv = m_maxWaitUs.load(std::memory_order_relaxed);
+        while (waitUs > maxv && !m_maxWaitUs.compare_exchange_weak(maxv, waitUs, std::memory_order_relaxed)) {}
+    }
+
+    void updateHighWater()
+    {
+        size_t cur = size();
+        size_t hw = m_highWater.load(std::memory_order_relaxed);
+        while (cur > hw && !m_highWater.compare_exchange_weak(hw, cur, std::memory_order_relaxed)) {}
+    }
+
+    void wakeConsumer()
+    {
+        // 与 waitPop 中 "置 sleeping -> 检查 empty" 配对，保证不会丢失唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            QMutexLocker locker(&m_waitMutex);
+            m_waitCond.wakeAll();
+        }
+    }
+
+private:
+    const size_t m_capacity;
+    std::unique_ptr<Cell[]> m_cells;
+    std::atomic<DropPolicy> m_policy;
+
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) std::atomic<size_t> m_dequeuePos{0};
+
+    // 统计
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<uint64_t> m_popped{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<size_t>   m_highWater{0};
+    std::atomic<int64_t>  m_lastWaitUs{0};
+    std::atomic<int64_t>  m_avgWaitUs{0};
+    std::atomic<int64_t>  m_maxWaitUs{0};
+
+    // 仅用于空队列时的睡眠/唤醒
+    std::atomic<bool> m_sleeping{false};
+    QMutex m_waitMutex;
+    QWaitCondition m_waitCond;
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,204 @@
+// 像素格式转换内核的逐位比对与测速
+// 1. 比对：本机可用的每套 SIMD 内核 (ColorConvert::available) 逐格式、逐宽度与标量参考实现逐字节比较，
+//    输入覆盖全 0 / 全 0xFF / 色度极值 / 伪随机，宽度覆盖向量主体与各种尾部长度
+// 2. 测速：每套内核按格式转换整帧 (默认 1920x1080)，输出 MPix/s；另测一次融合转换 + 缩放 (Scaler)
+//
+// 用法：ccbench [-w 宽] [-h 高] [-n 轮数]
+// 比对失败时返回 1
+
+#include "colorconvert.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+using namespace ColorConvert;
+
+struct Options {
+    int width = 1920;
+    int height = 1080;
+    int rounds = 100;
+};
+
+struct FormatInfo {
+    SourceFormat fmt;
+    const char *name;
+    int bytesPerPixel;
+};
+
+const FormatInfo kFormats[] = {
+    { SRC_YUYV,   "YUYV",   2 },
+    { SRC_UYVY,   "UYVY",   2 },
+    { SRC_RGB565, "RGB565", 2 },
+};
+
+// 生成一行测试输入 (pattern 0~3：全 0 / 全 0xFF / 色度极值交替 / 伪随机)
+void fillRow(std::vector<uint8_t> &row, int pattern, uint32_t &seed)
+{
+    for (size_t i = 0; i < row.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        switch (pattern) {
+        case 0:  row[i] = 0x00; break;
+        case 1:  row[i] = 0xFF; break;
+        case 2:  row[i] = (i & 1) ? ((i & 2) ? 0x00 : 0xFF) : (uint8_t)(seed >> 24); break;
+        default: row[i] = (uint8_t)(seed >> 24); break;
+        }
+    }
+}
+
+// 逐位比对一套内核，返回不一致的 (格式, 宽度) 组合数
+int verifyKernels(const Kernels &k)
+{
+    const Kernels &ref = reference();
+    int failures = 0;
+    uint32_t seed = 0x9E3779B9u;
+
+    for (const FormatInfo &f : kFormats) {
+        bool ok = true;
+        // 2..130 覆盖所有尾部长度 (内核每次处理 8/16 像素)，再加常见的整行宽度
+        std::vector<int> widths;
+        for (int w = 2; w <= 130; w += 2) widths.push_back(w);
+        widths.push_back(640);
+        widths.push_back(1366);
+        widths.push_back(1920);
+        widths.push_back(3840);
+
+        for (int width : widths) {
+            std::vector<uint8_t> src((size_t)width * f.bytesPerPixel);
+            // 输出前后各留一个哨兵，检查内核没有越界写
+            std::vector<uint32_t> want(width + 2, 0xDEADBEEFu), got(width + 2, 0xDEADBEEFu);
+            for (int pattern = 0; pattern < 4; ++pattern) {
+                int reps = (pattern == 3) ? 16 : 1;
+                for (int rep = 0; rep < reps; ++rep) {
+                    fillRow(src, pattern, seed);
+                    ref.row(f.fmt)(src.data(), want.data() + 1, width);
+                    k.row(f.fmt)(src.data(), got.data() + 1, width);
+                    if (memcmp(want.data(), got.data(), want.size() * sizeof(uint32_t)) == 0) continue;
+
+                    for (int x = 0; x < width + 2; ++x) {
+                        if (want[x] == got[x]) continue;
+                        fprintf(stderr, "[CCBENCH] %s %s width=%d pattern=%d: pixel %d = %08x, reference %08x\n",
+                                k.name, f.name, width, pattern, x - 1, got[x], want[x]);
+                        break;
+                    }
+                    ok = false;
+                    failures++;
+                    break;
+                }
+                if (!ok) break;
+            }
+            if (!ok) break;
+        }
+        printf("verify %-9s %-6s %s\n", k.name, f.name, ok ? "OK" : "MISMATCH");
+    }
+    return failures;
+}
+
+double elapsed(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// 整帧转换测速，返回 MPix/s
+double benchFrame(const Kernels &k, const FormatInfo &f, const Options &opt,
+                  const std::vector<uint8_t> &src, std::vector<uint32_t> &dst)
+{
+    RowFunc row = k.row(f.fmt);
+    int srcStride = opt.width * f.bytesPerPixel;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < opt.rounds; ++r) {
+        for (int y = 0; y < opt.height; ++y) {
+            row(src.data() + (size_t)y * srcStride, dst.data() + (size_t)y * opt.width, opt.width);
+        }
+    }
+    double seconds = elapsed(t0);
+    return (double)opt.width * opt.height * opt.rounds / seconds / 1e6;
+}
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -w <width>  测速帧宽 (默认 1920，必须为偶数)\n"
+            "  -h <height> 测速帧高 (默认 1080)\n"
+            "  -n <rounds> 每个组合转换的帧数 (默认 100)\n",
+            prog);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "w:h:n:")) != -1) {
+        switch (c) {
+        case 'w': opt.width = atoi(optarg); break;
+        case 'h': opt.height = atoi(optarg); break;
+        case 'n': opt.rounds = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (opt.width <= 0 || (opt.width & 1) || opt.height <= 0 || opt.rounds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<const Kernels *> kernels = available();
+
+    // 1. 逐位比对
+    int failures = 0;
+    for (const Kernels *k : kernels) {
+        if (k == &reference()) continue;
+        failures += verifyKernels(*k);
+    }
+
+    // 2. 整帧测速
+    std::vector<uint8_t> src((size_t)opt.width * opt.height * 2);
+    uint32_t seed = 20260115u;
+    for (uint8_t &b : src) {
+        seed = seed * 1664525u + 1013904223u;
+        b = (uint8_t)(seed >> 24);
+    }
+    std::vector<uint32_t> dst((size_t)opt.width * opt.height);
+
+    printf("\nconvert %dx%d, %d frames (MPix/s)\n", opt.width, opt.height, opt.rounds);
+    printf("%-9s", "");
+    for (const FormatInfo &f : kFormats) printf(" %10s", f.name);
+    printf("\n");
+    for (const Kernels *k : kernels) {
+        printf("%-9s", k->name);
+        for (const FormatInfo &f : kFormats) printf(" %10.1f", benchFrame(*k, f, opt, src, dst));
+        printf("\n");
+    }
+
+    // 3. 融合转换 + 缩放 (使用 active() 选出的内核，目标为源的一半)
+    Scaler scaler;
+    int dstWidth = opt.width / 2, dstHeight = opt.height / 2;
+    if (dstWidth > 0 && dstHeight > 0) {
+        std::vector<uint32_t> small((size_t)dstWidth * dstHeight);
+        printf("\nscale %dx%d -> %dx%d with %s (MPix/s of output)\n",
+               opt.width, opt.height, dstWidth, dstHeight, active().name);
+        for (const FormatInfo &f : kFormats) {
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r < opt.rounds; ++r) {
+                scaler.convert(f.fmt, src.data(), opt.width * f.bytesPerPixel, opt.width, opt.height,
+                               (uint8_t *)small.data(), dstWidth * 4, dstWidth, dstHeight);
+            }
+            printf("%-9s %10.1f\n", f.name, (double)dstWidth * dstHeight * opt.rounds / elapsed(t0) / 1e6);
+        }
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "[CCBENCH] %d mismatch(es) against the reference kernels\n", failures);
+        return 1;
+    }
+    return 0;
+}
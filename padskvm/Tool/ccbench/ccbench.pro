@@ -0,0 +1,16 @@
+# 像素格式转换内核的逐位比对与测速 (独立小工具，只依赖 QtCore)
+# 编译：mkdir build-ccbench && cd build-ccbench && qmake ../Tool/ccbench/ccbench.pro && make
+
+TEMPLATE = app
+TARGET   = ccbench
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS_RELEASE += -O2
+
+INCLUDEPATH += ../../Tool
+
+SOURCES += ccbench.cpp                  \
+           ../../Tool/colorconvert.cpp
@@ -0,0 +1,454 @@
+// CH9329 串口-HID 芯片模拟器
+// 创建一个伪终端 (PTY)，在从端上按 CH9329 协议应答，padskvm 把从端当作串口打开即可，
+// 无需真实硬件即可调试 HID 链路、测试 HidController 的吞吐与延迟。
+//
+// 支持的指令：GET_INFO / 键盘 / 绝对鼠标 / 相对鼠标 / 读写参数配置 / 复位
+// 可选：按波特率模拟线路传输时间、附加处理延迟、注入校验和错误与丢包
+//
+// 用法：ch9329emu [-l 链接路径] [-b 波特率] [-t] [-d 延迟us] [-e 错误率] [-x 丢包率] [-q]
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// CH9329 协议常量 (与 Driver/drv_ch9329.cpp 保持一致)
+const uint8_t HEAD_0 = 0x57;
+const uint8_t HEAD_1 = 0xAB;
+
+const uint8_t CMD_GET_INFO = 0x01;
+const uint8_t CMD_SEND_KB_GENERAL_DATA = 0x02;
+const uint8_t CMD_SEND_MS_ABS_DATA = 0x04;
+const uint8_t CMD_SEND_MS_REL_DATA = 0x05;
+const uint8_t CMD_GET_PARA_CFG = 0x08;
+const uint8_t CMD_SET_PARA_CFG = 0x09;
+const uint8_t CMD_RESET = 0x0F;
+
+const uint8_t REPLY_OK_FLAG = 0x80;
+const uint8_t REPLY_ERR_FLAG = 0xC0;
+
+const uint8_t STATUS_SUCCESS = 0x00;
+const uint8_t STATUS_ERR_CMD = 0xE3;
+const uint8_t STATUS_ERR_SUM = 0xE4;
+const uint8_t STATUS_ERR_PARA = 0xE5;
+
+const int CFG_SIZE = 50;
+const int CFG_OFF_BAUD = 3;
+
+// 运行参数
+struct Options {
+    std::string linkPath;     // 为从端创建的符号链接 (可选)
+    int baud = 9600;          // 芯片初始波特率 (写入参数配置)
+    bool airtime = false;     // 是否按波特率模拟线路传输时间
+    int64_t latencyUs = 0;    // 芯片处理延迟
+    double errorRate = 0;     // 按此概率回复校验和错误 (0xE4)
+    double dropRate = 0;      // 按此概率不回复
+    bool quiet = false;       // 不逐包打印
+};
+
+// 统计
+struct Counters {
+    uint64_t frames = 0;
+    uint64_t keyboard = 0;
+    uint64_t mouseAbs = 0;
+    uint64_t mouseRel = 0;
+    uint64_t other = 0;
+    uint64_t badChecksum = 0;
+    uint64_t injectedErrors = 0;
+    uint64_t dropped = 0;
+};
+
+volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int)
+{
+    g_stop = 1;
+}
+
+int64_t nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void sleepUntilUs(int64_t deadline)
+{
+    int64_t wait = deadline - nowUs();
+    if (wait <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = wait / 1000000;
+    ts.tv_nsec = (wait % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR && !g_stop) {}
+}
+
+class Emulator
+{
+public:
+    explicit Emulator(const Options &opt)
+        : m_opt(opt), m_cfg(CFG_SIZE, 0), m_baud(opt.baud),
+          m_rxBusyUntil(0), m_txBusyUntil(0), m_rng(std::random_device()())
+    {
+        // 出厂默认参数：工作模式 0x80、串口模式 0x80、地址 0x00、包间隔 3ms
+        m_cfg[0] = 0x80;
+        m_cfg[1] = 0x80;
+        m_cfg[2] = 0x00;
+        setCfgBaud(opt.baud);
+        m_cfg[10] = 0x03;
+    }
+
+    // 处理从端写来的数据，逐帧应答
+    void feed(int fd, const uint8_t *data, size_t len)
+    {
+        m_rx.insert(m_rx.end(), data, data + len);
+        int64_t arrival = nowUs();
+
+        for (;;) {
+            // 1. 找帧头
+            size_t start = 0;
+            while (start + 1 < m_rx.size() && !(m_rx[start] == HEAD_0 && m_rx[start + 1] == HEAD_1)) ++start;
+            if (start > 0) m_rx.erase(m_rx.begin(), m_rx.begin() + start);
+
+            // 2. 头(2) + 地址(1) + 命令(1) + 长度(1) + 数据(len) + 校验(1)
+            if (m_rx.size() < 5) return;
+            size_t total = 5 + m_rx[4] + 1;
+            if (m_rx.size() < total) return;
+
+            std::vector<uint8_t> frame(m_rx.begin(), m_rx.begin() + total);
+            m_rx.erase(m_rx.begin(), m_rx.begin() + total);
+            handleFrame(fd, frame, arrival);
+        }
+    }
+
+    void printStats(const char *tag) const
+    {
+        fprintf(stderr, "[EMU] %s frames=%llu kb=%llu abs=%llu rel=%llu other=%llu badsum=%llu "
+                        "injected=%llu dropped=%llu\n",
+                tag, (unsigned long long)m_count.frames, (unsigned long long)m_count.keyboard,
+                (unsigned long long)m_count.mouseAbs, (unsigned long long)m_count.mouseRel,
+                (unsigned long long)m_count.other, (unsigned long long)m_count.badChecksum,
+                (unsigned long long)m_count.injectedErrors, (unsigned long long)m_count.dropped);
+    }
+
+    const Counters &counters() const { return m_count; }
+
+private:
+    // 8N1：每字节 10bit
+    int64_t airtimeUs(size_t bytes) const
+    {
+        if (!m_opt.airtime || m_baud <= 0) return 0;
+        return (int64_t)bytes * 10 * 1000000 / m_baud;
+    }
+
+    void setCfgBaud(int baud)
+    {
+        m_cfg[CFG_OFF_BAUD + 0] = (uint8_t)((baud >> 24) & 0xFF);
+        m_cfg[CFG_OFF_BAUD + 1] = (uint8_t)((baud >> 16) & 0xFF);
+        m_cfg[CFG_OFF_BAUD + 2] = (uint8_t)((baud >> 8) & 0xFF);
+        m_cfg[CFG_OFF_BAUD + 3] = (uint8_t)(baud & 0xFF);
+    }
+
+    int cfgBaud() const
+    {
+        return (m_cfg[CFG_OFF_BAUD] << 24) | (m_cfg[CFG_OFF_BAUD + 1] << 16) |
+               (m_cfg[CFG_OFF_BAUD + 2] << 8) | m_cfg[CFG_OFF_BAUD + 3];
+    }
+
+    bool roll(double rate)
+    {
+        if (rate <= 0) return false;
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        return dist(m_rng) < rate;
+    }
+
+    void handleFrame(int fd, const std::vector<uint8_t> &frame, int64_t arrival)
+    {
+        m_count.frames++;
+        uint8_t cmd = frame[3];
+        uint8_t len = frame[4];
+        const uint8_t *data = frame.data() + 5;
+
+        // 接收完成时刻：线路上按顺序逐帧到达
+        int64_t rxDone = (arrival > m_rxBusyUntil ? arrival : m_rxBusyUntil) + airtimeUs(frame.size());
+        m_rxBusyUntil = rxDone;
+        int64_t ready = rxDone + m_opt.latencyUs;
+
+        uint8_t sum = 0;
+        for (size_t i = 0; i + 1 < frame.size(); ++i) sum += frame[i];
+        if (sum != frame.back()) {
+            m_count.badChecksum++;
+            if (!m_opt.quiet) fprintf(stderr, "[EMU] cmd=0x%02X checksum error\n", cmd);
+            reply(fd, cmd | REPLY_ERR_FLAG, std::vector<uint8_t>(1, STATUS_ERR_SUM), ready);
+            return;
+        }
+        if (roll(m_opt.dropRate)) {
+            m_count.dropped++;
+            return;
+        }
+        if (roll(m_opt.errorRate)) {
+            m_count.injectedErrors++;
+            reply(fd, cmd | REPLY_ERR_FLAG, std::vector<uint8_t>(1, STATUS_ERR_SUM), ready);
+            return;
+        }
+
+        std::vector<uint8_t> status(1, STATUS_SUCCESS);
+        switch (cmd) {
+        case CMD_GET_INFO: {
+            // 版本号、USB 枚举状态、键盘指示灯状态、保留
+            std::vector<uint8_t> info(8, 0x00);
+            info[0] = 0x30;
+            info[1] = 0x01;
+            m_count.other++;
+            reply(fd, cmd | REPLY_OK_FLAG, info, ready);
+            return;
+        }
+        case CMD_SEND_KB_GENERAL_DATA:
+            m_count.keyboard++;
+            if (len != 8) break;
+            if (!m_opt.quiet) logKeyboard(data);
+            reply(fd, cmd | REPLY_OK_FLAG, status, ready);
+            return;
+        case CMD_SEND_MS_ABS_DATA:
+            m_count.mouseAbs++;
+            if (len != 7) break;
+            if (!m_opt.quiet) {
+                fprintf(stdout, "ABS x=%d y=%d btn=0x%02X wheel=%d\n",
+                        data[2] | (data[3] << 8), data[4] | (data[5] << 8), data[1], (int8_t)data[6]);
+            }
+            reply(fd, cmd | REPLY_OK_FLAG, status, ready);
+            return;
+        case CMD_SEND_MS_REL_DATA:
+            m_count.mouseRel++;
+            if (len != 5) break;
+            if (!m_opt.quiet) {
+                fprintf(stdout, "REL dx=%d dy=%d btn=0x%02X wheel=%d\n",
+                        (int8_t)data[2], (int8_t)data[3], data[1], (int8_t)data[4]);
+            }
+            reply(fd, cmd | REPLY_OK_FLAG, status, ready);
+            return;
+        case CMD_GET_PARA_CFG:
+            m_count.other++;
+            reply(fd, cmd | REPLY_OK_FLAG, m_cfg, ready);
+            return;
+        case CMD_SET_PARA_CFG:
+            m_count.other++;
+            if (len != CFG_SIZE) break;
+            m_cfg.assign(data, data + len);
+            fprintf(stderr, "[EMU] Parameter config written, baud=%d (after reset)\n", cfgBaud());
+            reply(fd, cmd | REPLY_OK_FLAG, status, ready);
+            return;
+        case CMD_RESET:
+            m_count.other++;
+            reply(fd, cmd | REPLY_OK_FLAG, status, ready);
+            // 新参数复位后生效
+            m_baud = cfgBaud();
+            fprintf(stderr, "[EMU] Reset, baud=%d\n", m_baud);
+            return;
+        default:
+            m_count.other++;
+            reply(fd, cmd | REPLY_ERR_FLAG, std::vector<uint8_t>(1, STATUS_ERR_CMD), ready);
+            return;
+        }
+
+        // 长度不符
+        reply(fd, cmd | REPLY_ERR_FLAG, std::vector<uint8_t>(1, STATUS_ERR_PARA), ready);
+    }
+
+    void reply(int fd, uint8_t cmd, const std::vector<uint8_t> &data, int64_t ready)
+    {
+        std::vector<uint8_t> packet;
+        packet.reserve(data.size() + 6);
+        packet.push_back(HEAD_0);
+        packet.push_back(HEAD_1);
+        packet.push_back(0x00);
+        packet.push_back(cmd);
+        packet.push_back((uint8_t)data.size());
+        packet.insert(packet.end(), data.begin(), data.end());
+        uint8_t sum = 0;
+        for (uint8_t b : packet) sum += b;
+        packet.push_back(sum);
+
+        // 发送线路按顺序占用，应答在传输完成后才到达主机
+        int64_t txStart = ready > m_txBusyUntil ? ready : m_txBusyUntil;
+        m_txBusyUntil = txStart + airtimeUs(packet.size());
+        sleepUntilUs(m_txBusyUntil);
+
+        size_t off = 0;
+        while (off < packet.size()) {
+            ssize_t n = write(fd, packet.data() + off, packet.size() - off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) { usleep(100); continue; }
+                return;
+            }
+            off += (size_t)n;
+        }
+    }
+
+    void logKeyboard(const uint8_t *data)
+    {
+        static const char *modNames[8] = {"LCtrl", "LShift", "LAlt", "LGui", "RCtrl", "RShift", "RAlt", "RGui"};
+        std::string line = "KB mod=";
+        bool any = false;
+        for (int i = 0; i < 8; ++i) {
+            if (!(data[0] & (1 << i))) continue;
+            if (any) line += "+";
+            line += modNames[i];
+            any = true;
+        }
+        if (!any) line += "-";
+        line += " keys=";
+        char buf[8];
+        any = false;
+        for (int i = 2; i < 8; ++i) {
+            if (data[i] == 0) continue;
+            snprintf(buf, sizeof(buf), "%s0x%02X", any ? "," : "", data[i]);
+            line += buf;
+            any = true;
+        }
+        if (!any) line += "-";
+        fprintf(stdout, "%s\n", line.c_str());
+    }
+
+    Options m_opt;
+    std::vector<uint8_t> m_cfg;
+    int m_baud;                 // 当前生效的波特率 (复位后更新)
+    int64_t m_rxBusyUntil;      // 主机 -> 芯片 线路空闲时刻
+    int64_t m_txBusyUntil;      // 芯片 -> 主机 线路空闲时刻
+    std::vector<uint8_t> m_rx;
+    Counters m_count;
+    std::mt19937 m_rng;
+};
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -l <path>   为 PTY 从端创建符号链接 (例如 /tmp/ttyCH9329)\n"
+            "  -b <baud>   芯片初始波特率 (默认 9600)\n"
+            "  -t          按波特率模拟线路传输时间 (8N1)\n"
+            "  -d <us>     芯片处理延迟\n"
+            "  -e <rate>   按概率回复校验和错误 0xE4 (0~1)\n"
+            "  -x <rate>   按概率不回复 (0~1)\n"
+            "  -q          不逐包打印，只输出统计\n",
+            prog);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "l:b:td:e:x:qh")) != -1) {
+        switch (c) {
+        case 'l': opt.linkPath = optarg; break;
+        case 'b': opt.baud = atoi(optarg); break;
+        case 't': opt.airtime = true; break;
+        case 'd': opt.latencyUs = atoll(optarg); break;
+        case 'e': opt.errorRate = atof(optarg); break;
+        case 'x': opt.dropRate = atof(optarg); break;
+        case 'q': opt.quiet = true; break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 1;
+        }
+    }
+    if (opt.baud <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // 1. 创建 PTY
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("[EMU] posix_openpt");
+        return 1;
+    }
+    const char *slaveName = ptsname(master);
+    if (!slaveName) {
+        perror("[EMU] ptsname");
+        return 1;
+    }
+    std::string slavePath = slaveName;
+
+    // 2. 本进程也打开一次从端并设为原始模式：
+    //    不回显、不做行处理；客户端关闭串口后主端也不会读到 EIO
+    int slave = open(slavePath.c_str(), O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("[EMU] open slave");
+        return 1;
+    }
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    if (!opt.linkPath.empty()) {
+        unlink(opt.linkPath.c_str());
+        if (symlink(slavePath.c_str(), opt.linkPath.c_str()) != 0) {
+            perror("[EMU] symlink");
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    fprintf(stderr, "[EMU] CH9329 emulator on %s%s%s (baud=%d airtime=%s latency=%lldus)\n",
+            slavePath.c_str(), opt.linkPath.empty() ? "" : " -> ", opt.linkPath.c_str(),
+            opt.baud, opt.airtime ? "on" : "off", (long long)opt.latencyUs);
+
+    // 3. 主循环：读主端、逐帧应答；有流量时每秒输出一次速率
+    Emulator emu(opt);
+    uint8_t buf[512];
+    uint64_t lastFrames = 0;
+    int64_t lastReport = nowUs();
+    while (!g_stop) {
+        struct pollfd pfd = {master, POLLIN, 0};
+        int ret = poll(&pfd, 1, 1000);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            perror("[EMU] poll");
+            break;
+        }
+        if (ret > 0 && (pfd.revents & POLLIN)) {
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                perror("[EMU] read");
+                break;
+            }
+            emu.feed(master, buf, (size_t)n);
+        }
+
+        int64_t now = nowUs();
+        if (now - lastReport >= 1000000) {
+            uint64_t frames = emu.counters().frames;
+            if (frames != lastFrames) {
+                char tag[32];
+                snprintf(tag, sizeof(tag), "%.0f fps", (frames - lastFrames) * 1e6 / (now - lastReport));
+                emu.printStats(tag);
+            }
+            lastFrames = frames;
+            lastReport = now;
+        }
+    }
+
+    emu.printStats("total");
+    if (!opt.linkPath.empty()) unlink(opt.linkPath.c_str());
+    close(slave);
+    close(master);
+    return 0;
+}
@@ -0,0 +1,10 @@
+# CH9329 串口-HID 芯片模拟器 (独立小工具，不依赖 Qt 库)
+# 编译：mkdir build-emu && cd build-emu && qmake ../Tool/ch9329emu/ch9329emu.pro && make
+
+TEMPLATE = app
+TARGET   = ch9329emu
+
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+SOURCES += ch9329emu.cpp
@@ -0,0 +1,66 @@
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include <cstdint>
+#include <vector>
+
+// 像素格式转换内核：YUYV / UYVY / RGB565 -> RGB32 (QImage::Format_RGB32, 0xffRRGGBB)
+// - 每种格式都有一个标量参考实现 (reference)，SIMD 实现必须与其逐位一致
+// - SIMD 版本 (NEON / SSE2 / AVX2) 在首次使用时按 CPU 能力选择一次，之后不再判断
+// - YUV 统一按 BT.601 有限范围 (16-235) 定点公式转换，与编码器 (swscale) 的解释保持一致
+namespace ColorConvert {
+
+enum SourceFormat {
+    SRC_YUYV,   // Y0 U0 Y1 V0
+    SRC_UYVY,   // U0 Y0 V0 Y1
+    SRC_RGB565  // 16bit 小端
+};
+
+// 行转换函数：把一行 width 个像素的原始数据转换为 RGB32
+// width 必须为偶数 (YUV422 两个像素共享一组色度)
+using RowFunc = void (*)(const uint8_t *src, uint32_t *dst, int width);
+
+struct Kernels {
+    const char *name;
+    RowFunc yuyv;
+    RowFunc uyvy;
+    RowFunc rgb565;
+
+    RowFunc row(SourceFormat fmt) const;
+};
+
+// 标量参考实现 (逐位基准)
+const Kernels &reference();
+
+// 本机可用的全部实现 (编译进来且 CPU 支持的，参考实现在前、最快的在最后；不做比对)
+// 供 active() 选择，以及 Tool/ccbench 逐个比对与测速
+std::vector<const Kernels *> available();
+
+// 运行时选出的最快实现 (线程安全，仅初始化一次)
+// 初始化时会用一小块合成图像与参考实现比对，不一致则退回参考实现
+const Kernels &active();
+
+// 整帧转换
+// srcStride / dstStride 单位为字节
+void convert(SourceFormat fmt, const uint8_t *src, int srcStride,
+             uint8_t *dst, int dstStride, int width, int height);
+
+// 融合转换 + 最近邻缩放 (效果等同 Qt::FastTransformation)
+// 只转换被采样到的源行：每个目标行先用 SIMD 内核把对应源行转换进行缓存 (常驻 L1)，
+// 再按预计算的列映射表取样写入目标，不产生整帧全尺寸的 RGB 中间结果
+// 非线程安全：每个转换线程持有自己的实例 (内部缓存按尺寸复用，稳定后不再分配内存)
+class Scaler {
+public:
+    void convert(SourceFormat fmt, const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                 uint8_t *dst, int dstStride, int dstWidth, int dstHeight);
+
+private:
+    std::vector<uint32_t> m_row;  // 一行源像素的 RGB32 结果
+    std::vector<int> m_xmap;      // 目标列 -> 源列
+    int m_srcWidth = 0;
+    int m_dstWidth = 0;
+};
+
+} // namespace ColorConvert
+
+#endif // COLORCONVERT_H
@@ -0,0 +1,87 @@
+#include "encoded_packet.h"
+
+#include <atomic>
+#include <cstring>
+
+bool EncodedPacket::hasNal(uint8_t type) const
+{
+    for (const NalUnit &nal : m_nals) {
+        if (nal.type == type) return true;
+    }
+    return false;
+}
+
+void EncodedPacket::scanNals(const uint8_t *p, size_t n, std::vector<NalUnit> &out)
+{
+    out.clear();
+
+    // 找起始码 00 00 01 (4 字节的 00 00 00 01 同样以它结尾)，NAL 到下一个起始码为止
+    size_t start = 0;
+    bool open = false;
+    size_t i = 0;
+    while (i + 3 <= n) {
+        if (p[i + 2] > 1) {
+            i += 3;     // 第三个字节大于 1：起始码不可能从 i、i+1、i+2 开始
+        } else if (p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1) {
+            if (open) {
+                size_t end = i;
+                if (end > start && p[end - 1] == 0) end--; // 4 字节起始码的前导 0
+                NalUnit nal = {(uint32_t)start, (uint32_t)(end - start), (uint8_t)(p[start] & 0x1F)};
+                out.push_back(nal);
+            }
+            start = i + 3;
+            open = start < n;
+            i += 3;
+        } else {
+            i++;
+        }
+    }
+    if (open) {
+        NalUnit nal = {(uint32_t)start, (uint32_t)(n - start), (uint8_t)(p[start] & 0x1F)};
+        out.push_back(nal);
+    }
+}
+
+EncodedPacketPool::EncodedPacketPool(size_t maxPooled)
+    : m_maxPooled(maxPooled), m_cursor(0), m_allocated(0), m_reused(0)
+{
+    m_slots.reserve(maxPooled);
+}
+
+std::shared_ptr<EncodedPacket> EncodedPacketPool::acquire()
+{
+    size_t n = m_slots.size();
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = (m_cursor + k) % n;
+        // 只剩池自己的引用：其他线程都已释放，且不可能再拿到新引用
+        if (m_slots[i].use_count() == 1) {
+            // 与其他线程释放引用 (递减计数) 之前的读操作建立先后关系，之后才能改写内容
+            std::atomic_thread_fence(std::memory_order_acquire);
+            m_cursor = (i + 1) % n;
+            m_reused++;
+            return m_slots[i];
+        }
+    }
+
+    std::shared_ptr<EncodedPacket> packet = std::make_shared<EncodedPacket>();
+    m_allocated++;
+    if (n < m_maxPooled) {
+        m_slots.push_back(packet);
+    }
+    return packet;
+}
+
+EncodedPacketPtr EncodedPacketPool::publish(const uint8_t *data, size_t size, int64_t pts, bool keyframe, int64_t captureUs,
+                                            const ParameterSetsPtr &parameterSets)
+{
+    std::shared_ptr<EncodedPacket> packet = acquire();
+
+    // assign 在容量足够时不重新分配
+    packet->m_data.assign(data, data + size);
+    packet->m_pts = pts;
+    packet->m_keyframe = keyframe;
+    packet->m_captureUs = captureUs;
+    packet->m_parameterSets = parameterSets;
+    EncodedPacket::scanNals(packet->m_data.data(), packet->m_data.size(), packet->m_nals);
+    return packet;
+}
@@ -0,0 +1,92 @@
+#ifndef ENCODED_PACKET_H
+#define ENCODED_PACKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// H.264 Annex-B 数据包中的一个 NAL 单元 (offset/size 不含起始码)
+struct NalUnit {
+    uint32_t offset;
+    uint32_t size;
+    uint8_t type;     // nal_unit_type：1 非 IDR 片，5 IDR 片，6 SEI，7 SPS，8 PPS
+};
+
+// 码流参数集 (Annex-B 格式的 SPS + PPS，含起始码)，多个数据包共享同一份
+typedef std::shared_ptr<const std::vector<uint8_t>> ParameterSetsPtr;
+
+// 编码器输出的一个数据包
+// 发布后只读，以 EncodedPacketPtr 引用计数共享：网络发送队列、录像、转发等消费者各持一个引用，
+// 不再各自拷贝；所有消费者释放后由所属的池复用 (缓冲区与 NAL 表保留容量)
+class EncodedPacket
+{
+public:
+    EncodedPacket() : m_pts(0), m_keyframe(false), m_captureUs(0) {}
+
+    const uint8_t *data() const { return m_data.data(); }
+    size_t size() const { return m_data.size(); }
+
+    int64_t pts() const { return m_pts; }               // 编码器时间基 (帧序号)
+    bool keyframe() const { return m_keyframe; }        // 含 IDR
+    int64_t captureUs() const { return m_captureUs; }   // 对应原始帧的采集时间戳 (us, CLOCK_MONOTONIC，未知为 0)
+    const std::vector<NalUnit> &nals() const { return m_nals; }
+    // 解码本包所需的参数集 (编码器缓存的最新 SPS/PPS，未知为空)
+    const ParameterSetsPtr &parameterSets() const { return m_parameterSets; }
+
+    // 包含某类 NAL (如 7 = SPS)
+    bool hasNal(uint8_t type) const;
+
+    // 按 Annex-B 起始码切分 NAL 单元 (结果追加前先清空 out)
+    static void scanNals(const uint8_t *data, size_t size, std::vector<NalUnit> &out);
+
+private:
+    friend class EncodedPacketPool;
+
+    std::vector<uint8_t> m_data;
+    std::vector<NalUnit> m_nals;
+    ParameterSetsPtr m_parameterSets;
+    int64_t m_pts;
+    bool m_keyframe;
+    int64_t m_captureUs;
+};
+
+typedef std::shared_ptr<const EncodedPacket> EncodedPacketPtr;
+
+// 数据包对象池
+// - 池持有一组数据包 (make_shared 一次分配对象与引用计数)，发布时取一个只剩池自己引用的复用，
+//   稳定后每帧不再分配内存 (缓冲区按最大包长增长后保持)
+// - 消费者可在任意线程释放引用；publish 只能在一个线程 (编码线程) 调用
+// - 池可以先于数据包销毁，在外的包由最后一个引用释放
+class EncodedPacketPool
+{
+public:
+    explicit EncodedPacketPool(size_t maxPooled = kDefaultPooled);
+
+    EncodedPacketPool(const EncodedPacketPool &) = delete;
+    EncodedPacketPool &operator=(const EncodedPacketPool &) = delete;
+
+    // 拷贝编码器输出 (编码器的包在回调返回后即失效) 并发布为只读数据包
+    EncodedPacketPtr publish(const uint8_t *data, size_t size, int64_t pts, bool keyframe, int64_t captureUs,
+                             const ParameterSetsPtr &parameterSets = ParameterSetsPtr());
+
+    // 统计：新分配的对象数 / 复用次数
+    uint64_t allocated() const { return m_allocated; }
+    uint64_t reused() const { return m_reused; }
+
+    // 池中最多保留的对象数：网络队列 + 各客户端发送队列里同时存活的包数一般远小于此，
+    // 超出时 (消费者长时间持有) 临时分配、不入池
+    static const size_t kDefaultPooled = 128;
+
+private:
+    // 取一个可复用的对象 (没有则分配)
+    std::shared_ptr<EncodedPacket> acquire();
+
+    std::vector<std::shared_ptr<EncodedPacket>> m_slots;
+    size_t m_maxPooled;
+    size_t m_cursor;        // 下次从这里开始找空闲对象 (包大致按发布顺序释放)
+    uint64_t m_allocated;
+    uint64_t m_reused;
+};
+
+#endif // ENCODED_PACKET_H
@@ -0,0 +1,107 @@
+#include "event_reactor.h"
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventReactor::EventReactor()
+    : m_epfd(epoll_create1(EPOLL_CLOEXEC)),
+      m_wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_wakePending(false)
+{
+    if (!isValid()) {
+        qDebug() << "[Reactor] epoll/eventfd create failed:" << strerror(errno);
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakeFd;
+    epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+}
+
+EventReactor::~EventReactor()
+{
+    if (m_wakeFd >= 0) ::close(m_wakeFd);
+    if (m_epfd >= 0) ::close(m_epfd);
+}
+
+bool EventReactor::add(int fd, uint32_t events, Handler handler)
+{
+    if (m_epfd < 0 || fd < 0) return false;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    int op = isWatching(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(m_epfd, op, fd, &ev) < 0) {
+        qDebug() << "[Reactor] Watch fd" << fd << "failed:" << strerror(errno);
+        return false;
+    }
+    m_handlers[fd] = std::move(handler);
+    return true;
+}
+
+bool EventReactor::modify(int fd, uint32_t events)
+{
+    if (!isWatching(fd)) return false;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(m_epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventReactor::remove(int fd)
+{
+    if (m_handlers.erase(fd) == 0) return;
+    // fd 可能已被关闭 (内核已自动移除)，忽略错误
+    epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int EventReactor::runOnce(int timeoutMs)
+{
+    if (m_epfd < 0) return 0;
+
+    struct epoll_event events[kMaxEvents];
+    int n = epoll_wait(m_epfd, events, kMaxEvents, timeoutMs);
+    if (n < 0) {
+        if (errno != EINTR) qDebug() << "[Reactor] epoll_wait failed:" << strerror(errno);
+        return 0;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == m_wakeFd) {
+            // 先清标记再回调，回调期间的 wake() 会再次触发
+            // (全屏障保证清标记先于回调读取队列，与 wake() 中的屏障配对)
+            uint64_t value;
+            ssize_t ret = ::read(m_wakeFd, &value, sizeof(value));
+            (void)ret;
+            m_wakePending.store(false, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_wakeHandler) m_wakeHandler();
+            continue;
+        }
+        auto it = m_handlers.find(fd);
+        if (it == m_handlers.end()) continue; // 本轮中已被删除
+        // 拷贝一份：回调里可能删除自身
+        Handler handler = it->second;
+        handler(events[i].events);
+    }
+    return n;
+}
+
+void EventReactor::wake()
+{
+    if (m_wakeFd < 0) return;
+    // 调用方在此之前写入的数据 (如入队) 必须先于读标记，否则可能与回调中的取空交错而漏掉唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_wakePending.exchange(true, std::memory_order_acq_rel)) return;
+    uint64_t one = 1;
+    ssize_t ret = ::write(m_wakeFd, &one, sizeof(one));
+    (void)ret;
+}
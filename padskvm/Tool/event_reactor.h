@@ -0,0 +1,54 @@
+#ifndef EVENT_REACTOR_H
+#define EVENT_REACTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <sys/epoll.h>
+
+// epoll 事件循环 (单线程使用，wake() 除外)
+// - 登记 fd 与回调，runOnce() 等到任一 fd 就绪 / 被唤醒 / 超时后依次回调
+// - 水平触发：回调没读完的数据下一轮还会再报，回调每次只需处理一批
+// - 自带一个 eventfd：其他线程 wake() 后本线程立即醒来并调用唤醒回调，
+//   同一批未处理的唤醒只写一次 eventfd
+// 回调中可以增删 fd (包括自身)；已删除的 fd 在本轮剩余事件中被跳过
+class EventReactor
+{
+public:
+    typedef std::function<void(uint32_t events)> Handler;
+
+    EventReactor();
+    ~EventReactor();
+
+    EventReactor(const EventReactor &) = delete;
+    EventReactor &operator=(const EventReactor &) = delete;
+
+    bool isValid() const { return m_epfd >= 0 && m_wakeFd >= 0; }
+
+    // 登记 / 修改 / 删除监听 (events 为 EPOLLIN、EPOLLPRI 等组合)
+    bool add(int fd, uint32_t events, Handler handler);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+    bool isWatching(int fd) const { return m_handlers.count(fd) != 0; }
+
+    // 被 wake() 唤醒时调用 (在 runOnce 所在线程)
+    void setWakeHandler(std::function<void()> handler) { m_wakeHandler = std::move(handler); }
+
+    // 等待并分发一轮事件：timeoutMs < 0 表示一直等待；返回处理的事件数 (超时为 0)
+    int runOnce(int timeoutMs);
+
+    // 任意线程调用：唤醒 runOnce
+    void wake();
+
+private:
+    static const int kMaxEvents = 32;
+
+    int m_epfd;
+    int m_wakeFd;
+    std::atomic<bool> m_wakePending;
+    std::unordered_map<int, Handler> m_handlers;
+    std::function<void()> m_wakeHandler;
+};
+
+#endif // EVENT_REACTOR_H
@@ -0,0 +1,81 @@
+#!/bin/sh
+# 通过 configfs 创建 USB HID gadget：键盘 (hidg0)、相对鼠标 (hidg1)、绝对鼠标 (hidg2)
+# 报告格式与 Driver/drv_hidgadget.h 一致，需要 root，且内核开启 CONFIG_USB_CONFIGFS_F_HID
+#
+#   sudo ./hidg_setup.sh          创建并绑定到第一个 UDC
+#   sudo ./hidg_setup.sh stop     解绑并删除
+set -e
+
+G=/sys/kernel/config/usb_gadget/padskvm
+
+hex() {
+    # 把 "05 01 09 06 ..." 写成二进制报告描述符
+    # (POSIX printf 不支持 \x，转成八进制转义)
+    for b in $1; do printf "\\$(printf %o 0x$b)"; done
+}
+
+stop() {
+    [ -d $G ] || return 0
+    echo "" > $G/UDC 2>/dev/null || true
+    for f in $G/configs/c.1/hid.*; do [ -e "$f" ] && rm "$f"; done
+    rmdir $G/configs/c.1/strings/0x409 2>/dev/null || true
+    rmdir $G/configs/c.1 2>/dev/null || true
+    for f in $G/functions/hid.*; do [ -d "$f" ] && rmdir "$f"; done
+    rmdir $G/strings/0x409 2>/dev/null || true
+    rmdir $G
+}
+
+# name protocol subclass report_length descriptor
+func() {
+    mkdir -p $G/functions/hid.$1
+    echo $2 > $G/functions/hid.$1/protocol
+    echo $3 > $G/functions/hid.$1/subclass
+    echo $4 > $G/functions/hid.$1/report_length
+    hex "$5" > $G/functions/hid.$1/report_desc
+    ln -s $G/functions/hid.$1 $G/configs/c.1/
+}
+
+if [ "$1" = "stop" ]; then
+    stop
+    exit 0
+fi
+
+modprobe libcomposite 2>/dev/null || true
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+stop
+
+mkdir -p $G
+echo 0x1d6b > $G/idVendor       # Linux Foundation
+echo 0x0104 > $G/idProduct      # Multifunction Composite Gadget
+echo 0x0100 > $G/bcdDevice
+echo 0x0200 > $G/bcdUSB
+mkdir -p $G/strings/0x409
+echo "padskvm"           > $G/strings/0x409/manufacturer
+echo "padskvm HID"       > $G/strings/0x409/product
+echo "0123456789"        > $G/strings/0x409/serialnumber
+mkdir -p $G/configs/c.1/strings/0x409
+echo "HID"               > $G/configs/c.1/strings/0x409/configuration
+echo 100                 > $G/configs/c.1/MaxPower
+
+# 键盘 (boot 协议)：[修饰键, 保留, k1..k6]
+func kbd 1 1 8 "05 01 09 06 a1 01 05 07 19 e0 29 e7 15 00 25 01 75 01 95 08 81 02 \
+95 01 75 08 81 03 95 05 75 01 05 08 19 01 29 05 91 02 95 01 75 03 91 03 \
+95 06 75 08 15 00 25 65 05 07 19 00 29 65 81 00 c0"
+
+# 相对鼠标 (boot 协议)：[按键, dx, dy, 滚轮]
+func mouse 2 1 4 "05 01 09 02 a1 01 09 01 a1 00 05 09 19 01 29 03 15 00 25 01 \
+95 03 75 01 81 02 95 01 75 05 81 03 05 01 09 30 09 31 09 38 15 81 25 7f \
+75 08 95 03 81 06 c0 c0"
+
+# 绝对鼠标：[按键, xL, xH, yL, yH, 滚轮]，坐标 0 ~ 4095
+func abs 0 0 6 "05 01 09 02 a1 01 09 01 a1 00 05 09 19 01 29 03 15 00 25 01 \
+95 03 75 01 81 02 95 01 75 05 81 03 05 01 09 30 09 31 15 00 26 ff 0f \
+75 10 95 02 81 02 09 38 15 81 25 7f 75 08 95 01 81 06 c0 c0"
+
+UDC=$(ls /sys/class/udc | head -n 1)
+if [ -z "$UDC" ]; then
+    echo "no UDC found (OTG port not in peripheral mode?)" >&2
+    exit 1
+fi
+echo "$UDC" > $G/UDC
+echo "bound to $UDC: $(ls /dev/hidg* | tr '\n' ' ')"
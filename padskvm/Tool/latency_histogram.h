@@ -0,0 +1,113 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// 延迟直方图 (单位：us)
+// - 对数分桶：每个 2 的幂区间再均分 4 段，相对误差 < 25%，覆盖 0 ~ 约 134s
+// - 记录无锁 (relaxed 原子自增)，任意线程可写、可读；读取的是近似快照
+class LatencyHistogram {
+public:
+    static const int kSubBuckets = 4;
+    static const int kOctaves = 26;
+    static const int kBuckets = kOctaves * kSubBuckets;
+
+    LatencyHistogram() { reset(); }
+
+    // 单调时钟 (与各模块时间戳保持一致)
+    static int64_t nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void record(int64_t us)
+    {
+        if (us < 0) us = 0;
+        m_buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add((uint64_t)us, std::memory_order_relaxed);
+        int64_t maxv = m_max.load(std::memory_order_relaxed);
+        while (us > maxv && !m_max.compare_exchange_weak(maxv, us, std::memory_order_relaxed)) {}
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < kBuckets; ++i) m_buckets[i].store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    int64_t maxUs() const { return m_max.load(std::memory_order_relaxed); }
+    int64_t meanUs() const
+    {
+        uint64_t n = count();
+        return n ? (int64_t)(m_sum.load(std::memory_order_relaxed) / n) : 0;
+    }
+
+    // 百分位 (0~100)，返回所在桶的上界
+    int64_t percentileUs(double p) const
+    {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t target = (uint64_t)(p / 100.0 * (double)n + 0.5);
+        if (target == 0) target = 1;
+        uint64_t acc = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            acc += m_buckets[i].load(std::memory_order_relaxed);
+            if (acc >= target) {
+                int64_t upper = bucketUpper(i);
+                int64_t maxv = maxUs();
+                return upper < maxv ? upper : maxv;
+            }
+        }
+        return maxUs();
+    }
+
+    // "n=... mean=...us p50=...us p99=...us max=...us"
+    std::string summary() const
+    {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "n=%llu mean=%lldus p50=%lldus p99=%lldus max=%lldus",
+                 (unsigned long long)count(), (long long)meanUs(),
+                 (long long)percentileUs(50), (long long)percentileUs(99), (long long)maxUs());
+        return buf;
+    }
+
+private:
+    // 桶 i 覆盖 [lower(i), lower(i+1))；前 4 个桶对应 0..3us
+    static int bucketOf(int64_t us)
+    {
+        if (us < kSubBuckets) return (int)us;
+        int msb = 63 - __builtin_clzll((unsigned long long)us);   // >= 2
+        int sub = (int)((us >> (msb - 2)) & (kSubBuckets - 1));
+        int idx = (msb - 1) * kSubBuckets + sub;
+        return idx < kBuckets ? idx : kBuckets - 1;
+    }
+
+    static int64_t bucketLower(int i)
+    {
+        if (i < kSubBuckets) return i;
+        int msb = i / kSubBuckets + 1;
+        int sub = i % kSubBuckets;
+        return ((int64_t)(kSubBuckets + sub)) << (msb - 2);
+    }
+
+    static int64_t bucketUpper(int i)
+    {
+        return (i + 1 < kBuckets) ? bucketLower(i + 1) - 1 : INT64_MAX;
+    }
+
+    std::atomic<uint64_t> m_buckets[kBuckets];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<int64_t>  m_max;
+};
+
+#endif // LATENCY_HISTOGRAM_H
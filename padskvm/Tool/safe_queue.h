@@ -1,56 +1,143 @@
 #ifndef SAFE_QUEUE_H
 #define SAFE_QUEUE_H
 
-#include <queue>
-#include <QMutex>
-#include <QMutexLocker>
+#include <atomic>
 #include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "bounded_queue.h"
+#include "latency_histogram.h"
 
 // 定义通用指令结构体
 struct HidCommand {
     enum Type {
         CMD_MOUSE_ABS,  // 绝对鼠标
         CMD_MOUSE_REL,  // 相对鼠标
-        CMD_KEYBOARD    // 键盘
+        CMD_KEYBOARD,   // 键盘报告 (入队时表示该来源按住的完整集合，发往设备时为合并后的报告)
+        CMD_KEY         // 单键增量：param1 该来源当前的修饰键，param2 键码，param4 为 KeyAction
+    };
+
+    // CMD_KEY 的动作 (放在 param4)
+    enum KeyAction {
+        KEY_RELEASE,
+        KEY_PRESS
     };
 
     Type type;
     int param1; // x (abs/rel) or modifiers
-    int param2; // y (abs/rel) or keycode
-    int param3; // buttons
+    int param2; // y (abs/rel) or keycodes 0~3
+    int param3; // buttons     or keycodes 4~5
     int param4; // wheel
+    int64_t stampUs; // 入队时刻 (单调时钟，由 HidPacketQueue::push 填写，用于延迟统计)
+
+    // 输入来源 (延迟统计按来源分组)；聚合初始化省略时为 SRC_INTERNAL
+    enum Source {
+        SRC_INTERNAL,   // 程序生成 (定时动作、文本输入、自动松开)
+        SRC_LOCAL,      // 本地 Qt 事件
+        SRC_WEB,        // 网页 WebSocket
+        SRC_COUNT
+    };
+    int64_t eventUs; // 输入事件被解析成指令的时刻 (单调时钟，0 表示未标记，按入队时刻计)
+    int source;
+
+    // 标记来源与事件时刻 (在解析事件处调用，先于入队)
+    void markEvent(Source src, int64_t us) {
+        source = src;
+        eventUs = us;
+    }
+
+    // 键盘报告的 6 个键码按小端打包在 param2 (键 0~3) / param3 (键 4~5) 中，
+    // 只有一个键时 param2 就是该键码，与单键写法兼容
+    static const int kKeySlots = 6;
+
+    void setKeys(const uint8_t keys[kKeySlots]) {
+        param2 = (int)((uint32_t)keys[0] | ((uint32_t)keys[1] << 8) |
+                       ((uint32_t)keys[2] << 16) | ((uint32_t)keys[3] << 24));
+        param3 = keys[4] | (keys[5] << 8);
+    }
+
+    void getKeys(uint8_t keys[kKeySlots]) const {
+        for (int i = 0; i < 4; ++i) keys[i] = (uint8_t)((uint32_t)param2 >> (8 * i));
+        keys[4] = (uint8_t)param3;
+        keys[5] = (uint8_t)(param3 >> 8);
+    }
 };
 
+// HID 指令队列 (全局单例)
+// 生产者：GUI 线程 (本地键鼠)、网络阶段 (网页键鼠)；消费者：HID 发送逻辑
+// 底层为固定容量无锁环形队列，入队不加锁、不分配内存，不会与视频线程争锁
+// 溢出策略默认 DropNewest：积压时丢弃新指令，已排队的按序发出
+// (CH9329 键盘/鼠标包都是完整状态，后续任一指令即可纠正被丢弃的状态)
+// 唤醒：队列附带一个 eventfd，消费者用 QSocketNotifier/poll 监听，入队后立即被唤醒，
+// 无需定时轮询。同一批未消费的入队只写一次 eventfd
 class HidPacketQueue {
 public:
+    static const size_t kCapacity = 256;
+
     static HidPacketQueue* instance() {
         static HidPacketQueue _instance;
         return &_instance;
     }
 
-    void push(const HidCommand& cmd) {
-        QMutexLocker locker(&m_mutex);
-        m_queue.push(cmd);
+    // 返回 false 表示队列已满、指令按溢出策略被丢弃
+    bool push(const HidCommand& cmd) {
+        HidCommand copy = cmd;
+        copy.stampUs = LatencyHistogram::nowUs();
+        if (!m_ring.push(std::move(copy))) return false;
+        // 与 acknowledge() 中的屏障配对：入队必须先于读标记，否则消费者可能读到空队列、
+        // 这里却仍看到旧的 true 而不写 eventfd，指令 (可能是松开) 滞留到下一次输入
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 消费者尚未被通知过才写 eventfd，连续入队只产生一次系统调用
+        if (m_notifyFd >= 0 && !m_notified.exchange(true, std::memory_order_acq_rel)) {
+            uint64_t one = 1;
+            ssize_t ret = ::write(m_notifyFd, &one, sizeof(one));
+            (void)ret;
+        }
+        return true;
     }
 
     bool pop(HidCommand& cmd) {
-        QMutexLocker locker(&m_mutex);
-        if (m_queue.empty()) return false;
-        cmd = m_queue.front();
-        m_queue.pop();
-        return true;
+        return m_ring.pop(cmd);
+    }
+
+    // 可读即表示有新指令 (只读不写，由消费者监听)
+    int notifyFd() const { return m_notifyFd; }
+
+    // 消费者被唤醒后、开始 pop 之前调用：清除 eventfd 计数并重新允许通知
+    // 先清标记再 pop，保证之后的入队一定会再次唤醒
+    void acknowledge() {
+        uint64_t value;
+        ssize_t ret = ::read(m_notifyFd, &value, sizeof(value));
+        (void)ret;
+        m_notified.store(false, std::memory_order_relaxed);
+        // 清标记必须先于之后的 pop 读队列 (StoreLoad)，release 不保证，需要全屏障
+        std::atomic_thread_fence(std::memory_order_seq_cst);
     }
 
     // [新增] 清空队列（用于切换模式时防止积压）
     void clear() {
-        QMutexLocker locker(&m_mutex);
-        std::queue<HidCommand> empty;
-        std::swap(m_queue, empty);
+        m_ring.clear();
     }
 
+    // 溢出策略 (DropNewest: 丢新指令 / DropOldest: 挤掉最旧指令)
+    void setOverflowPolicy(DropPolicy policy) { m_ring.setDropPolicy(policy); }
+    DropPolicy overflowPolicy() const { return m_ring.dropPolicy(); }
+
+    // 统计：入队/出队/丢弃数、当前占用、高水位、排队时间
+    QueueStats stats() const { return m_ring.stats(); }
+
 private:
-    std::queue<HidCommand> m_queue;
-    QMutex m_mutex;
+    HidPacketQueue()
+        : m_ring(kCapacity, DropPolicy::DropNewest),
+          m_notifyFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          m_notified(false) {}
+    ~HidPacketQueue() {
+        if (m_notifyFd >= 0) ::close(m_notifyFd);
+    }
+
+    BoundedQueue<HidCommand> m_ring;
+    int m_notifyFd;
+    std::atomic<bool> m_notified;
 };
 
 #endif // SAFE_QUEUE_H
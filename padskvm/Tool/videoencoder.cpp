@@ -40,11 +40,17 @@ bool VideoEncoder::init() {
     // 3. 设置 x264 私有参数 (极低延迟模式)
     av_opt_set(codec_ctx_->priv_data, "preset", "ultrafast", 0);
     av_opt_set(codec_ctx_->priv_data, "tune", "zerolatency", 0);
+    // 强制关键帧时输出 IDR (新观看者需要 IDR 才能开始解码)
+    av_opt_set(codec_ctx_->priv_data, "forced-idr", "1", 0);
 
     if (avcodec_open2(codec_ctx_, codec, NULL) < 0) {
         std::cerr << "[Encoder] Could not open codec" << std::endl;
         return false;
     }
+    // 编码器若在 extradata 中给出参数集 (Annex-B)，先缓存一份
+    if (codec_ctx_->extradata && codec_ctx_->extradata_size > 0) {
+        updateParameterSets(codec_ctx_->extradata, codec_ctx_->extradata_size);
+    }
 
     // 4. 分配 YUV420P 帧内存
     frame_yuv420_ = av_frame_alloc();
@@ -73,7 +79,7 @@ bool VideoEncoder::init() {
     return true;
 }
 
-void VideoEncoder::encode(const void* raw_data, EncodeCallback callback) {
+void VideoEncoder::encode(const void* raw_data, int64_t captureUs, EncodeCallback callback) {
     if (!codec_ctx_ || !frame_yuv420_ || !sws_ctx_) return;
 
     // 1. 格式转换: XXXX (Packed) -> YUV420P (Planar)
@@ -99,6 +105,11 @@ void VideoEncoder::encode(const void* raw_data, EncodeCallback callback) {
 
     // 设置 PTS (Presentation Time Stamp)，防止 FFmpeg 警告
     frame_yuv420_->pts = frame_count_++;
+    capture_us_[frame_yuv420_->pts % kCaptureSlots] = captureUs;
+
+    // 有观看者请求时本帧编码为 IDR，否则交给编码器按 GOP 决定
+    frame_yuv420_->pict_type = keyframe_requested_.exchange(false, std::memory_order_relaxed)
+                             ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
 
     // 2. 发送帧给编码器
     int ret = avcodec_send_frame(codec_ctx_, frame_yuv420_);
@@ -117,11 +128,52 @@ void VideoEncoder::encode(const void* raw_data, EncodeCallback callback) {
             break;
         }
 
-        // 调用回调发送数据
+        // 调用回调发送数据：编码器的包在 unref 后失效，拷贝到池中的只读数据包后再交出
         if (callback) {
-            callback(pkt_->data, pkt_->size);
+            int64_t pts = pkt_->pts != AV_NOPTS_VALUE ? pkt_->pts : frame_yuv420_->pts;
+            bool keyframe = (pkt_->flags & AV_PKT_FLAG_KEY) != 0;
+            // 参数集随关键帧出现，只在关键帧上查找
+            if (keyframe) updateParameterSets(pkt_->data, pkt_->size);
+            EncodedPacketPtr packet = packet_pool_.publish(pkt_->data, pkt_->size, pts, keyframe,
+                                                           capture_us_[pts % kCaptureSlots], parameter_sets_);
+            callback(packet);
         }
 
         av_packet_unref(pkt_);
     }
 }
+
+void VideoEncoder::updateParameterSets(const uint8_t* data, size_t size) {
+    EncodedPacket::scanNals(data, size, nal_scratch_);
+    const NalUnit* sps = nullptr;
+    const NalUnit* pps = nullptr;
+    for (const NalUnit& nal : nal_scratch_) {
+        if (nal.type == 7) sps = &nal;
+        else if (nal.type == 8) pps = &nal;
+    }
+    if (!sps && !pps) return;
+
+    // 只更新出现的那一个，另一个沿用缓存 (先从旧缓存中取出)
+    std::vector<uint8_t> old_sps, old_pps;
+    if (parameter_sets_) {
+        std::vector<NalUnit> cached;
+        EncodedPacket::scanNals(parameter_sets_->data(), parameter_sets_->size(), cached);
+        for (const NalUnit& nal : cached) {
+            const uint8_t* p = parameter_sets_->data() + nal.offset;
+            if (nal.type == 7) old_sps.assign(p, p + nal.size);
+            else if (nal.type == 8) old_pps.assign(p, p + nal.size);
+        }
+    }
+    std::vector<uint8_t> new_sps = sps ? std::vector<uint8_t>(data + sps->offset, data + sps->offset + sps->size) : old_sps;
+    std::vector<uint8_t> new_pps = pps ? std::vector<uint8_t>(data + pps->offset, data + pps->offset + pps->size) : old_pps;
+    if (new_sps == old_sps && new_pps == old_pps) return; // 没变：继续共享旧的一份
+
+    static const uint8_t start_code[4] = {0, 0, 0, 1};
+    std::shared_ptr<std::vector<uint8_t>> sets = std::make_shared<std::vector<uint8_t>>();
+    for (const std::vector<uint8_t>* nal : {&new_sps, &new_pps}) {
+        if (nal->empty()) continue;
+        sets->insert(sets->end(), start_code, start_code + 4);
+        sets->insert(sets->end(), nal->begin(), nal->end());
+    }
+    parameter_sets_ = sets;
+}
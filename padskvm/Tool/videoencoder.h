@@ -5,6 +5,9 @@
 #include <iostream>
 #include <functional>
 #include <cstdint>
+#include <atomic>
+
+#include "encoded_packet.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -13,8 +16,8 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
-// 定义回调函数类型：void(数据指针, 数据大小)
-using EncodeCallback = std::function<void(uint8_t*, int)>;
+// 定义回调函数类型：void(只读数据包)，回调可以保留引用，无需拷贝
+using EncodeCallback = std::function<void(const EncodedPacketPtr&)>;
 
 class VideoEncoder {
 public:
@@ -25,7 +28,17 @@ public:
     bool init();
 
     // 核心函数：输入 YUYV -> 输出 H.264 (通过 callback)
-    void encode(const void* yuyv_data, EncodeCallback callback);
+    // captureUs：原始帧的采集时间戳，随对应的数据包带出
+    void encode(const void* yuyv_data, int64_t captureUs, EncodeCallback callback);
+
+    // 数据包池统计 (编码线程读取)
+    const EncodedPacketPool& packetPool() const { return packet_pool_; }
+
+    // 请求下一帧编码为 IDR (任意线程调用；新观看者加入时用，不必等到 GOP 结束)
+    void requestKeyframe() { keyframe_requested_.store(true, std::memory_order_relaxed); }
+
+    // 最新的 SPS/PPS (编码线程读取；每个输出包也带有一份引用)
+    const ParameterSetsPtr& parameterSets() const { return parameter_sets_; }
 
 private:
     int width_;
@@ -38,6 +51,18 @@ private:
     AVFrame* frame_yuv420_ = nullptr; // 用于存放转换后的 YUV420P 数据
     AVPacket* pkt_ = nullptr;         // 用于存放编码后的压缩数据
     struct SwsContext* sws_ctx_ = nullptr; // 图像格式转换上下文
+
+    EncodedPacketPool packet_pool_;   // 输出数据包 (复用缓冲，不再每帧分配)
+    // 按 pts 记录采集时间戳，输出包时查回 (零延迟模式下输出与输入一一对应，留余量应对编码器缓存)
+    static const int kCaptureSlots = 32;
+    int64_t capture_us_[kCaptureSlots] = {};
+
+    std::atomic<bool> keyframe_requested_{false};
+    ParameterSetsPtr parameter_sets_;  // 最新的 SPS/PPS (Annex-B)
+    std::vector<NalUnit> nal_scratch_; // 查找参数集时复用
+
+    // 从 Annex-B 数据中提取 SPS/PPS，有变化时更新 parameter_sets_
+    void updateParameterSets(const uint8_t* data, size_t size);
 };
 
 #endif // VIDEOENCODER_H
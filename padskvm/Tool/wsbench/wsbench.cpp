@@ -0,0 +1,290 @@
+// WebSocket 帧解析器吞吐测试
+// 生成浏览器方向 (加掩码) 的帧流，按不同的 recv 分块大小喂给 WsFrameParser，
+// 统计解析吞吐 (MB/s、消息/s)，第一轮校验每条消息的内容；同时用旧的"每次 recv 只解第一帧"
+// 逻辑过一遍同一份数据，对比它能收到的消息数。
+//
+// 场景：
+//   mouse   7 字节鼠标包，2KB 一次 recv (快速移动鼠标时内核合并多帧)
+//   mixed   鼠标/键盘/120 字节文本/1KB 混合，16KB 一次 recv
+//   large   64KB 消息按 4KB 分片，分片间插入 ping，16KB 一次 recv
+//   trickle 7 字节鼠标包，每次 recv 1~7 字节 (半帧)
+//
+// 用法：wsbench [-s 场景] [-n 轮数] [-c 分块字节]
+
+#include "drv_wsparser.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    std::string scenario;   // 空表示全部
+    int rounds = 200;
+    size_t chunk = 0;       // 0 表示按场景默认
+};
+
+// 一份测试数据：帧流 + 期望的消息数与校验值
+struct Stream {
+    std::vector<uint8_t> bytes;
+    uint64_t messages = 0;
+    uint64_t payloadBytes = 0;
+    uint64_t checksum = 0;
+    size_t chunk = 0;        // recv 分块大小
+    bool randomChunk = false; // 分块大小在 1..chunk 之间随机
+};
+
+uint64_t fnv1a(uint64_t h, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+
+// 按 RFC 6455 编码一帧客户端帧 (加掩码)
+void appendFrame(std::vector<uint8_t> &out, uint8_t opcode, bool fin,
+                 const uint8_t *payload, size_t len, std::mt19937 &rng)
+{
+    out.push_back((fin ? 0x80 : 0x00) | opcode);
+    if (len < 126) {
+        out.push_back(0x80 | (uint8_t)len);
+    } else if (len <= 0xFFFF) {
+        out.push_back(0x80 | 126);
+        out.push_back((uint8_t)(len >> 8));
+        out.push_back((uint8_t)len);
+    } else {
+        out.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; --i) out.push_back((uint8_t)((uint64_t)len >> (i * 8)));
+    }
+    uint8_t key[4];
+    for (int i = 0; i < 4; ++i) key[i] = (uint8_t)rng();
+    out.insert(out.end(), key, key + 4);
+    for (size_t i = 0; i < len; ++i) out.push_back(payload[i] ^ key[i & 3]);
+}
+
+void addMessage(Stream &s, uint8_t opcode, const std::vector<uint8_t> &payload,
+                size_t fragment, std::mt19937 &rng)
+{
+    if (fragment == 0 || payload.size() <= fragment) {
+        appendFrame(s.bytes, opcode, true, payload.data(), payload.size(), rng);
+    } else {
+        for (size_t off = 0; off < payload.size(); off += fragment) {
+            size_t n = std::min(fragment, payload.size() - off);
+            bool fin = off + n >= payload.size();
+            appendFrame(s.bytes, off == 0 ? opcode : (uint8_t)WsFrameParser::OP_CONTINUATION, fin,
+                        payload.data() + off, n, rng);
+            // 分片之间插入 ping (控制帧不计入数据消息)
+            if (!fin) {
+                static const uint8_t ping[4] = {'p', 'i', 'n', 'g'};
+                appendFrame(s.bytes, WsFrameParser::OP_PING, true, ping, sizeof(ping), rng);
+            }
+        }
+    }
+    s.messages++;
+    s.payloadBytes += payload.size();
+    s.checksum = fnv1a(s.checksum, payload.data(), payload.size());
+}
+
+std::vector<uint8_t> mousePacket(std::mt19937 &rng)
+{
+    uint16_t x = rng() & 0x7FFF, y = rng() & 0x7FFF;
+    return {0x02, (uint8_t)(rng() & 0x07), (uint8_t)x, (uint8_t)(x >> 8),
+            (uint8_t)y, (uint8_t)(y >> 8), 0x00};
+}
+
+std::vector<uint8_t> randomBytes(size_t len, std::mt19937 &rng)
+{
+    std::vector<uint8_t> v(len);
+    for (auto &b : v) b = (uint8_t)rng();
+    return v;
+}
+
+Stream buildStream(const std::string &name, std::mt19937 &rng)
+{
+    Stream s;
+    s.checksum = FNV_OFFSET;
+    if (name == "mouse") {
+        for (int i = 0; i < 20000; ++i) addMessage(s, WsFrameParser::OP_BINARY, mousePacket(rng), 0, rng);
+        s.chunk = 2048;
+    } else if (name == "mixed") {
+        for (int i = 0; i < 5000; ++i) {
+            switch (rng() % 4) {
+            case 0: addMessage(s, WsFrameParser::OP_BINARY, mousePacket(rng), 0, rng); break;
+            case 1: {
+                std::vector<uint8_t> kb = randomBytes(8, rng);
+                kb[0] = 0x01;
+                addMessage(s, WsFrameParser::OP_BINARY, kb, 0, rng);
+                break;
+            }
+            case 2: addMessage(s, WsFrameParser::OP_TEXT, randomBytes(120, rng), 0, rng); break;
+            default: addMessage(s, WsFrameParser::OP_BINARY, randomBytes(1024, rng), 0, rng); break;
+            }
+        }
+        s.chunk = 16384;
+    } else if (name == "large") {
+        for (int i = 0; i < 64; ++i) addMessage(s, WsFrameParser::OP_BINARY, randomBytes(65536, rng), 4096, rng);
+        s.chunk = 16384;
+    } else if (name == "trickle") {
+        for (int i = 0; i < 5000; ++i) addMessage(s, WsFrameParser::OP_BINARY, mousePacket(rng), 0, rng);
+        s.chunk = 7;
+        s.randomChunk = true;
+    }
+    return s;
+}
+
+// 按分块顺序预先算好每次 "recv" 的长度，避免计时中调用随机数
+std::vector<size_t> chunkPlan(const Stream &s, size_t chunk, std::mt19937 &rng)
+{
+    std::vector<size_t> plan;
+    size_t left = s.bytes.size();
+    while (left > 0) {
+        size_t n = s.randomChunk ? 1 + rng() % chunk : chunk;
+        if (n > left) n = left;
+        plan.push_back(n);
+        left -= n;
+    }
+    return plan;
+}
+
+struct Result {
+    double seconds = 0;
+    uint64_t messages = 0;
+    uint64_t checksum = 0;
+    bool error = false;
+};
+
+// 第一轮计算全部负载的校验值 (不计时)，之后各轮只计时解析本身
+Result runParser(const Stream &s, const std::vector<size_t> &plan, int rounds)
+{
+    Result r;
+    WsFrameParser parser;
+    std::chrono::steady_clock::time_point t0;
+    uint64_t sink = 0;
+    for (int round = 0; round <= rounds; ++round) {
+        bool verify = round == 0;
+        if (round == 1) t0 = std::chrono::steady_clock::now();
+        uint64_t h = FNV_OFFSET;
+        uint64_t count = 0;
+        const uint8_t *src = s.bytes.data();
+        for (size_t n : plan) {
+            // 模拟 recv：直接写进解析器的接收缓冲
+            memcpy(parser.prepare(n), src, n);
+            parser.commit(n);
+            src += n;
+            WsFrameParser::Message msg;
+            while (parser.next(msg)) {
+                if (msg.opcode != WsFrameParser::OP_TEXT && msg.opcode != WsFrameParser::OP_BINARY) continue;
+                count++;
+                // 像 dispatchRemoteInput 一样读消息头，防止解析结果被优化掉
+                sink += msg.data[0] + msg.size;
+                if (verify) h = fnv1a(h, msg.data, msg.size);
+            }
+            if (parser.hasError()) {
+                fprintf(stderr, "[WSBENCH] parser error: %s\n", parser.error());
+                r.error = true;
+                return r;
+            }
+        }
+        if (verify) {
+            r.messages = count;
+            r.checksum = h;
+        }
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (sink == 0) fprintf(stderr, "[WSBENCH] no payload\n");
+    return r;
+}
+
+// 旧逻辑能收到的消息数：每次 recv 只解第一帧，且只处理 126 字节以下的帧
+uint64_t countLegacy(const Stream &s, const std::vector<size_t> &plan)
+{
+    uint64_t count = 0;
+    const uint8_t *buf = s.bytes.data();
+    for (size_t n : plan) {
+        uint8_t opcode = buf[0] & 0x0F;
+        uint8_t payload_len = n > 1 ? (buf[1] & 0x7F) : 0;
+        if ((opcode == 0x1 || opcode == 0x2) && payload_len > 0 && payload_len < 126
+                && n >= (size_t)6 + payload_len) {
+            count++;
+        }
+        buf += n;
+    }
+    return count;
+}
+
+void runScenario(const std::string &name, const Options &opt)
+{
+    std::mt19937 rng(20260115);
+    Stream s = buildStream(name, rng);
+    size_t chunk = opt.chunk > 0 ? opt.chunk : s.chunk;
+    std::vector<size_t> plan = chunkPlan(s, chunk, rng);
+
+    Result p = runParser(s, plan, opt.rounds);
+    if (p.error) return;
+    bool ok = p.messages == s.messages && p.checksum == s.checksum;
+    uint64_t legacy = countLegacy(s, plan);
+
+    char chunkText[32];
+    snprintf(chunkText, sizeof(chunkText), "%s%zu", s.randomChunk ? "1.." : "", chunk);
+    double mb = (double)s.bytes.size() * opt.rounds / (1024.0 * 1024.0);
+    printf("%-8s stream=%8zuB chunk=%-7s | %8.1f MB/s %7.2f Mmsg/s | %llu/%llu msgs %s | legacy %llu/%llu msgs\n",
+           name.c_str(), s.bytes.size(), chunkText,
+           mb / p.seconds, (double)p.messages * opt.rounds / p.seconds / 1e6,
+           (unsigned long long)p.messages, (unsigned long long)s.messages, ok ? "OK" : "MISMATCH",
+           (unsigned long long)legacy, (unsigned long long)s.messages);
+}
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -s <name>   只运行一个场景：mouse / mixed / large / trickle\n"
+            "  -n <rounds> 每个场景重复解析的轮数 (默认 200)\n"
+            "  -c <bytes>  覆盖场景默认的 recv 分块大小\n",
+            prog);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "s:n:c:h")) != -1) {
+        switch (c) {
+        case 's': opt.scenario = optarg; break;
+        case 'n': opt.rounds = atoi(optarg); break;
+        case 'c': opt.chunk = (size_t)atol(optarg); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 1;
+        }
+    }
+    if (opt.rounds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    static const char *scenarios[] = {"mouse", "mixed", "large", "trickle"};
+    bool found = false;
+    for (const char *name : scenarios) {
+        if (!opt.scenario.empty() && opt.scenario != name) continue;
+        runScenario(name, opt);
+        found = true;
+    }
+    if (!found) {
+        usage(argv[0]);
+        return 1;
+    }
+    return 0;
+}
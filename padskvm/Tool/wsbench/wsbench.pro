@@ -0,0 +1,15 @@
+# WebSocket 帧解析器吞吐测试 (独立小工具，不依赖 Qt 库)
+# 编译：mkdir build-wsbench && cd build-wsbench && qmake ../Tool/wsbench/wsbench.pro && make
+
+TEMPLATE = app
+TARGET   = wsbench
+
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS_RELEASE += -O2
+
+INCLUDEPATH += ../../Driver
+
+SOURCES += wsbench.cpp                  \
+           ../../Driver/drv_wsparser.cpp
@@ -11,24 +11,53 @@ CONFIG += c++11
 SOURCES += \
     main.cpp                        \
     Driver/drv_webserver.cpp        \
+    Driver/drv_wsparser.cpp         \
     Driver/drv_camera.cpp           \
     Driver/drv_ch9329.cpp           \
+    Driver/drv_hidgadget.cpp        \
     Controller/pro_hidcontroller.cpp\
+    Controller/pro_hidio.cpp        \
+    Controller/pro_hidcoalescer.cpp \
+    Controller/pro_hidscheduler.cpp \
+    Controller/pro_hidkeyboard.cpp  \
+    Controller/pro_hidtyper.cpp     \
+    Controller/pro_hidtimerwheel.cpp\
+    Controller/pro_hidlatency.cpp   \
     Controller/pro_videothread.cpp  \
+    Controller/pro_pipelinestage.cpp\
     QtUiPage/ui_display.cpp         \
     QtUiPage/ui_mainpage.cpp        \
-    Tool/videoencoder.cpp
+    Tool/videoencoder.cpp           \
+    Tool/colorconvert.cpp           \
+    Tool/event_reactor.cpp          \
+    Tool/encoded_packet.cpp
 
 HEADERS += \
     Driver/drv_camera.h           \
     Driver/drv_ch9329.h           \
+    Driver/drv_hidbackend.h       \
+    Driver/drv_hidgadget.h        \
     Driver/drv_webserver.h        \
+    Driver/drv_wsparser.h         \
     Controller/pro_hidcontroller.h\
+    Controller/pro_hidio.h        \
+    Controller/pro_hidcoalescer.h \
+    Controller/pro_hidscheduler.h \
+    Controller/pro_hidkeyboard.h  \
+    Controller/pro_hidtyper.h     \
+    Controller/pro_hidtimerwheel.h\
+    Controller/pro_hidlatency.h   \
     Controller/pro_videothread.h  \
+    Controller/pro_pipelinestage.h\
     QtUiPage/ui_display.h         \
     QtUiPage/ui_mainpage.h        \
     Tool/videoencoder.h           \
-    Tool/safe_queue.h
+    Tool/safe_queue.h             \
+    Tool/bounded_queue.h          \
+    Tool/latency_histogram.h      \
+    Tool/event_reactor.h          \
+    Tool/encoded_packet.h         \
+    Tool/colorconvert.h
 
 FORMS += QtUiPage/ui_mainpage.ui
 